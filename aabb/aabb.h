@@ -2,8 +2,10 @@
 #define AABB_H
 
 #include <stdio.h>
+#include <cassert>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 #include <GL/glu.h>
 #include "vec2.h"
 #include "vec3.h"
@@ -21,6 +23,10 @@ public:
   void insert(const Vec& point);
   void insert(const AABB& box);
   bool isIntersectedBy(const AABB& box) const;
+  bool isIntersectedBy(const Vec& origin, const Vec& direction,
+		       Real& t) const;
+  int side(const Real* plane) const;
+  bool contains(const AABB& box) const;
   void draw() const;
   void read(std::ifstream& file_in);
   void write(std::ofstream& file_out) const;
@@ -28,10 +34,68 @@ public:
   Vec min, max;
 };
 
-#if 0
+/*
+ *  Bounding volume hierarchy of boxes, each one labeled by an item (a
+ *  small integer, unique in the tree). Every node has two children and
+ *  every leaf one item. The tree is built from a set of boxes by splitting
+ *  them at the best of a few planes per axis, chosen by the surface area
+ *  heuristic on bins of box centers (build, rebuild), or one box at a time,
+ *  each new leaf going down to the sibling of least surface area cost
+ *  (insert). Boxes that moved are refitted without changing the tree.
+ */
 template < class Real, class Vec = Vec2<Real> >
-class AABB_Tree {};
-#endif
+class AABB_Tree {
+public:
+  typedef Real real;
+  typedef Vec  vec;
+  typedef AABB<Real, Vec> box;
+  enum {NO_NODE = -1};
+  
+  AABB_Tree();
+  void build(const int n, const int* items, const box* boxes);
+  void rebuild();
+  void insert(const int item, const box& b);
+  void remove(const int item);
+  void refit(const int item, const box& b);
+  void refit();
+  void clear();
+  bool contains(const int item) const;
+  int size() const;
+  int height() const;
+  void query(const box& b, std::vector<int>& items) const;
+  void query(const Vec& origin, const Vec& direction,
+	     std::vector<int>& items, std::vector<Real>* params = 0) const;
+  void query(const int nplanes, const Real* planes,
+	     std::vector<int>& items) const;
+  
+private:
+  struct Node {
+    box b;
+    int parent;
+    int children[2]; // NO_NODE for leaves
+    int item;        // Of leaves
+  };
+  enum {NBINS = 16}; // Magic number!
+  
+  static Real area(const box& b);
+  static Real center(const box& b, const int axis);
+  int newNode();
+  void deleteNode(const int n);
+  bool isLeaf(const int n) const;
+  void refitAncestors(int n);
+  int refitSubtree(const int n);
+  int buildSubtree(int* items, const int n, const int parent);
+  int subtreeHeight(const int n) const;
+  
+  std::vector<Node> nodes;
+  std::vector<int> free_nodes;
+  std::vector<int> leaves;     // Of the items, NO_NODE if none
+  std::vector<box> item_boxes; // Scratch arrays of the builds
+  mutable std::vector<int> stack; // Of the queries
+  mutable std::vector< std::pair<Real, int> > entries; // Of the segments
+  int root;
+  int nitems;
+};
 
 /*
  *  Definition of inlined methods
@@ -102,6 +166,80 @@ isIntersectedBy(const AABB& box) const {
   return !answer;
 }
 
+/*
+ *  isIntersectedBy :
+ *  True if the segment from origin to origin + direction crosses the box,
+ *  t being the parameter (from 0 to 1) of the point where it gets in.
+ */
+template <class Real, class Vec>
+inline bool AABB<Real, Vec>::
+isIntersectedBy(const Vec& origin, const Vec& direction, Real& t) const {
+  Real t_in = 0.0, t_out = 1.0;
+  for (int i = 0; i < Vec::size(); i++) {
+    if (direction[i] == 0.0) {
+      if (origin[i] < min[i] || origin[i] > max[i]) {
+	return false;
+      }
+      continue;
+    }
+    const Real inv = 1.0/direction[i];
+    Real t_min = (min[i] - origin[i])*inv;
+    Real t_max = (max[i] - origin[i])*inv;
+    if (t_min > t_max) {
+      std::swap(t_min, t_max);
+    }
+    if (t_min > t_in) {
+      t_in = t_min;
+    }
+    if (t_max < t_out) {
+      t_out = t_max;
+    }
+    if (t_in > t_out) {
+      return false;
+    }
+  }
+  t = t_in;
+  return true;
+}
+
+/*
+ *  side :
+ *  Side of a plane (Vec::size() + 1 coefficients, the last one constant)
+ *  where the box is: 1 if all its points are on the positive side (or on
+ *  the plane), -1 if all are on the negative side, 0 if the plane cuts it.
+ *  Only the two corners farthest along the normal are tested.
+ */
+template <class Real, class Vec>
+inline int AABB<Real, Vec>::
+side(const Real* plane) const {
+  Real d_min = plane[Vec::size()], d_max = plane[Vec::size()];
+  for (int i = 0; i < Vec::size(); i++) {
+    if (plane[i] >= 0.0) {
+      d_min += plane[i]*min[i];
+      d_max += plane[i]*max[i];
+    }
+    else {
+      d_min += plane[i]*max[i];
+      d_max += plane[i]*min[i];
+    }
+  }
+  if (d_max < 0.0) {
+    return -1;
+  }
+  return (d_min >= 0.0) ? 1 : 0;
+}
+
+template <class Real, class Vec>
+inline bool AABB<Real, Vec>::
+contains(const AABB& box) const {
+  for (int i = 0; i < Vec::size(); i++) {
+    if (box.min[i] < min[i] || box.max[i] > max[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
 template <class Real, class Vec>
 inline void AABB<Real, Vec>::
 draw() const {}
@@ -144,6 +282,33 @@ draw() const {
   glEnd();
 }
 
+template <>
+inline void AABB< float, Vec3<float> >::
+draw() const {
+  glBegin(GL_LINE_LOOP);
+  glVertex3fv(&min[0]);
+  glVertex3f(max[0], min[1], min[2]);
+  glVertex3f(max[0], max[1], min[2]);
+  glVertex3f(min[0], max[1], min[2]);
+  glEnd();
+  glBegin(GL_LINE_LOOP);
+  glVertex3f(min[0], min[1], max[2]);
+  glVertex3f(max[0], min[1], max[2]);
+  glVertex3fv(&max[0]);
+  glVertex3f(min[0], max[1], max[2]);
+  glEnd();
+  glBegin(GL_LINES);
+  glVertex3fv(&min[0]);
+  glVertex3f(min[0], min[1], max[2]);
+  glVertex3f(max[0], min[1], min[2]);
+  glVertex3f(max[0], min[1], max[2]);
+  glVertex3f(max[0], max[1], min[2]);
+  glVertex3fv(&max[0]);
+  glVertex3f(min[0], max[1], min[2]);
+  glVertex3f(min[0], max[1], max[2]);
+  glEnd();
+}
+
 template <class Real, class Vec>
 inline void AABB<Real, Vec>::
 read(std::ifstream& file_in) {}
@@ -158,6 +323,16 @@ read(std::ifstream& file_in) {
   sscanf(line, "%lf %lf %lf", &max[0], &max[1], &max[2]);
 }
 
+template <>
+inline void AABB< float, Vec3<float> >::
+read(std::ifstream& file_in) {
+  char line[256];
+  file_in.getline(line, 256, '\n');
+  sscanf(line, "%f %f %f", &min[0], &min[1], &min[2]);
+  file_in.getline(line, 256, '\n');
+  sscanf(line, "%f %f %f", &max[0], &max[1], &max[2]);
+}
+
 template <class Real, class Vec>
 inline void AABB<Real, Vec>::
 write(std::ofstream& file_out) const {
@@ -165,4 +340,576 @@ write(std::ofstream& file_out) const {
   file_out << max << endl;
 }
 
+/*
+ *  AABB_Tree
+ */
+
+template <class Real, class Vec>
+inline AABB_Tree<Real, Vec>::
+AABB_Tree()
+  : root(NO_NODE), nitems(0) {}
+
+/*
+ *  area :
+ *  Half the surface area of a box (perimeter in 2D), the cost of a node
+ *  in the surface area heuristic.
+ */
+template <class Real, class Vec>
+inline Real AABB_Tree<Real, Vec>::
+area(const box& b) {
+  Real a = 0.0;
+  if (Vec::size() < 3) {
+    for (int i = 0; i < Vec::size(); i++) {
+      a += b.max[i] - b.min[i];
+    }
+  }
+  else {
+    for (int i = 0; i < Vec::size(); i++) {
+      for (int j = i + 1; j < Vec::size(); j++) {
+	a += (b.max[i] - b.min[i])*(b.max[j] - b.min[j]);
+      }
+    }
+  }
+  return a;
+}
+
+template <class Real, class Vec>
+inline Real AABB_Tree<Real, Vec>::
+center(const box& b, const int axis) {
+  return 0.5*(b.min[axis] + b.max[axis]);
+}
+
+template <class Real, class Vec>
+inline int AABB_Tree<Real, Vec>::
+newNode() {
+  int n;
+  if (free_nodes.empty()) {
+    n = nodes.size();
+    nodes.push_back(Node());
+  }
+  else {
+    n = free_nodes.back();
+    free_nodes.pop_back();
+  }
+  nodes[n].parent = NO_NODE;
+  nodes[n].children[0] = nodes[n].children[1] = NO_NODE;
+  nodes[n].item = -1;
+  return n;
+}
+
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+deleteNode(const int n) {
+  free_nodes.push_back(n);
+}
+
+template <class Real, class Vec>
+inline bool AABB_Tree<Real, Vec>::
+isLeaf(const int n) const {
+  return nodes[n].children[0] == NO_NODE;
+}
+
+/*
+ *  build :
+ *  Tree of n items and their boxes, instead of the current one, built top
+ *  down by binned surface area heuristic.
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+build(const int n, const int* items, const box* boxes) {
+  clear();
+  if (n == 0) {
+    return;
+  }
+  std::vector<int> sorted_items(items, items + n);
+  int i;
+  for (i = 0; i < n; i++) {
+    assert(items[i] >= 0);
+    if (items[i] >= leaves.size()) {
+      leaves.resize(items[i] + 1, NO_NODE);
+    }
+    if (items[i] >= item_boxes.size()) {
+      item_boxes.resize(items[i] + 1);
+    }
+    assert(leaves[items[i]] == NO_NODE);
+    leaves[items[i]] = 0; // Set by buildSubtree
+    item_boxes[items[i]] = boxes[i];
+  }
+  nitems = n;
+  root = buildSubtree(&sorted_items[0], n, NO_NODE);
+}
+
+/*
+ *  rebuild :
+ *  Tree of the same items built again by binned surface area heuristic,
+ *  as after many inserts and moves.
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+rebuild() {
+  std::vector<int> items;
+  std::vector<box> boxes;
+  items.reserve(nitems);
+  boxes.reserve(nitems);
+  for (int i = 0; i < leaves.size(); i++) {
+    if (leaves[i] != NO_NODE) {
+      items.push_back(i);
+      boxes.push_back(nodes[leaves[i]].b);
+    }
+  }
+  build(items.size(), items.empty() ? 0 : &items[0],
+	boxes.empty() ? 0 : &boxes[0]);
+}
+
+/*
+ *  buildSubtree :
+ *  Node of n items (reordered), split at the bin boundary of least cost
+ *  along the three axes (the area of each side times its number of items),
+ *  or in the middle if their centers are too close to be binned.
+ */
+template <class Real, class Vec>
+inline int AABB_Tree<Real, Vec>::
+buildSubtree(int* items, const int n, const int parent) {
+  const int node = newNode();
+  nodes[node].parent = parent;
+  box b = item_boxes[items[0]];
+  int i;
+  for (i = 1; i < n; i++) {
+    b.insert(item_boxes[items[i]]);
+  }
+  nodes[node].b = b;
+  if (n == 1) {
+    nodes[node].item = items[0];
+    leaves[items[0]] = node;
+    return node;
+  }
+  
+  /* Bounds of the centers */
+  Vec c_min, c_max;
+  for (int k = 0; k < Vec::size(); k++) {
+    c_min[k] = c_max[k] = center(item_boxes[items[0]], k);
+  }
+  for (i = 1; i < n; i++) {
+    for (int k = 0; k < Vec::size(); k++) {
+      const Real c = center(item_boxes[items[i]], k);
+      if (c < c_min[k]) {
+	c_min[k] = c;
+      }
+      else if (c > c_max[k]) {
+	c_max[k] = c;
+      }
+    }
+  }
+  
+  /* Best split over the bins of each axis */
+  int best_axis = -1, best_bin = 0;
+  Real best_cost = 0.0;
+  for (int k = 0; k < Vec::size(); k++) {
+    const Real extent = c_max[k] - c_min[k];
+    if (extent <= 0.0) {
+      continue;
+    }
+    const Real scale = NBINS/extent;
+    int counts[NBINS];
+    box bins[NBINS];
+    int j;
+    for (j = 0; j < NBINS; j++) {
+      counts[j] = 0;
+    }
+    for (i = 0; i < n; i++) {
+      const box& b_i = item_boxes[items[i]];
+      j = static_cast<int>((center(b_i, k) - c_min[k])*scale);
+      if (j >= NBINS) {
+	j = NBINS - 1;
+      }
+      if (counts[j]++ == 0) {
+	bins[j] = b_i;
+      }
+      else {
+	bins[j].insert(b_i);
+      }
+    }
+    Real areas_left[NBINS];
+    int counts_left[NBINS];
+    box b_left;
+    int count = 0;
+    for (j = 0; j < NBINS - 1; j++) {
+      if (counts[j] > 0) {
+	if (count == 0) {
+	  b_left = bins[j];
+	}
+	else {
+	  b_left.insert(bins[j]);
+	}
+	count += counts[j];
+      }
+      counts_left[j] = count;
+      areas_left[j] = (count > 0) ? area(b_left) : 0.0;
+    }
+    box b_right;
+    count = 0;
+    for (j = NBINS - 1; j > 0; j--) {
+      if (counts[j] > 0) {
+	if (count == 0) {
+	  b_right = bins[j];
+	}
+	else {
+	  b_right.insert(bins[j]);
+	}
+	count += counts[j];
+      }
+      if (count == 0 || counts_left[j-1] == 0) {
+	continue;
+      }
+      const Real cost = areas_left[j-1]*counts_left[j-1] + area(b_right)*count;
+      if (best_axis == -1 || cost < best_cost) {
+	best_axis = k;
+	best_bin = j; // First bin on the right
+	best_cost = cost;
+      }
+    }
+  }
+  
+  /* Partition */
+  int n_left = n/2;
+  if (best_axis != -1) {
+    const Real scale = NBINS/(c_max[best_axis] - c_min[best_axis]);
+    int* first = items;
+    int* last = items + n;
+    while (first != last) {
+      int j = static_cast<int>((center(item_boxes[*first], best_axis) -
+				c_min[best_axis])*scale);
+      if (j >= NBINS) {
+	j = NBINS - 1;
+      }
+      if (j < best_bin) {
+	first++;
+      }
+      else {
+	std::swap(*first, *(--last));
+      }
+    }
+    n_left = first - items;
+  }
+  const int child_left = buildSubtree(items, n_left, node);
+  const int child_right = buildSubtree(items + n_left, n - n_left, node);
+  nodes[node].children[0] = child_left;
+  nodes[node].children[1] = child_right;
+  return node;
+}
+
+/*
+ *  insert :
+ *  New leaf, paired with the node found going down from the root towards
+ *  the child whose box grows the least in area, as long as pairing the
+ *  leaf lower in the tree costs less than pairing it there.
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+insert(const int item, const box& b) {
+  assert(item >= 0);
+  if (item >= leaves.size()) {
+    leaves.resize(item + 1, NO_NODE);
+  }
+  assert(leaves[item] == NO_NODE);
+  const int leaf = newNode();
+  nodes[leaf].b = b;
+  nodes[leaf].item = item;
+  leaves[item] = leaf;
+  nitems++;
+  if (root == NO_NODE) {
+    root = leaf;
+    return;
+  }
+  
+  /* Sibling */
+  int n = root;
+  while (!isLeaf(n)) {
+    box b_n = nodes[n].b;
+    const Real area_n = area(b_n);
+    b_n.insert(b);
+    const Real area_union = area(b_n);
+    const Real cost_here = 2.0*area_union;
+    const Real cost_down = 2.0*(area_union - area_n); // Growth of n
+    Real costs[2];
+    for (int k = 0; k < 2; k++) {
+      const int child = nodes[n].children[k];
+      box b_child = nodes[child].b;
+      b_child.insert(b);
+      costs[k] = area(b_child) + cost_down;
+      if (!isLeaf(child)) {
+	costs[k] -= area(nodes[child].b);
+      }
+    }
+    if (cost_here < costs[0] && cost_here < costs[1]) {
+      break;
+    }
+    n = (costs[0] <= costs[1]) ? nodes[n].children[0] : nodes[n].children[1];
+  }
+  
+  /* New parent of the sibling and the leaf */
+  const int parent_prev = nodes[n].parent;
+  const int parent = newNode();
+  nodes[parent].parent = parent_prev;
+  nodes[parent].b = nodes[n].b;
+  nodes[parent].b.insert(b);
+  nodes[parent].children[0] = n;
+  nodes[parent].children[1] = leaf;
+  nodes[n].parent = parent;
+  nodes[leaf].parent = parent;
+  if (parent_prev == NO_NODE) {
+    root = parent;
+  }
+  else {
+    const int k = (nodes[parent_prev].children[0] == n) ? 0 : 1;
+    nodes[parent_prev].children[k] = parent;
+    refitAncestors(parent_prev);
+  }
+}
+
+/*
+ *  remove :
+ *  Removal of the leaf of an item, whose sibling takes the place of their
+ *  parent.
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+remove(const int item) {
+  assert(contains(item));
+  const int leaf = leaves[item];
+  leaves[item] = NO_NODE;
+  nitems--;
+  const int parent = nodes[leaf].parent;
+  deleteNode(leaf);
+  if (parent == NO_NODE) {
+    root = NO_NODE;
+    return;
+  }
+  const int sibling = (nodes[parent].children[0] == leaf) ?
+    nodes[parent].children[1] : nodes[parent].children[0];
+  const int grand_parent = nodes[parent].parent;
+  nodes[sibling].parent = grand_parent;
+  deleteNode(parent);
+  if (grand_parent == NO_NODE) {
+    root = sibling;
+  }
+  else {
+    const int k = (nodes[grand_parent].children[0] == parent) ? 0 : 1;
+    nodes[grand_parent].children[k] = sibling;
+    refitAncestors(grand_parent);
+  }
+}
+
+/*
+ *  refit :
+ *  New box of an item, the boxes of its ancestors being enlarged or
+ *  shrunk to fit, without changing the tree.
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+refit(const int item, const box& b) {
+  assert(contains(item));
+  const int leaf = leaves[item];
+  nodes[leaf].b = b;
+  if (nodes[leaf].parent != NO_NODE) {
+    refitAncestors(nodes[leaf].parent);
+  }
+}
+
+/*
+ *  refit :
+ *  Boxes of all the nodes fitted to the boxes of their leaves, after the
+ *  boxes of many leaves changed.
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+refit() {
+  if (root != NO_NODE) {
+    refitSubtree(root);
+  }
+}
+
+template <class Real, class Vec>
+inline int AABB_Tree<Real, Vec>::
+refitSubtree(const int n) {
+  if (!isLeaf(n)) {
+    nodes[n].b = nodes[refitSubtree(nodes[n].children[0])].b;
+    nodes[n].b.insert(nodes[refitSubtree(nodes[n].children[1])].b);
+  }
+  return n;
+}
+
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+refitAncestors(int n) {
+  for (; n != NO_NODE; n = nodes[n].parent) {
+    nodes[n].b = nodes[nodes[n].children[0]].b;
+    nodes[n].b.insert(nodes[nodes[n].children[1]].b);
+  }
+}
+
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+clear() {
+  nodes.clear();
+  free_nodes.clear();
+  leaves.assign(leaves.size(), NO_NODE);
+  root = NO_NODE;
+  nitems = 0;
+}
+
+template <class Real, class Vec>
+inline bool AABB_Tree<Real, Vec>::
+contains(const int item) const {
+  return item >= 0 && item < leaves.size() && leaves[item] != NO_NODE;
+}
+
+template <class Real, class Vec>
+inline int AABB_Tree<Real, Vec>::
+size() const {
+  return nitems;
+}
+
+/*
+ *  height :
+ *  Number of nodes on the longest path from the root to a leaf.
+ */
+template <class Real, class Vec>
+inline int AABB_Tree<Real, Vec>::
+height() const {
+  return (root == NO_NODE) ? 0 : subtreeHeight(root);
+}
+
+template <class Real, class Vec>
+inline int AABB_Tree<Real, Vec>::
+subtreeHeight(const int n) const {
+  if (isLeaf(n)) {
+    return 1;
+  }
+  return 1 + std::max(subtreeHeight(nodes[n].children[0]),
+		      subtreeHeight(nodes[n].children[1]));
+}
+
+/*
+ *  query :
+ *  Items whose boxes intersect b, appended to items.
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+query(const box& b, std::vector<int>& items) const {
+  if (root == NO_NODE) {
+    return;
+  }
+  stack.clear();
+  stack.push_back(root);
+  while (!stack.empty()) {
+    const int n = stack.back();
+    stack.pop_back();
+    if (!nodes[n].b.isIntersectedBy(b)) {
+      continue;
+    }
+    if (isLeaf(n)) {
+      items.push_back(nodes[n].item);
+    }
+    else {
+      stack.push_back(nodes[n].children[1]);
+      stack.push_back(nodes[n].children[0]);
+    }
+  }
+}
+
+/*
+ *  query :
+ *  Items whose boxes the segment from origin to origin + direction crosses,
+ *  appended to items in the order the segment gets into their boxes, so
+ *  that a search for the first hit can stop early, and the parameters of
+ *  these entry points to params (if any).
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+query(const Vec& origin, const Vec& direction,
+      std::vector<int>& items, std::vector<Real>* params) const {
+  if (root == NO_NODE) {
+    return;
+  }
+  entries.clear();
+  stack.clear();
+  stack.push_back(root);
+  while (!stack.empty()) {
+    const int n = stack.back();
+    stack.pop_back();
+    Real t;
+    if (!nodes[n].b.isIntersectedBy(origin, direction, t)) {
+      continue;
+    }
+    if (isLeaf(n)) {
+      entries.push_back(std::make_pair(t, nodes[n].item));
+    }
+    else {
+      stack.push_back(nodes[n].children[1]);
+      stack.push_back(nodes[n].children[0]);
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  for (int i = 0; i < entries.size(); i++) {
+    items.push_back(entries[i].second);
+    if (params != 0) {
+      params->push_back(entries[i].first);
+    }
+  }
+}
+
+/*
+ *  query :
+ *  Items whose boxes are not on the negative side of any of nplanes planes
+ *  (32 at most, each one of Vec::size() + 1 coefficients), as the planes of
+ *  a view frustum facing inside, appended to items. A node on the positive
+ *  side of a plane is not tested against it again in its subtree, and a
+ *  node on the positive side of all of them has all its items appended
+ *  without test.
+ */
+template <class Real, class Vec>
+inline void AABB_Tree<Real, Vec>::
+query(const int nplanes, const Real* planes, std::vector<int>& items) const {
+  assert(nplanes <= 32);
+  if (root == NO_NODE) {
+    return;
+  }
+  const int stride = Vec::size() + 1;
+  stack.clear();
+  stack.push_back(root);
+  stack.push_back(nplanes == 32 ? ~0 : (1 << nplanes) - 1); // Planes left
+  while (!stack.empty()) {
+    int mask = stack.back();
+    stack.pop_back();
+    const int n = stack.back();
+    stack.pop_back();
+    bool outside = false;
+    for (int k = 0; k < nplanes && mask != 0; k++) {
+      if (mask & (1 << k)) {
+	const int side = nodes[n].b.side(planes + k*stride);
+	if (side < 0) {
+	  outside = true;
+	  break;
+	}
+	if (side > 0) {
+	  mask &= ~(1 << k);
+	}
+      }
+    }
+    if (outside) {
+      continue;
+    }
+    if (isLeaf(n)) {
+      items.push_back(nodes[n].item);
+    }
+    else {
+      stack.push_back(nodes[n].children[1]);
+      stack.push_back(mask);
+      stack.push_back(nodes[n].children[0]);
+      stack.push_back(mask);
+    }
+  }
+}
+
 #endif // AABB_H
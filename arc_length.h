@@ -0,0 +1,139 @@
+#ifndef ARC_LENGTH_H
+#define ARC_LENGTH_H
+
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+/*
+ *  Arc length of a Bezier curve, by adaptive Gauss-Legendre quadrature of
+ *  the norm of its hodograph (the Bezier curve of its first derivative).
+ *  An interval is split in two until the 5-point rules on both halves
+ *  agree with the rule on the whole interval to within the error bound,
+ *  which is shared between the halves. The curve is always split at least
+ *  once, since rules over a too long interval may agree by chance.
+ */
+template < class Real, class Vec >
+class Arc_Length {
+public:
+  static Real evaluate(const std::vector<Vec>& V);
+  static Real evaluate(const std::vector<Vec>& V, const Real error);
+  static Real evaluate(const Vec* V, const int n);
+  static Real evaluate(const Vec* V, const int n, const Real error);
+
+  static Real tolerance; // Default error bound (absolute, in curve units)
+
+private:
+  enum {MAX_DEGREE = 8, MIN_DEPTH = 1, MAX_DEPTH = 16};
+
+  static Real speed(const Vec* D, const int n, const Real t);
+  static Real gauss(const Vec* D, const int n, const Real a, const Real b);
+  static Real adapt(const Vec* D, const int n, const Real a, const Real b,
+		    const Real whole, const Real error, const int depth);
+};
+
+template <class Real, class Vec>
+Real Arc_Length<Real, Vec>::tolerance = 1.0e-3; // Magic number!
+
+/*
+ *  Definition of inlined methods
+ */
+
+template <class Real, class Vec>
+inline Real Arc_Length<Real, Vec>::
+evaluate(const std::vector<Vec>& V) {
+  return evaluate(V, tolerance);
+}
+
+template <class Real, class Vec>
+inline Real Arc_Length<Real, Vec>::
+evaluate(const std::vector<Vec>& V, const Real error) {
+  return V.empty() ? 0.0 : evaluate(&V[0], V.size(), error);
+}
+
+template <class Real, class Vec>
+inline Real Arc_Length<Real, Vec>::
+evaluate(const Vec* V, const int n) {
+  return evaluate(V, n, tolerance);
+}
+
+/*
+ *  evaluate :
+ *  Arc length of the Bezier curve of the n control points V.
+ */
+template <class Real, class Vec>
+inline Real Arc_Length<Real, Vec>::
+evaluate(const Vec* V, const int n, const Real error) {
+  const int degree = n - 1;
+  assert(degree <= MAX_DEGREE);
+  if (degree < 1) {
+    return 0.0;
+  }
+
+  /* Control points of the hodograph */
+  Vec D[MAX_DEGREE];
+  for (int i = 0; i < degree; i++) {
+    D[i] = (V[i+1] - V[i])*static_cast<Real>(degree);
+  }
+  return adapt(D, degree, 0.0, 1.0, gauss(D, degree, 0.0, 1.0), error, 0);
+}
+
+/*
+ *  speed :
+ *  Norm of the hodograph (of n control points) at parameter t.
+ */
+template <class Real, class Vec>
+inline Real Arc_Length<Real, Vec>::
+speed(const Vec* D, const int n, const Real t) {
+  if (n == 3) {
+    const Real s = 1.0 - t;
+    return (D[0]*(s*s) + D[1]*(2.0*t*s) + D[2]*(t*t)).norm();
+  }
+  Vec D_tmp[MAX_DEGREE];
+  int i;
+  for (i = 0; i < n; i++) {
+    D_tmp[i] = D[i];
+  }
+  for (int j = 1; j < n; j++) {
+    for (i = 0; i < n - j; i++) {
+      D_tmp[i] = D_tmp[i]*(1.0 - t) + D_tmp[i+1]*(t);
+    }
+  }
+  return D_tmp[0].norm();
+}
+
+/*
+ *  gauss :
+ *  5-point Gauss-Legendre rule on [a; b].
+ */
+template <class Real, class Vec>
+inline Real Arc_Length<Real, Vec>::
+gauss(const Vec* D, const int n, const Real a, const Real b) {
+  static const Real x1 = 0.538469310105683091; // Nodes
+  static const Real x2 = 0.906179845938663993;
+  static const Real w0 = 0.568888888888888889; // Weights
+  static const Real w1 = 0.478628670499366468;
+  static const Real w2 = 0.236926885056189088;
+  const Real c = 0.5*(a + b);
+  const Real h = 0.5*(b - a);
+  return h*(w0*speed(D, n, c) +
+	    w1*(speed(D, n, c - h*x1) + speed(D, n, c + h*x1)) +
+	    w2*(speed(D, n, c - h*x2) + speed(D, n, c + h*x2)));
+}
+
+template <class Real, class Vec>
+inline Real Arc_Length<Real, Vec>::
+adapt(const Vec* D, const int n, const Real a, const Real b,
+      const Real whole, const Real error, const int depth) {
+  const Real m = 0.5*(a + b);
+  const Real left = gauss(D, n, a, m);
+  const Real right = gauss(D, n, m, b);
+  if (depth >= MAX_DEPTH ||
+      (depth >= MIN_DEPTH && fabs(left + right - whole) <= error)) {
+    return left + right;
+  }
+  return adapt(D, n, a, m, left, 0.5*error, depth+1) +
+    adapt(D, n, m, b, right, 0.5*error, depth+1);
+}
+
+#endif // ARC_LENGTH_H
@@ -0,0 +1,2707 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <vector>
+#include <list>
+#include <string>
+#include <algorithm>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "bezier.h"
+#include "cubic_kernel.h"
+#include "parallel_fitter.h"
+#include "arc_length.h"
+#include "stroke2D.h"
+#include "unprojector.h"
+#include "stroke3D.h"
+#include "intersection_graph.h"
+#include "clipping_planes.h"
+#include "scene_mesh.h"
+#include "drawing.h"
+
+using namespace std;
+
+/* Types */
+typedef GLdouble                      real;
+typedef Vec2<real>                    vec2;
+typedef Point<real, vec2>             point;
+typedef std::vector<point>            points;
+typedef Bezier_Augmented<real, vec2, 3> bezier;
+#ifdef STROKE3D_FLOAT
+typedef AABB< GLfloat, Vec3<GLfloat> > box3;
+#else
+typedef AABB< GLdouble, Vec3<GLdouble> > box3;
+#endif
+
+/* Functions declaration */
+double now();
+void usage();
+void benchKernel(const int npoints, const int nruns);
+void benchSpans(const int ncorners, const int nthreads, const int nruns);
+void sampledLength(std::vector<bezier>& bs);
+void benchLength(const int nstrokes, const int nruns);
+bool listTraces(const char* dir_name, std::vector<string>& names);
+real maxError(const points& pts, const std::vector<bezier>& bs);
+double percentile(std::vector<double>& v, const double p);
+void printString(const char* s);
+int benchTraces(const char* dir_name, const int nruns, const int nthreads);
+template <class Bezier3>
+bool readSegments(const char* name, std::vector< std::vector<Bezier3> >& ss);
+template <class Bezier3>
+bool measureSegments(const char* name, const char* type_name);
+double roundingError(const char* name);
+int benchMemory(const char* name);
+void benchUnproject(const int npoints, const int nruns);
+bool readStrokes(const char* name, const int window,
+		 std::list<Stroke3D>& strokes);
+template <class T>
+bool sameBits(const T& a, const T& b);
+bool sameStrokes(const Stroke3D& a, const Stroke3D& b);
+int benchReverse(const char* name, const int nruns);
+box3 sampledBox(const Stroke3D& s);
+int intersectingPairs(const std::vector<box3>& boxes);
+int benchBoxes(const char* name, const int nruns);
+void drawFrames(std::list<Stroke3D>& strokes, const int window,
+		const int nframes, const bool lod);
+int benchLod(const char* name, const int nframes);
+long residentBytes();
+double loadStrokes(const char* name, const int window, const bool copy,
+		   long& allocs);
+int benchLoad(const char* name, const int nruns);
+bool sameNeighbours(const Intersection_Graph<int>& g,
+		    const std::vector<int>& nodes, const std::vector<bool>& alive,
+		    const std::vector<box3>& boxes);
+int benchGraph(const int nstrokes, const int nrounds);
+void strokePlanes(const box3::vec& barycenter, const box3::real mean_radius,
+		  box3::vec view_vector, GLdouble equations[2][4]);
+int benchPlanes(const char* name, const int nframes);
+int benchStrokes(const char* name);
+void tiledBoxes(const std::vector<box3>& boxes, const int n,
+		std::vector<box3>& tiled);
+bool sameEdges(const Intersection_Graph<int>& a,
+	       const Intersection_Graph<int>& b, const int n);
+int benchTree(const char* name, const std::vector<int>& sizes);
+GLuint castRay(const std::vector<const Stroke3D*>& strokes,
+	       const Stroke3D::tree& boxes, const Input& in, const int x,
+	       const int y, std::vector<int>& hits, GLdouble& winz);
+GLuint selectBuffer(const std::vector<const Stroke3D*>& strokes,
+		    const Input& in, const int x, const int y,
+		    std::vector<GLuint>& buffer, GLdouble& winz);
+int benchPick(const char* name, const int ncopies, const int npicks);
+int feedbackProbe(const std::vector<const Stroke3D*>& strokes,
+		  const GLuint scene, const Input& in, const int x, const int y,
+		  std::vector<GLfloat>& buffer, GLdouble& winz);
+int cpuProbe(const std::vector<const Stroke3D*>& strokes,
+	     const Stroke3D::tree& boxes, const Scene_Mesh& scene,
+	     const Input& in, const int x, const int y, std::vector<int>& hits,
+	     GLdouble& winz);
+int benchProbe(const char* name, const int nprobes);
+template <class Strokes>
+double walkStrokes(const Strokes& strokes, const Clipping_Planes& planes,
+		   const int nframes, double& sum);
+template <class Strokes>
+double drawStrokes(const Strokes& strokes, const int nframes);
+int benchSlots(const char* name, const int ncopies, const int nframes);
+int benchCull(const char* name, const int ncopies, const int nframes);
+int benchOrder(const char* name, const int nremovals);
+
+/* Scratch arrays of the rays cast, as in Drawing */
+std::vector<Stroke3D::tree::real> hit_params;
+std::vector<Stroke3D::tree::vec> grid;
+
+/* Allocations counters */
+long nallocs = 0;
+long nblocks = 0; // Blocks in use
+long nbytes = 0;  // Bytes in use
+
+/* Blocks start with their size, on 16 bytes to keep them aligned */
+void* operator new(size_t size) throw (std::bad_alloc) {
+  nallocs++;
+  nblocks++;
+  nbytes += size;
+  char* p = static_cast<char*>(malloc(size + 16));
+  if (p == 0) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(p) = size;
+  return p + 16;
+}
+
+void operator delete(void* p) throw () {
+  if (p != 0) {
+    char* q = static_cast<char*>(p) - 16;
+    nblocks--;
+    nbytes -= *reinterpret_cast<size_t*>(q);
+    free(q);
+  }
+}
+
+/* Functions definition */
+
+/*
+ *  now :
+ *  Wall clock time in seconds.
+ */
+double now() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + 1.0e-6*tv.tv_usec;
+}
+
+void usage() {
+  printf("\n");
+  printf("Usage: bench <mode> [options]\n");
+  printf("kernel [npoints [nruns]]\tcubic evaluation, per point vs batch\n");
+  printf("spans [ncorners [nthreads [nruns]]]\tparallel fitting of spans\n");
+  printf("length [nstrokes [nruns]]\tarc length, sampling vs quadrature\n");
+  printf("traces <dir> [nruns [nthreads]]\tfitting of recorded inputs (JSON)\n");
+  printf("memory <file.dr>\tmemory per segment of a drawing\n");
+  printf("unproject [npoints [nruns]]\tgluUnProject vs cached inverse\n");
+  printf("reverse <file.dr> [nruns]\tstroke reversal, rebuild vs in place\n");
+  printf("boxes <file.dr> [nruns]\tstroke boxes, sampled vs control points\n");
+  printf("strokes <file.dr>\theap and resident memory of the strokes read\n");
+  printf("load <file.dr> [nruns]\tloading of strokes, copied vs swapped\n");
+  printf("graph [nstrokes [nrounds]]\tintersection graph, deletes and undos\n");
+  printf("planes <file.dr> [nframes]\tclipping planes, per stroke vs batch\n");
+  printf("tree <file.dr> [nstrokes...]\tstroke intersections, pairs vs tree\n");
+  printf("pick <file.dr> [ncopies [npicks]]\tpicking, GL_SELECT vs rays\n");
+  printf("slots <file.dr> [ncopies [nframes]]\tstrokes, list vs slot map\n");
+  printf("cull <file.dr> [ncopies [nframes]]\tfrustum culling\n");
+  printf("order <file.dr> [nremovals]\tdrawing order after removals\n");
+  printf("probe <file.dr> [nprobes]\tlocal planes, feedback vs CPU probes\n");
+  printf("\n");
+}
+
+/*
+ *  benchKernel :
+ *  Time the two inner loops of the curve fitter, computeMaxError and
+ *  reparameterize, on a synthetic stroke of npoints samples, first one point
+ *  at a time through Bezier (as Stroke2D used to), then in one batch through
+ *  Cubic_Kernel.
+ */
+void benchKernel(const int npoints, const int nruns) {
+  /* Samples of a wavy stroke, chord length parameterized */
+  points pts(npoints);
+  int i;
+  for (i = 0; i < npoints; i++) {
+    const real s = static_cast<real>(i)/(npoints - 1);
+    pts[i].pos = vec2(500.0*s, 100.0*sin(3.0*s) + 2.0*sin(97.0*s));
+  }
+  pts[0].u = 0.0;
+  for (i = 1; i < npoints; i++) {
+    pts[i].u = pts[i-1].u + dist(pts[i].pos, pts[i-1].pos);
+  }
+  for (i = 1; i < npoints; i++) {
+    pts[i].u /= pts[npoints-1].u;
+  }
+
+  /* A cubic roughly following it */
+  bezier b(3);
+  b.V[0] = pts[0].pos;
+  b.V[1] = vec2(170.0, 150.0);
+  b.V[2] = vec2(330.0, 60.0);
+  b.V[3] = pts[npoints-1].pos;
+  real cx[4], cy[4];
+  for (i = 0; i < 4; i++) {
+    cx[i] = b.V[i].x();
+    cy[i] = b.V[i].y();
+  }
+  Cubic_Kernel kernel(cx, cy);
+
+  /* SoA copies for the batch path */
+  std::vector<real> u(npoints), px(npoints), py(npoints), d(npoints);
+  for (i = 0; i < npoints; i++) {
+    px[i] = pts[i].pos.x();
+    py[i] = pts[i].pos.y();
+  }
+
+  /* Per point */
+  points work(pts);
+  real check_ref = 0.0;
+  double t0 = now();
+  for (int r = 0; r < nruns; r++) {
+    for (i = 0; i < npoints; i++) {
+      work[i].u = pts[i].u;
+    }
+    for (i = 0; i < npoints; i++) {
+      b.findNewtonRaphsonRoot(work[i]);
+    }
+    real maxDistance = 0.0;
+    for (i = 1; i < npoints-1; i++) {
+      vec2 P;
+      b.evaluate(work[i].u, P);
+      real distance = dist(P, work[i].pos);
+      if (distance > maxDistance) {
+	maxDistance = distance;
+      }
+    }
+    check_ref += maxDistance;
+  }
+  const double time_ref = now() - t0;
+
+  /* Batch */
+  real check_batch = 0.0;
+  t0 = now();
+  for (int r = 0; r < nruns; r++) {
+    for (i = 0; i < npoints; i++) {
+      u[i] = pts[i].u;
+    }
+    kernel.newtonStep(npoints, &u[0], &px[0], &py[0]);
+    kernel.evaluateDistances(npoints-2, &u[1], &px[1], &py[1], &d[1]);
+    real maxDistance = 0.0;
+    for (i = 1; i < npoints-1; i++) {
+      if (d[i] > maxDistance) {
+	maxDistance = d[i];
+      }
+    }
+    check_batch += maxDistance;
+  }
+  const double time_batch = now() - t0;
+
+#ifdef CUBIC_KERNEL_WIDTH
+  const int width = CUBIC_KERNEL_WIDTH;
+#else
+  const int width = 1;
+#endif
+  const double nevals = static_cast<double>(npoints)*nruns;
+  printf("kernel: %d points, %d runs, batch width %d\n",
+	 npoints, nruns, width);
+  printf("  per point: %8.2f ns/point\n", 1.0e9*time_ref/nevals);
+  printf("  batch:     %8.2f ns/point\n", 1.0e9*time_batch/nevals);
+  printf("  speedup:   %8.2f\n", time_ref/time_batch);
+  printf("  max error: %g (per point) %g (batch)\n",
+	 check_ref/nruns, check_batch/nruns);
+}
+
+/*
+ *  benchSpans :
+ *  Time the fitting of a jagged stroke, with ncorners corners delimiting
+ *  spans of uneven lengths, with one thread and then with nthreads threads
+ *  (as many as processors if 0).
+ */
+void benchSpans(const int ncorners, const int nthreads, const int nruns) {
+  /* Zigzag of smooth wavy spans, one pixel apart, as Input would keep */
+  points pts;
+  int i;
+  real x = 0.0;
+  for (i = 0; i <= ncorners; i++) {
+    const int n = 20 + (37*i)%180; // Magic number!
+    const real dir = i%2 ? -1.0 : 1.0;
+    for (int j = (i == 0 ? 0 : 1); j <= n; j++) {
+      const real s = static_cast<real>(j)/n;
+      pts.push_back(point(vec2(x + 4.0*j, 300.0*(i%2) + dir*(300.0*s) +
+			       10.0*sin(20.0*s))));
+    }
+    x += 4.0*n;
+  }
+
+  /* Corners, as Stroke2D::fit finds them */
+  std::vector<int> corners;
+  const int last = pts.size() - 1;
+  corners.push_back(0);
+  for (i = 1; i != last; i++) {
+    if (cosAng(pts[i+1].pos - pts[i].pos, pts[i-1].pos - pts[i].pos) > 0.0) {
+      corners.push_back(i);
+    }
+  }
+  corners.push_back(last);
+
+  Parallel_Fitter fitter;
+  Parallel_Fitter::beziers bs;
+  double times[2];
+  int nsegs[2];
+  for (int k = 0; k < 2; k++) {
+    fitter.setThreads(k == 0 ? 1 : nthreads);
+    const double t0 = now();
+    for (int r = 0; r < nruns; r++) {
+      bs.clear();
+      fitter.fitSpans(pts, corners, 4.0, bs);
+    }
+    times[k] = (now() - t0)/nruns;
+    nsegs[k] = bs.size();
+  }
+
+  printf("spans: %d points, %d spans, %d processors\n",
+	 static_cast<int>(pts.size()), static_cast<int>(corners.size()) - 1,
+	 Thread_Pool::processors());
+  printf("  1 thread:   %8.3f ms (%d cubics)\n", 1.0e3*times[0], nsegs[0]);
+  printf("  %d threads: %8.3f ms (%d cubics)\n", fitter.threads(),
+	 1.0e3*times[1], nsegs[1]);
+  printf("  speedup:    %8.2f\n", times[0]/times[1]);
+}
+
+/*
+ *  sampledLength :
+ *  The former Stroke2D::evalLength: a rough polyline pass, then a pass
+ *  with a number of steps proportional to the length of each cubic.
+ */
+void sampledLength(std::vector<bezier>& bs) {
+  const real steps_per_unit_length = 0.1; // As in Stroke2D
+  std::vector<bezier>::iterator b;
+  real length = 0.0;
+  for (b = bs.begin(); b != bs.end(); b++) {
+    (*b).length = 0.0;
+    (*b).evalLength(3);
+    length += (*b).length;
+  }
+  const real length_rough_inv = 1.0/length;
+  int nstep_tot = static_cast<int>(steps_per_unit_length*length);
+  if (nstep_tot < 3) {
+    nstep_tot = 3;
+  }
+  for (b = bs.begin(); b != bs.end(); b++) {
+    int nstep = static_cast<int>(((*b).length*length_rough_inv)*nstep_tot);
+    if (nstep == 0) {
+      nstep = 1;
+    }
+    (*b).length = 0.0;
+    (*b).evalLength(nstep);
+  }
+}
+
+/*
+ *  benchLength :
+ *  Time and compare the arc lengths of the cubics fitted to nstrokes random
+ *  strokes, sampled as Stroke2D used to, and by adaptive quadrature at
+ *  several error bounds. Reference lengths use a bound of 1e-12.
+ */
+void benchLength(const int nstrokes, const int nruns) {
+  typedef Arc_Length<real, vec2> arc_length;
+  Curve_Fitter fitter;
+  std::vector<bezier> bs;
+  unsigned long seed = 12345;
+  for (int k = 0; k < nstrokes; k++) {
+    points pts;
+    real x = 400.0, y = 300.0, a = 0.0;
+    const int n = 50 + k%400;
+    for (int i = 0; i < n; i++) {
+      seed = seed*1103515245UL + 12345UL;
+      a += 0.3*(((seed >> 16) & 0x7fff)/32768.0 - 0.5);
+      x += 4.0*cos(a);
+      y += 4.0*sin(a);
+      pts.push_back(point(vec2(x, y)));
+    }
+    fitter.fitCurve(pts, 0, n-1, 4.0, bs);
+  }
+  const int nbs = bs.size();
+  std::vector<real> exact(nbs);
+  int i;
+  for (i = 0; i < nbs; i++) {
+    exact[i] = arc_length::evaluate(&bs[i].V[0], 4, 1.0e-12);
+  }
+
+  printf("length: %d strokes, %d cubics, %d runs\n", nstrokes, nbs, nruns);
+  printf("  %-16s %12s %12s %12s\n",
+	 "method", "ns/cubic", "max abs err", "max rel err");
+  const real errors[] = {-1.0, 1.0e-1, 1.0e-3, 1.0e-6};
+  for (int m = 0; m < 4; m++) {
+    const double t0 = now();
+    for (int r = 0; r < nruns; r++) {
+      if (errors[m] < 0.0) {
+	sampledLength(bs);
+      }
+      else {
+	for (i = 0; i < nbs; i++) {
+	  bs[i].length = arc_length::evaluate(&bs[i].V[0], 4, errors[m]);
+	}
+      }
+    }
+    const double time = (now() - t0)/(static_cast<double>(nruns)*nbs);
+    real max_abs = 0.0, max_rel = 0.0;
+    for (i = 0; i < nbs; i++) {
+      const real e = fabs(bs[i].length - exact[i]);
+      if (e > max_abs) {
+	max_abs = e;
+      }
+      if (e/exact[i] > max_rel) {
+	max_rel = e/exact[i];
+      }
+    }
+    char name[32];
+    if (errors[m] < 0.0) {
+      sprintf(name, "sampled");
+    }
+    else {
+      sprintf(name, "gauss %g", errors[m]);
+    }
+    printf("  %-16s %12.1f %12.3g %12.3g\n", name, 1.0e9*time,
+	   max_abs, max_rel);
+  }
+}
+
+/*
+ *  listTraces :
+ *  Names of the regular files of a directory, in alphabetical order.
+ */
+bool listTraces(const char* dir_name, std::vector<string>& names) {
+  DIR* dir = opendir(dir_name);
+  if (dir == 0) {
+    return false;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != 0) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    const string name = string(dir_name) + "/" + entry->d_name;
+    struct stat st;
+    if (stat(name.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  sort(names.begin(), names.end());
+  return true;
+}
+
+/*
+ *  maxError :
+ *  Largest distance from the input points to the fitted curve, the latter
+ *  being flattened into a fine polyline.
+ */
+real maxError(const points& pts, const std::vector<bezier>& bs) {
+  const int nstep = 32; // Magic number!
+  std::vector<vec2> poly;
+  std::vector<bezier>::const_iterator b;
+  for (b = bs.begin(); b != bs.end(); b++) {
+    for (int i = (b == bs.begin() ? 0 : 1); i <= nstep; i++) {
+      vec2 Q;
+      (*b).evaluate(static_cast<real>(i)/nstep, Q);
+      poly.push_back(Q);
+    }
+  }
+  real error = 0.0;
+  for (points::const_iterator p = pts.begin(); p != pts.end(); p++) {
+    real d2_min = sqdist((*p).pos, poly[0]);
+    for (unsigned int i = 1; i < poly.size(); i++) {
+      const vec2 ab = poly[i] - poly[i-1];
+      const vec2 ap = (*p).pos - poly[i-1];
+      const real ab2 = ab.sqnorm();
+      real t = ab2 > 0.0 ? dot(ap, ab)/ab2 : 0.0;
+      t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+      const real d2 = (ap - t*ab).sqnorm();
+      if (d2 < d2_min) {
+	d2_min = d2;
+      }
+    }
+    if (d2_min > error) {
+      error = d2_min;
+    }
+  }
+  return sqrt(error);
+}
+
+/*
+ *  percentile :
+ *  Value below which lie p percent of v (nearest rank), v being sorted.
+ */
+double percentile(std::vector<double>& v, const double p) {
+  if (v.empty()) {
+    return 0.0;
+  }
+  sort(v.begin(), v.end());
+  int rank = static_cast<int>(ceil(0.01*p*v.size())) - 1;
+  if (rank < 0) {
+    rank = 0;
+  }
+  return v[rank];
+}
+
+/*
+ *  printString :
+ *  JSON string.
+ */
+void printString(const char* s) {
+  putchar('"');
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\') {
+      putchar('\\');
+    }
+    if (static_cast<unsigned char>(*s) < 0x20) {
+      printf("\\u%04x", *s);
+    }
+    else {
+      putchar(*s);
+    }
+  }
+  putchar('"');
+}
+
+/*
+ *  benchTraces :
+ *  Fit each input file of dir_name (as recorded by draw with 'r', read by
+ *  Input::read) nruns times into a Stroke2D, which also evaluates the
+ *  curvature centers, and print the results as JSON. Latencies are those
+ *  of whole strokes (Stroke2D construction), allocations those of the last
+ *  run, once the shared workspaces have grown. No GL context is needed.
+ */
+int benchTraces(const char* dir_name, const int nruns, const int nthreads) {
+  std::vector<string> names;
+  if (!listTraces(dir_name, names)) {
+    fprintf(stderr, "Error: cannot read directory %s !\n", dir_name);
+    return EXIT_FAILURE;
+  }
+  Stroke2D::fitter.setThreads(nthreads);
+
+  std::vector<double> times, times_all;
+  long npoints_all = 0;
+  double time_all = 0.0;
+  real error_all = 0.0;
+  printf("{\n");
+  printf("  \"benchmark\": \"traces\",\n");
+  printf("  \"directory\": ");
+  printString(dir_name);
+  printf(",\n");
+  printf("  \"runs\": %d,\n", nruns);
+  printf("  \"threads\": %d,\n", Stroke2D::fitter.threads());
+  printf("  \"traces\": [");
+  int ntraces = 0;
+  for (unsigned int k = 0; k < names.size(); k++) {
+    const string name = string(dir_name) + "/" + names[k];
+    Input in;
+    if (!in.read(name.c_str()) || in.positions.size() < 2) {
+      fprintf(stderr, "Warning: skipping %s\n", name.c_str());
+      continue;
+    }
+    const int npoints = in.positions.size();
+    times.clear();
+    long allocs = 0;
+    int nsegs = 0;
+    real error = 0.0;
+    for (int r = 0; r < nruns; r++) {
+      const long nallocs_prev = nallocs;
+      const double t0 = now();
+      Stroke2D stroke(in);
+      const double time = now() - t0;
+      times.push_back(time);
+      if (r == nruns - 1) {
+	allocs = nallocs - nallocs_prev;
+	nsegs = stroke.bs.size();
+	error = maxError(in.positions, stroke.bs);
+      }
+    }
+    double time_tot = 0.0;
+    for (int r = 0; r < nruns; r++) {
+      time_tot += times[r];
+    }
+    times_all.insert(times_all.end(), times.begin(), times.end());
+    npoints_all += static_cast<long>(npoints)*nruns;
+    time_all += time_tot;
+    if (error > error_all) {
+      error_all = error;
+    }
+    printf("%s\n    {\"name\": ", ntraces == 0 ? "" : ",");
+    printString(names[k].c_str());
+    printf(", \"points\": %d, \"segments\": %d, "
+	   "\"points_per_s\": %.1f, \"max_error\": %.4f, "
+	   "\"allocations\": %ld, \"latency_ms\": "
+	   "{\"p50\": %.4f, \"p99\": %.4f}}",
+	   npoints, nsegs, npoints*nruns/time_tot, error, allocs,
+	   1.0e3*percentile(times, 50.0), 1.0e3*percentile(times, 99.0));
+    ntraces++;
+  }
+  printf("%s],\n", ntraces == 0 ? "" : "\n  ");
+  printf("  \"summary\": {\"traces\": %d, \"points_per_s\": %.1f, "
+	 "\"max_error\": %.4f, \"latency_ms\": "
+	 "{\"p50\": %.4f, \"p99\": %.4f}}\n",
+	 ntraces, time_all > 0.0 ? npoints_all/time_all : 0.0, error_all,
+	 1.0e3*percentile(times_all, 50.0), 1.0e3*percentile(times_all, 99.0));
+  printf("}\n");
+  return EXIT_SUCCESS;
+}
+
+/*
+ *  readSegments :
+ *  The curves of the strokes of a drawing file, as Stroke3D::read reads
+ *  them, leaving everything else out.
+ */
+template <class Bezier3>
+bool readSegments(const char* name, std::vector< std::vector<Bezier3> >& ss) {
+  ifstream file_in(name);
+  if (!file_in) {
+    return false;
+  }
+  char line[256];
+  file_in.getline(line, 256, '\n');
+  int n;
+  sscanf(line, "%d", &n);
+  ss.resize(n);
+  for (int i = 0; i < n; i++) {
+    file_in.getline(line, 256, '\n');
+    int m;
+    sscanf(line, "%d", &m);
+    ss[i].reserve(m);
+    for (int k = 0; k < 5; k++) { // Length, normal, radius, mode, color
+      file_in.getline(line, 256, '\n');
+    }
+    for (int j = 0; j < m; j++) {
+      file_in.getline(line, 256, '\n'); // Relative length
+      Bezier3 bez;
+      if (!bez.read(file_in)) {
+	return false;
+      }
+      ss[i].push_back(bez);
+    }
+  }
+  file_in.close();
+  return true;
+}
+
+/*
+ *  measureSegments :
+ *  Heap bytes and blocks in use per segment once a drawing is read (the
+ *  curve itself included, as an element of the vector of its stroke).
+ */
+template <class Bezier3>
+bool measureSegments(const char* name, const char* type_name) {
+  std::vector< std::vector<Bezier3> > ss;
+  const long nbytes_prev = nbytes;
+  const long nallocs_prev = nallocs;
+  if (!readSegments(name, ss)) {
+    return false;
+  }
+  const long bytes = nbytes - nbytes_prev;
+  const long nblocks = nallocs - nallocs_prev;
+  int nsegs = 0;
+  for (unsigned int i = 0; i < ss.size(); i++) {
+    nsegs += ss[i].size();
+  }
+  printf("  %-28s %8d %8d %10.1f %10.2f\n", type_name,
+	 static_cast<int>(sizeof(Bezier3)), nsegs,
+	 static_cast<double>(bytes)/nsegs, static_cast<double>(nblocks)/nsegs);
+  return true;
+}
+
+/*
+ *  roundingError :
+ *  Largest distance between the control points of the curves of a drawing
+ *  read in double and in single precision.
+ */
+double roundingError(const char* name) {
+  std::vector< std::vector< Bezier_Augmented<real, Vec3<real>, 3> > > ss;
+  std::vector< std::vector< Bezier_Augmented<float, Vec3<float>, 3> > > ss_f;
+  if (!readSegments(name, ss) || !readSegments(name, ss_f)) {
+    return -1.0;
+  }
+  double error = 0.0;
+  for (unsigned int i = 0; i < ss.size(); i++) {
+    for (unsigned int j = 0; j < ss[i].size(); j++) {
+      for (unsigned int k = 0; k < ss[i][j].V.size(); k++) {
+	const Vec3<float>& v_f = ss_f[i][j].V[k];
+	const Vec3<real> v(v_f[0], v_f[1], v_f[2]);
+	error = max(error, static_cast<double>((ss[i][j].V[k] - v).norm()));
+      }
+    }
+  }
+  return error;
+}
+
+/*
+ *  benchMemory :
+ *  Memory per segment of the curves of a drawing, with their data on the
+ *  heap (any degree) or inline (cubics), in double or single precision.
+ */
+int benchMemory(const char* name) {
+  typedef Vec3<real> vec3;
+  typedef Vec3<float> vec3f;
+  printf("memory: %s\n", name);
+  printf("  %-28s %8s %8s %10s %10s\n",
+	 "type", "sizeof", "segments", "bytes/seg", "allocs/seg");
+  if (!measureSegments< Bezier_Augmented<real, vec3> >(name,
+							 "Bezier_Augmented<vec3>") ||
+      !measureSegments< Bezier_Augmented<real, vec3, 3> >(name,
+							    "Bezier_Augmented<vec3, 3>") ||
+      !measureSegments< Bezier_Augmented<float, vec3f, 3> >(name,
+							     "Bezier_Augmented<vec3f, 3>")) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  printf("  single precision rounding error: %g\n", roundingError(name));
+  return EXIT_SUCCESS;
+}
+
+/*
+ *  benchUnproject :
+ *  Time the unprojection of npoints window points, with the camera of the
+ *  drawing board, through gluUnProject (one inversion per point), then
+ *  through Unprojector one point at a time and in one batch.
+ */
+void benchUnproject(const int npoints, const int nruns) {
+  /* gluPerspective(60.0, 4/3, 1.0, 10.0) and a rotated, moved away scene */
+  const GLint viewport[4] = {0, 0, 800, 600};
+  const GLdouble f = 1.0/tan(M_PI/6.0), aspect = 800.0/600.0;
+  const GLdouble near = 1.0, far = 10.0;
+  GLdouble proj[16], mv[16];
+  nullM(proj);
+  proj[0] = f/aspect;
+  proj[5] = f;
+  proj[10] = (far + near)/(near - far);
+  proj[11] = -1.0;
+  proj[14] = 2.0*far*near/(near - far);
+  const GLdouble a = 0.3, c = cos(a), s = sin(a);
+  identityM(mv);
+  mv[0] = c;  mv[2] = -s;
+  mv[8] = s;  mv[10] = c;
+  mv[12] = 0.1; mv[13] = -0.2; mv[14] = -5.0;
+
+  /* Window points, x, y and z in turn */
+  std::vector<GLdouble> wins(3*npoints), objs(3*npoints), objs_ref(3*npoints);
+  srand(1);
+  int i;
+  for (i = 0; i < npoints; i++) {
+    wins[3*i    ] = viewport[2]*(rand()/(RAND_MAX + 1.0));
+    wins[3*i + 1] = viewport[3]*(rand()/(RAND_MAX + 1.0));
+    wins[3*i + 2] = rand()/(RAND_MAX + 1.0);
+  }
+
+  double t0 = now();
+  for (int r = 0; r < nruns; r++) {
+    for (i = 0; i < npoints; i++) {
+      gluUnProject(wins[3*i], wins[3*i + 1], wins[3*i + 2],
+		   mv, proj, viewport,
+		   &objs_ref[3*i], &objs_ref[3*i + 1], &objs_ref[3*i + 2]);
+    }
+  }
+  const double time_glu = now() - t0;
+
+  Unprojector unprojector;
+  t0 = now();
+  for (int r = 0; r < nruns; r++) {
+    unprojector.setMatrices(mv, proj, viewport); // Once per camera change
+    for (i = 0; i < npoints; i++) {
+      unprojector.unproject(wins[3*i], wins[3*i + 1], wins[3*i + 2],
+			    &objs[3*i], &objs[3*i + 1], &objs[3*i + 2]);
+    }
+  }
+  const double time_point = now() - t0;
+
+  t0 = now();
+  for (int r = 0; r < nruns; r++) {
+    unprojector.setMatrices(mv, proj, viewport);
+    unprojector.unproject(npoints, &wins[0], &objs[0]);
+  }
+  const double time_batch = now() - t0;
+
+  double error = 0.0;
+  for (i = 0; i < 3*npoints; i++) {
+    error = max(error, fabs(objs[i] - objs_ref[i])/max(1.0, fabs(objs_ref[i])));
+  }
+#if __AVX__
+  const char* simd = "AVX";
+#elif __SSE2__
+  const char* simd = "SSE2";
+#else
+  const char* simd = "none";
+#endif
+  const double nevals = static_cast<double>(npoints)*nruns;
+  printf("unproject: %d points, %d runs, SIMD %s\n", npoints, nruns, simd);
+  printf("  gluUnProject: %8.2f ns/point\n", 1.0e9*time_glu/nevals);
+  printf("  per point:    %8.2f ns/point\n", 1.0e9*time_point/nevals);
+  printf("  batch:        %8.2f ns/point\n", 1.0e9*time_batch/nevals);
+  printf("  speedup:      %8.2f (per point) %8.2f (batch)\n",
+	 time_glu/time_point, time_glu/time_batch);
+  printf("  max relative difference: %g\n", error);
+}
+
+/*
+ *  readStrokes :
+ *  The strokes of a drawing file, as Drawing::read reads them.
+ */
+bool readStrokes(const char* name, const int window,
+		 std::list<Stroke3D>& strokes) {
+  ifstream file_in(name);
+  if (!file_in) {
+    return false;
+  }
+  char line[256];
+  file_in.getline(line, 256, '\n');
+  int n;
+  sscanf(line, "%d", &n);
+  for (int i = 0; i < n; i++) {
+    strokes.push_back(Stroke3D());
+    if (!strokes.back().read(file_in, window)) {
+      strokes.pop_back();
+      return false;
+    }
+  }
+  file_in.close();
+  return true;
+}
+
+template <class T>
+bool sameBits(const T& a, const T& b) {
+  return memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+/*
+ *  sameStrokes :
+ *  True if the curves, patches, bounding boxes, barycenters and meshes of
+ *  two strokes are bit-identical.
+ */
+bool sameStrokes(const Stroke3D& a, const Stroke3D& b) {
+  if (a.bs.size() != b.bs.size() ||
+      a.proba_surface.size() != b.proba_surface.size()) {
+    return false;
+  }
+  unsigned int i, j;
+  for (i = 0; i < a.bs.size(); i++) {
+    for (j = 0; j < a.bs[i].C.size(); j++) {
+      if (!sameBits(a.bs[i].C[j], b.bs[i].C[j]) ||
+	  !sameBits(a.bs[i].N[j], b.bs[i].N[j])) {
+	return false;
+      }
+    }
+  }
+  for (i = 0; i < a.proba_surface.size(); i++) {
+    if (a.proba_surface[i].V.size() != b.proba_surface[i].V.size()) {
+      return false;
+    }
+    for (j = 0; j < a.proba_surface[i].V.size(); j++) {
+      if (!sameBits(a.proba_surface[i].V[j], b.proba_surface[i].V[j])) {
+	return false;
+      }
+    }
+  }
+  if (!sameBits(a.box.min, b.box.min) || !sameBits(a.box.max, b.box.max) ||
+      !sameBits(a.barycenter_global, b.barycenter_global)) {
+    return false;
+  }
+#ifndef EVALUATORS
+  std::vector<GLfloat> data_a, data_b;
+  a.proba_surface_mesh.readData(data_a);
+  b.proba_surface_mesh.readData(data_b);
+  if (data_a.size() != data_b.size() ||
+      (!data_a.empty() &&
+       memcmp(&data_a[0], &data_b[0], data_a.size()*sizeof(GLfloat)) != 0)) {
+    return false;
+  }
+#endif
+  return true;
+}
+
+/*
+ *  benchReverse :
+ *  Time the reversal of all the strokes of a drawing, nruns times, with the
+ *  surfaces and GL data built again (as Stroke3D::reverse used to), then
+ *  updated in place, and check that both give bit-identical strokes.
+ */
+int benchReverse(const char* name, const int nruns) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> rebuilt, updated;
+  if (!readStrokes(name, window, rebuilt) ||
+      !readStrokes(name, window, updated)) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  std::list<Stroke3D>::iterator p, q;
+  
+  double t0 = now();
+  for (int r = 0; r < nruns; r++) {
+    for (p = rebuilt.begin(); p != rebuilt.end(); p++) {
+      (*p).reverse(window, false);
+    }
+  }
+  glFinish();
+  const double time_rebuild = now() - t0;
+  
+  t0 = now();
+  for (int r = 0; r < nruns; r++) {
+    for (p = updated.begin(); p != updated.end(); p++) {
+      (*p).reverse(window);
+    }
+  }
+  glFinish();
+  const double time_update = now() - t0;
+  
+  int ndiffs = 0;
+  for (p = rebuilt.begin(), q = updated.begin(); p != rebuilt.end();
+       p++, q++) {
+    if (!sameStrokes(*p, *q)) {
+      ndiffs++;
+    }
+  }
+  
+  const double nreversals = static_cast<double>(rebuilt.size())*nruns;
+  printf("reverse: %s, %d strokes, %d runs\n", name,
+	 static_cast<int>(rebuilt.size()), nruns);
+  printf("  rebuild:  %10.2f us/stroke\n", 1.0e6*time_rebuild/nreversals);
+  printf("  in place: %10.2f us/stroke\n", 1.0e6*time_update/nreversals);
+  printf("  speedup:  %10.2f\n", time_rebuild/time_update);
+  printf("  strokes differing: %d\n", ndiffs);
+  for (p = rebuilt.begin(), q = updated.begin(); p != rebuilt.end();
+       p++, q++) {
+    (*p).clean(window);
+    (*q).clean(window);
+  }
+  glutDestroyWindow(window);
+  return ndiffs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *  sampledBox :
+ *  Box of the points of the patches of a stroke on a grid, as
+ *  Stroke3D::computeBoundingBox used to compute it.
+ */
+box3 sampledBox(const Stroke3D& s) {
+  typedef box3::vec vec3;
+  const int nstep_v = 3;
+  const box3::real stepsize_v = 1.0/nstep_v;
+  vec3 Q;
+  std::vector<vec3> points;
+  for (unsigned int index = 0; index < s.proba_surface.size(); index++) {
+    int nstep_u = static_cast<int>(0.5*s.nsteps[index]);
+    if (nstep_u == 0) {
+      nstep_u = 1;
+    }
+    const box3::real stepsize_u = 1.0/nstep_u;
+    for (int i = 0; i < nstep_u + 1; i++) {
+      for (int j = 0; j < nstep_v + 1; j++) {
+	s.proba_surface[index].evaluate(i*stepsize_u, j*stepsize_v, Q);
+	points.push_back(Q + s.transform);
+      }
+    }
+  }
+  return box3(points);
+}
+
+/*
+ *  intersectingPairs :
+ *  Pairs of intersecting boxes, that is pairs of strokes Drawing::addStroke
+ *  links when the strokes are added in turn.
+ */
+int intersectingPairs(const std::vector<box3>& boxes) {
+  int npairs = 0;
+  for (unsigned int i = 1; i < boxes.size(); i++) {
+    for (unsigned int j = 0; j < i; j++) {
+      if (boxes[i].isIntersectedBy(boxes[j])) {
+	npairs++;
+      }
+    }
+  }
+  return npairs;
+}
+
+/*
+ *  benchBoxes :
+ *  Time the bounding boxes of the strokes of a drawing, sampled on the
+ *  patches (as they used to be) or built from their control points with
+ *  0 to 4 subdivisions, and count the intersecting pairs each gives.
+ *  Boxes built from control points contain the patches, sampled ones may
+ *  miss part of them.
+ */
+int benchBoxes(const char* name, const int nruns) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  if (!readStrokes(name, window, strokes)) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  const int nstrokes = strokes.size();
+  std::list<Stroke3D>::iterator p;
+  std::vector<box3> sampled, boxes;
+  sampled.reserve(nstrokes);
+  boxes.reserve(nstrokes);
+  
+  double t0 = now();
+  for (int r = 0; r < nruns; r++) {
+    sampled.clear();
+    for (p = strokes.begin(); p != strokes.end(); p++) {
+      sampled.push_back(sampledBox(*p));
+    }
+  }
+  const double time_sampled = now() - t0;
+  double volume_sampled = 0.0;
+  int i;
+  for (i = 0; i < nstrokes; i++) {
+    const box3::vec d = sampled[i].max - sampled[i].min;
+    volume_sampled += d[0]*d[1]*d[2];
+  }
+  
+  printf("boxes: %s, %d strokes, %d runs\n", name, nstrokes, nruns);
+  printf("  %-14s %10s %8s %10s %12s\n",
+	 "box", "us/stroke", "pairs", "volume", "not sampled");
+  printf("  %-14s %10.2f %8d %10.3f %12s\n", "sampled",
+	 1.0e6*time_sampled/(static_cast<double>(nstrokes)*nruns),
+	 intersectingPairs(sampled), 1.0, "-");
+  const int subdivisions = Stroke3D::box_subdivisions;
+  for (int k = 0; k <= 4; k++) {
+    Stroke3D::box_subdivisions = k;
+    t0 = now();
+    for (int r = 0; r < nruns; r++) {
+      for (p = strokes.begin(); p != strokes.end(); p++) {
+	(*p).computeBoundingBox();
+      }
+    }
+    const double time_hull = now() - t0;
+    boxes.clear();
+    for (p = strokes.begin(); p != strokes.end(); p++) {
+      boxes.push_back((*p).box);
+    }
+    double volume = 0.0;
+    int nmissed = 0; // Boxes not containing the sampled box
+    for (i = 0; i < nstrokes; i++) {
+      const box3::vec d = boxes[i].max - boxes[i].min;
+      volume += d[0]*d[1]*d[2];
+      if (!boxes[i].contains(sampled[i])) {
+	nmissed++;
+      }
+    }
+    char label[32];
+    sprintf(label, "hull, %d subd.", k);
+    printf("  %-14s %10.2f %8d %10.3f %12d\n", label,
+	   1.0e6*time_hull/(static_cast<double>(nstrokes)*nruns),
+	   intersectingPairs(boxes), volume/volume_sampled, nmissed);
+  }
+  Stroke3D::box_subdivisions = subdivisions;
+  for (p = strokes.begin(); p != strokes.end(); p++) {
+    (*p).clean(window);
+  }
+  glutDestroyWindow(window);
+  return EXIT_SUCCESS;
+}
+
+/*
+ *  drawFrames :
+ *  Time nframes frames of the strokes (splines or probability surfaces),
+ *  with a camera orbiting around them on a turn and zooming out to four
+ *  times the distance of the camera of the drawing board and back, twice,
+ *  at their initial level of detail or with levels of detail.
+ */
+void drawFrames(std::list<Stroke3D>& strokes, const int window,
+		const int nframes, const bool lod) {
+  Input in;
+  in.window = window;
+  in.viewport[0] = 0; in.viewport[1] = 0;
+  in.viewport[2] = 800; in.viewport[3] = 600;
+  glViewport(0, 0, 800, 600);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPerspective(60.0, 800.0/600.0, 1.0, 10.0); // As the drawing board
+  glGetDoublev(GL_PROJECTION_MATRIX, in.proj_matrix);
+  glMatrixMode(GL_MODELVIEW);
+  
+  std::list<Stroke3D>::iterator p;
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_MAP1_VERTEX_3);
+  std::vector<double> times(nframes);
+  long ntriangles = 0, nvertices = 0, nvertices_max = 0;
+  for (int f = 0; f < nframes; f++) {
+    const double phase = static_cast<double>(f)/nframes;
+    const double zoom = 0.75*(1.0 - cos(4.0*M_PI*phase)) - 0.5;
+    glLoadIdentity();
+    glTranslated(0.0, 0.0, -2.05*pow(2.0, zoom)); // Board camera at 2.05
+    glRotated(20.0, 1.0, 0.0, 0.0);
+    glRotated(360.0*phase, 0.0, 1.0, 0.0);
+    glGetDoublev(GL_MODELVIEW_MATRIX, in.mv_matrix);
+    
+    const double t0 = now();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    int budget = Stroke3D::lod_budget;
+    for (p = strokes.begin(); p != strokes.end(); p++) {
+      if (lod) {
+	(*p).setLevelOfDetail(in, budget);
+      }
+      if ((*p).drawing_mode == Stroke3D::LINE) {
+	(*p).drawSpline();
+      }
+      else {
+	(*p).drawProbaSurface();
+      }
+#ifndef EVALUATORS
+      ntriangles += (*p).proba_surface_mesh.triangles();
+#endif
+    }
+    glFinish();
+    times[f] = now() - t0;
+    nvertices += Stroke3D::lod_budget - budget;
+    nvertices_max = max(nvertices_max,
+			static_cast<long>(Stroke3D::lod_budget - budget));
+  }
+  double mean = 0.0;
+  for (int f = 0; f < nframes; f++) {
+    mean += times[f];
+  }
+  mean /= nframes;
+  const double p99 = percentile(times, 99.0); // Sorts the times
+  printf("  %-6s %8.2f %8.2f %8.2f %8.1f %10ld %10ld\n",
+	 lod ? "lod" : "fixed", 1.0e3*mean, 1.0e3*p99, 1.0e3*times.back(),
+	 1.0e-3*ntriangles/nframes, nvertices, nvertices_max);
+}
+
+/*
+ *  benchLod :
+ *  Frame times of a drawing while orbiting, at the initial level of detail
+ *  of the strokes and with levels of detail.
+ */
+int benchLod(const char* name, const int nframes) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  glutInitWindowSize(800, 600);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  if (!readStrokes(name, window, strokes) || strokes.empty()) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  printf("lod: %s, %d strokes, %d frames\n", name,
+	 static_cast<int>(strokes.size()), nframes);
+  printf("  %-6s %8s %8s %8s %8s %10s %10s\n", "steps", "ms/frame",
+	 "99%", "max", "ktri", "vertices", "max/frame");
+  drawFrames(strokes, window, nframes, false);
+  drawFrames(strokes, window, nframes, true);
+  for (std::list<Stroke3D>::iterator p = strokes.begin();
+       p != strokes.end(); p++) {
+    (*p).clean(window);
+  }
+  glutDestroyWindow(window);
+  return EXIT_SUCCESS;
+}
+
+/*
+ *  residentBytes :
+ *  Resident memory of the process (Linux), 0 if unknown.
+ */
+long residentBytes() {
+  FILE* file_in = fopen("/proc/self/statm", "r");
+  if (file_in == 0) {
+    return 0;
+  }
+  long size = 0, resident = 0;
+  if (fscanf(file_in, "%ld %ld", &size, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(file_in);
+  return resident*sysconf(_SC_PAGESIZE);
+}
+
+/*
+ *  benchStrokes :
+ *  Heap blocks and bytes of the strokes of a drawing once read (curves,
+ *  surfaces and tessellations), allocations while reading them, and growth
+ *  of the resident memory.
+ */
+int benchStrokes(const char* name) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  const long nallocs_prev = nallocs;
+  const long nblocks_prev = nblocks;
+  const long nbytes_prev = nbytes;
+  const long resident_prev = residentBytes();
+  if (!readStrokes(name, window, strokes)) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  const long resident = residentBytes() - resident_prev;
+  const long allocs = nallocs - nallocs_prev;
+  const long blocks = nblocks - nblocks_prev;
+  const long bytes = nbytes - nbytes_prev;
+  const double nstrokes = strokes.size();
+  int nsegs = 0;
+  for (std::list<Stroke3D>::const_iterator p = strokes.begin();
+       p != strokes.end(); p++) {
+    nsegs += (*p).bs.size();
+  }
+  
+  printf("strokes: %s, %d strokes, %d segments, sizeof(Stroke3D) %d\n",
+	 name, static_cast<int>(nstrokes), nsegs,
+	 static_cast<int>(sizeof(Stroke3D)));
+  printf("  %-22s %12s %12s\n", "", "total", "per stroke");
+  printf("  %-22s %12ld %12.1f\n", "allocations (reading)", allocs,
+	 allocs/nstrokes);
+  printf("  %-22s %12ld %12.1f\n", "heap blocks in use", blocks,
+	 blocks/nstrokes);
+  printf("  %-22s %12ld %12.1f\n", "heap bytes in use", bytes,
+	 bytes/nstrokes);
+  printf("  %-22s %12ld %12.1f\n", "resident bytes", resident,
+	 resident/nstrokes);
+  return EXIT_SUCCESS;
+}
+
+/*
+ *  loadStrokes :
+ *  Time to read the strokes of a drawing into a list, each stroke being
+ *  read into a local one then copied into the list (as Drawing::read used
+ *  to) or swapped with an empty stroke of the list (-1 if the file is
+ *  corrupt). The number of allocations while loading is returned too.
+ */
+double loadStrokes(const char* name, const int window, const bool copy,
+		   long& allocs) {
+  std::list<Stroke3D> strokes;
+  ifstream file_in(name);
+  if (!file_in) {
+    return -1.0;
+  }
+  char line[256];
+  file_in.getline(line, 256, '\n');
+  int n;
+  sscanf(line, "%d", &n);
+  const long nallocs_prev = nallocs;
+  const double t0 = now();
+  bool ok = true;
+  for (int i = 0; i < n; i++) {
+    Stroke3D s;
+    if (!s.read(file_in, window)) {
+      ok = false;
+      break;
+    }
+    if (copy) {
+      strokes.push_back(s);
+    }
+    else {
+      strokes.push_back(Stroke3D());
+      strokes.back().swap(s);
+    }
+  }
+  const double time = now() - t0;
+  allocs = nallocs - nallocs_prev;
+  file_in.close();
+  for (std::list<Stroke3D>::iterator p = strokes.begin(); p != strokes.end();
+       p++) {
+    (*p).clean(window);
+  }
+  return ok ? time : -1.0;
+}
+
+/*
+ *  benchLoad :
+ *  Time the loading of the strokes of a drawing, nruns times, with each
+ *  stroke copied into the list then swapped into it.
+ */
+int benchLoad(const char* name, const int nruns) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  if (!readStrokes(name, window, strokes)) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  const double nstrokes = strokes.size();
+  for (std::list<Stroke3D>::iterator p = strokes.begin(); p != strokes.end();
+       p++) {
+    (*p).clean(window);
+  }
+  
+  printf("load: %s, %d strokes, %d runs\n", name,
+	 static_cast<int>(nstrokes), nruns);
+  printf("  %-8s %10s %10s %14s\n",
+	 "stroke", "ms", "us/stroke", "allocs/stroke");
+  const char* names[2] = {"copied", "swapped"};
+  for (int k = 0; k < 2; k++) {
+    std::vector<double> times;
+    long allocs = 0;
+    for (int r = 0; r < nruns; r++) {
+      times.push_back(loadStrokes(name, window, k == 0, allocs));
+    }
+    const double median = percentile(times, 50.0);
+    printf("  %-8s %10.2f %10.2f %14.1f\n", names[k],
+	   1.0e3*median, 1.0e6*median/nstrokes, allocs/nstrokes);
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ *  sameNeighbours :
+ *  True if the graph is valid and links exactly the alive strokes whose
+ *  boxes intersect.
+ */
+bool sameNeighbours(const Intersection_Graph<int>& g,
+		    const std::vector<int>& nodes, const std::vector<bool>& alive,
+		    const std::vector<box3>& boxes) {
+  if (!g.valid()) {
+    return false;
+  }
+  const int n = boxes.size();
+  std::vector<int> expected, found;
+  int nalive = 0;
+  for (int i = 0; i < n; i++) {
+    if (!alive[i]) {
+      continue;
+    }
+    nalive++;
+    expected.clear();
+    found.clear();
+    for (int j = 0; j < n; j++) {
+      if (j != i && alive[j] && boxes[i].isIntersectedBy(boxes[j])) {
+	expected.push_back(j);
+      }
+    }
+    for (int k = 0; k < g.degree(nodes[i]); k++) {
+      found.push_back(g.value(g.neighbour(nodes[i], k)));
+    }
+    sort(found.begin(), found.end());
+    if (g.value(nodes[i]) != i || found != expected) {
+      return false;
+    }
+  }
+  return g.nodes() == nalive;
+}
+
+/*
+ *  benchGraph :
+ *  Stress test of the intersection graph of nstrokes random boxes: each
+ *  round deletes a tenth of the strokes at random, then undoes the deletes
+ *  in reverse order, and checks the graph against all pairs of boxes after
+ *  both. Deletes are timed against lists of neighbours cleaned by linear
+ *  search (as Stroke3D did).
+ */
+int benchGraph(const int nstrokes, const int nrounds) {
+  typedef box3::vec vec;
+  srand(1);
+  std::vector<box3> boxes;
+  int i;
+  for (i = 0; i < nstrokes; i++) {
+    const vec center(rand()/(RAND_MAX + 1.0), rand()/(RAND_MAX + 1.0),
+		     rand()/(RAND_MAX + 1.0));
+    const vec half(0.01 + 0.09*(rand()/(RAND_MAX + 1.0)),
+		   0.01 + 0.09*(rand()/(RAND_MAX + 1.0)),
+		   0.01 + 0.09*(rand()/(RAND_MAX + 1.0)));
+    boxes.push_back(box3(center - half, center + half));
+  }
+  
+  Intersection_Graph<int> g;
+  std::vector< std::list<int> > lists(nstrokes);
+  std::vector<int> nodes(nstrokes);
+  std::vector<bool> alive(nstrokes, false);
+  std::vector<int> undo;
+  double time_graph = 0.0, time_lists = 0.0;
+  int ndeletes = 0, nfailures = 0;
+  for (int r = 0; r <= nrounds; r++) {
+    /* Undo of the deletes (all strokes added at first) */
+    if (r == 0) {
+      for (i = nstrokes - 1; i >= 0; i--) {
+	undo.push_back(i);
+      }
+    }
+    while (!undo.empty()) {
+      i = undo.back();
+      undo.pop_back();
+      nodes[i] = g.addNode(i);
+      for (int j = 0; j < nstrokes; j++) {
+	if (alive[j] && boxes[i].isIntersectedBy(boxes[j])) {
+	  g.addEdge(nodes[i], nodes[j]);
+	  lists[i].push_back(j);
+	  lists[j].push_back(i);
+	}
+      }
+      alive[i] = true;
+    }
+    if (!sameNeighbours(g, nodes, alive, boxes)) {
+      nfailures++;
+    }
+    if (r == nrounds) {
+      break;
+    }
+    
+    /* Deletes */
+    for (int k = 0; k < nstrokes/10; k++) {
+      do {
+	i = rand() % nstrokes;
+      } while (!alive[i]);
+      double t0 = now();
+      g.removeNode(nodes[i]);
+      time_graph += now() - t0;
+      t0 = now();
+      for (std::list<int>::const_iterator p = lists[i].begin();
+	   p != lists[i].end(); p++) {
+	std::list<int>& l = lists[*p];
+	l.erase(find(l.begin(), l.end(), i));
+      }
+      lists[i].clear();
+      time_lists += now() - t0;
+      alive[i] = false;
+      undo.push_back(i);
+      ndeletes++;
+    }
+    if (!sameNeighbours(g, nodes, alive, boxes)) {
+      nfailures++;
+    }
+  }
+  
+  printf("graph: %d strokes, %d rounds, %d edges, mean degree %.1f\n",
+	 nstrokes, nrounds, g.edges(), 2.0*g.edges()/nstrokes);
+  printf("  %d deletes and undos, %d failed checks\n", ndeletes, nfailures);
+  printf("  %-8s %12s\n", "delete", "us/stroke");
+  printf("  %-8s %12.3f\n", "lists", 1.0e6*time_lists/ndeletes);
+  printf("  %-8s %12.3f\n", "graph", 1.0e6*time_graph/ndeletes);
+  return nfailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *  strokePlanes :
+ *  Clipping planes of one stroke, as Stroke3D::setClippingPlanesEqns used
+ *  to compute them when the view changed.
+ */
+void strokePlanes(const box3::vec& barycenter, const box3::real mean_radius,
+		  box3::vec view_vector, GLdouble equations[2][4]) {
+  typedef box3::vec vec3;
+  vec3 normal_curr = - view_vector;
+  std::vector<vec3> points;
+  std::vector<vec3> normals;
+  const box3::real ratio = 0.2;
+  vec3 point_offset = ratio*mean_radius*normal_curr;
+  points.push_back(barycenter + point_offset);
+  points.push_back(barycenter - point_offset);
+  normals.push_back(-normal_curr);
+  normals.push_back( normal_curr);
+  for (int i = 0; i < 2; i++) {
+    equations[i][3] = 0.0;
+    for (int j = 0; j < 3; j++) {
+      equations[i][j]  = normals[i][j];
+      equations[i][3] -= normals[i][j]*points[i][j];
+    }
+  }
+}
+
+/*
+ *  benchPlanes :
+ *  Time the clipping planes of all the strokes of a drawing (and of 100
+ *  copies of them) for nframes views around the drawing, one stroke at a
+ *  time (as Stroke3D::move did) then in one batch through Clipping_Planes,
+ *  and check that both give the same equations.
+ */
+int benchPlanes(const char* name, const int nframes) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  if (!readStrokes(name, window, strokes)) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  std::vector<box3::vec> barycenters;
+  std::vector<box3::real> radii;
+  std::list<Stroke3D>::iterator p;
+  for (p = strokes.begin(); p != strokes.end(); p++) {
+    barycenters.push_back((*p).barycenter_global);
+    radii.push_back((*p).mean_radius);
+    (*p).clean(window);
+  }
+  
+  printf("planes: %s, %d frames\n", name, nframes);
+  printf("  %8s %12s %12s %10s %10s\n",
+	 "strokes", "per stroke", "batch", "speedup", "differing");
+  int ndiffs = 0;
+  for (int copies = 1; copies <= 100; copies *= 100) {
+    const int n = copies*barycenters.size();
+    Clipping_Planes planes;
+    int i;
+    for (i = 0; i < n; i++) {
+      const box3::vec& b = barycenters[i % barycenters.size()];
+      const GLdouble barycenter[3] = {b[0], b[1], b[2]};
+      planes.set(i, barycenter, radii[i % radii.size()]);
+    }
+    std::vector<GLdouble> equations(8*n);
+    double time_stroke = 0.0, time_batch = 0.0;
+    int ndiffs_copies = 0;
+    for (int f = 0; f < nframes; f++) {
+      const double angle = 2.0*M_PI*f/nframes;
+      const GLdouble view[3] = {sin(angle), -0.3, -cos(angle)};
+      const box3::vec view_vector(view[0], view[1], view[2]);
+      double t0 = now();
+      for (i = 0; i < n; i++) {
+	strokePlanes(barycenters[i % barycenters.size()],
+		     radii[i % radii.size()], view_vector,
+		     reinterpret_cast<GLdouble (*)[4]>(&equations[8*i]));
+      }
+      time_stroke += now() - t0;
+      t0 = now();
+      planes.update(view);
+      time_batch += now() - t0;
+      for (i = 0; i < n; i++) {
+	if (memcmp(planes.equations(i), &equations[8*i],
+		   8*sizeof(GLdouble)) != 0) {
+	  ndiffs_copies++;
+	}
+      }
+    }
+    printf("  %8d %9.1f us %9.1f us %10.1f %10d\n", n,
+	   1.0e6*time_stroke/nframes, 1.0e6*time_batch/nframes,
+	   time_stroke/time_batch, ndiffs_copies);
+    ndiffs += ndiffs_copies;
+  }
+  return ndiffs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *  tiledBoxes :
+ *  n boxes, copies of the boxes of a drawing side by side on a square grid
+ *  of the size of the drawing, in the horizontal plane.
+ */
+void tiledBoxes(const std::vector<box3>& boxes, const int n,
+		std::vector<box3>& tiled) {
+  typedef box3::vec vec;
+  box3 extent = boxes[0];
+  int i;
+  for (i = 1; i < boxes.size(); i++) {
+    extent.insert(boxes[i]);
+  }
+  const vec size = extent.max - extent.min;
+  const int ntiles = (n + boxes.size() - 1)/boxes.size();
+  const int side = static_cast<int>(ceil(sqrt(static_cast<double>(ntiles))));
+  tiled.clear();
+  for (i = 0; i < n; i++) {
+    const int tile = i/boxes.size();
+    const vec offset((tile % side)*size[0], 0.0, (tile/side)*size[2]);
+    const box3& b = boxes[i % boxes.size()];
+    tiled.push_back(box3(b.min + offset, b.max + offset));
+  }
+}
+
+/*
+ *  sameEdges :
+ *  True if nodes 0 to n - 1 of both graphs have the same neighbours.
+ */
+bool sameEdges(const Intersection_Graph<int>& a,
+	       const Intersection_Graph<int>& b, const int n) {
+  std::vector<int> na, nb;
+  for (int i = 0; i < n; i++) {
+    na.clear();
+    nb.clear();
+    int k;
+    for (k = 0; k < a.degree(i); k++) {
+      na.push_back(a.neighbour(i, k));
+    }
+    for (k = 0; k < b.degree(i); k++) {
+      nb.push_back(b.neighbour(i, k));
+    }
+    sort(na.begin(), na.end());
+    sort(nb.begin(), nb.end());
+    if (na != nb) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ *  benchTree :
+ *  Intersection graph of the strokes of a drawing tiled up to each number
+ *  of strokes, built by testing all pairs of boxes (as Drawing did) and by
+ *  queries to an AABB tree (as Drawing does, inserting the strokes one by
+ *  one then rebuilding the tree). Then strokes are added one at a time at
+ *  random places and the latency of each add is measured both ways. Edges
+ *  must be the same.
+ */
+int benchTree(const char* name, const std::vector<int>& sizes) {
+  typedef AABB_Tree< box3::real, box3::vec > tree;
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  if (!readStrokes(name, window, strokes) || strokes.empty()) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  std::vector<box3> boxes;
+  for (std::list<Stroke3D>::iterator p = strokes.begin();
+       p != strokes.end(); p++) {
+    boxes.push_back((*p).box);
+    (*p).clean(window);
+  }
+  
+  const int nadds = 200; // Magic number!
+  printf("tree: %s, %d strokes tiled, %d adds\n", name,
+	 static_cast<int>(boxes.size()), nadds);
+  printf("  %8s %8s %10s %10s %10s %10s %10s %7s\n", "strokes", "mean deg",
+	 "load pairs", "load tree", "add pairs", "add tree", "p99 tree",
+	 "height");
+  int nfailures = 0;
+  for (int s = 0; s < sizes.size(); s++) {
+    const int n = sizes[s];
+    std::vector<box3> tiled;
+    tiledBoxes(boxes, n + nadds, tiled);
+    
+    /* Loads */
+    Intersection_Graph<int> g_pairs, g_tree;
+    std::vector<int> hits;
+    tree t;
+    int i;
+    double t0 = now();
+    for (i = 0; i < n; i++) {
+      const int node = g_pairs.addNode(i);
+      for (int j = 0; j < node; j++) {
+	if (tiled[i].isIntersectedBy(tiled[j])) {
+	  g_pairs.addEdge(node, j);
+	}
+      }
+    }
+    const double time_load_pairs = now() - t0;
+    t0 = now();
+    for (i = 0; i < n; i++) {
+      const int node = g_tree.addNode(i);
+      hits.clear();
+      t.query(tiled[i], hits);
+      sort(hits.begin(), hits.end());
+      for (int k = 0; k < hits.size(); k++) {
+	g_tree.addEdge(node, hits[k]);
+      }
+      t.insert(node, tiled[i]);
+    }
+    t.rebuild();
+    const double time_load_tree = now() - t0;
+    if (!sameEdges(g_pairs, g_tree, n)) {
+      nfailures++;
+    }
+    
+    /* Adds, at random tiles */
+    srand(1);
+    std::vector<double> times_pairs, times_tree;
+    for (int a = 0; a < nadds; a++) {
+      box3 b = tiled[n + a];
+      const box3::vec offset = tiled[rand() % n].min - tiled[n + a].min;
+      b.min += offset;
+      b.max += offset;
+      t0 = now();
+      const int node_pairs = g_pairs.addNode(n);
+      for (int j = 0; j < n; j++) {
+	if (b.isIntersectedBy(tiled[j])) {
+	  g_pairs.addEdge(node_pairs, j);
+	}
+      }
+      times_pairs.push_back(now() - t0);
+      t0 = now();
+      const int node_tree = g_tree.addNode(n);
+      hits.clear();
+      t.query(b, hits);
+      sort(hits.begin(), hits.end());
+      for (int k = 0; k < hits.size(); k++) {
+	g_tree.addEdge(node_tree, hits[k]);
+      }
+      t.insert(node_tree, b);
+      times_tree.push_back(now() - t0);
+      if (node_pairs != n || node_tree != n ||
+	  !sameEdges(g_pairs, g_tree, n + 1)) {
+	nfailures++;
+      }
+      g_pairs.removeNode(node_pairs);
+      g_tree.removeNode(node_tree);
+      t.remove(node_tree);
+    }
+    const double mean_degree = 2.0*g_tree.edges()/n;
+    printf("  %8d %8.1f %8.3f s %8.3f s %7.1f us %7.1f us %7.1f us %7d\n",
+	   n, mean_degree, time_load_pairs, time_load_tree,
+	   1.0e6*percentile(times_pairs, 50.0),
+	   1.0e6*percentile(times_tree, 50.0),
+	   1.0e6*percentile(times_tree, 99.0), t.height());
+  }
+  printf("  %d failed checks\n", nfailures);
+  return nfailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *  castRay :
+ *  Stroke under pixel (x, y), as Drawing::pickStroke finds it: segment
+ *  through the pixel cast against the tree of boxes of the strokes, then
+ *  against their surfaces until a box starts past the nearest point found.
+ *  ~0 if none.
+ */
+GLuint castRay(const std::vector<const Stroke3D*>& strokes,
+	       const Stroke3D::tree& boxes, const Input& in, const int x,
+	       const int y, std::vector<int>& hits, GLdouble& winz) {
+  const GLdouble winx = x, winy = in.viewport[3] - 1 - y;
+  const GLdouble wins[6] = {winx, winy, 0.0, winx, winy, 1.0};
+  GLdouble objs[6];
+  in.unprojector.unproject(2, wins, objs);
+  const GLdouble direction[3] = {objs[3] - objs[0], objs[4] - objs[1],
+				 objs[5] - objs[2]};
+  hits.clear();
+  hit_params.clear();
+  boxes.query(Stroke3D::tree::vec(objs[0], objs[1], objs[2]),
+	      Stroke3D::tree::vec(direction[0], direction[1], direction[2]),
+	      hits, &hit_params);
+  GLdouble t = 1.0;
+  GLuint name = ~0;
+  for (int i = 0; i < hits.size() && hit_params[i] <= t; i++) {
+    if ((*strokes[hits[i]]).intersect(objs, direction, t, grid)) {
+      name = hits[i];
+    }
+  }
+  GLdouble m[16];
+  multMM(in.proj_matrix, in.mv_matrix, m);
+  const GLdouble p[3] = {objs[0] + t*direction[0], objs[1] + t*direction[1],
+			 objs[2] + t*direction[2]};
+  const GLdouble z = m[2]*p[0] + m[6]*p[1] + m[10]*p[2] + m[14];
+  const GLdouble w = m[3]*p[0] + m[7]*p[1] + m[11]*p[2] + m[15];
+  winz = 0.5*(z/w + 1.0);
+  return name;
+}
+
+/*
+ *  selectBuffer :
+ *  Stroke under pixel (x, y) in GL_SELECT mode, as draw.cc used to find
+ *  it: probability surfaces rendered through a pick matrix of one pixel,
+ *  nearest hit kept. ~0 if none.
+ */
+GLuint selectBuffer(const std::vector<const Stroke3D*>& strokes,
+		    const Input& in, const int x, const int y,
+		    std::vector<GLuint>& buffer, GLdouble& winz) {
+  glSelectBuffer(buffer.size(), &buffer[0]);
+  static_cast<GLvoid>(glRenderMode(GL_SELECT));
+  glInitNames();
+  glPushName(~0);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPickMatrix(x, in.viewport[3] - 1 - y, 1.0, 1.0,
+		const_cast<GLint*>(in.viewport));
+  glMultMatrixd(in.proj_matrix);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixd(in.mv_matrix);
+  for (GLuint i = 0; i < strokes.size(); i++) {
+    glLoadName(i);
+    (*strokes[i]).drawProbaSurfacePicking();
+  }
+  const GLint nhits = glRenderMode(GL_RENDER);
+  GLuint name = ~0, winz_min = ~0;
+  const GLuint* ptr = &buffer[0];
+  for (GLint i = 0; i < nhits; i++) {
+    const GLuint names = ptr[0];
+    if (ptr[1] < winz_min) {
+      winz_min = ptr[1];
+      name = ptr[2 + names];
+    }
+    ptr += 3 + names;
+  }
+  winz = winz_min/4294967295.0;
+  return name;
+}
+
+/*
+ *  benchPick :
+ *  Picking on a grid of npicks pixels of the board camera, over ncopies
+ *  copies of a drawing, each one moved a little further (through its model
+ *  transform): GL_SELECT rendering against rays cast on the CPU. Strokes
+ *  picked and depths are compared. GL_SELECT keeps the least depth of a
+ *  surface over the whole pixel, rays the depth at its center, so they
+ *  differ where surfaces overlap at grazing angles.
+ */
+int benchPick(const char* name, const int ncopies, const int npicks) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  glutInitWindowSize(800, 600);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  int c;
+  for (c = 0; c < ncopies; c++) {
+    std::list<Stroke3D> copy;
+    if (!readStrokes(name, window, copy) || copy.empty()) {
+      fprintf(stderr, "Error: cannot read %s !\n", name);
+      return EXIT_FAILURE;
+    }
+    for (std::list<Stroke3D>::iterator p = copy.begin(); p != copy.end();
+	 p++) {
+      (*p).transform = Stroke3D::tree::vec(0.01*c, 0.005*c, -0.02*c);
+      (*p).computeBoundingBox();
+    }
+    strokes.splice(strokes.end(), copy);
+  }
+  std::vector<const Stroke3D*> ps;
+  Stroke3D::tree boxes;
+  std::list<Stroke3D>::const_iterator p;
+  for (p = strokes.begin(); p != strokes.end(); p++) {
+    boxes.insert(ps.size(), (*p).box);
+    ps.push_back(&(*p));
+  }
+  boxes.rebuild();
+  
+  Input in;
+  in.window = window;
+  in.viewport[0] = 0; in.viewport[1] = 0;
+  in.viewport[2] = 800; in.viewport[3] = 600;
+  glViewport(0, 0, 800, 600);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPerspective(60.0, 800.0/600.0, 1.0, 10.0); // As the drawing board
+  glGetDoublev(GL_PROJECTION_MATRIX, in.proj_matrix);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  glTranslated(0.0, 0.0, -2.05); // Board camera
+  glRotated(20.0, 1.0, 0.0, 0.0);
+  glRotated(30.0, 0.0, 1.0, 0.0);
+  glGetDoublev(GL_MODELVIEW_MATRIX, in.mv_matrix);
+  in.setUnprojector();
+  
+  const int nx = static_cast<int>(sqrt(npicks*800.0/600.0));
+  const int ny = npicks/nx;
+  std::vector<GLuint> buffer(1 << 20); // Large enough for all the hits
+  std::vector<int> hits;
+  std::vector<double> times_select, times_ray;
+  int nhits = 0, nsame = 0, nbehind = 0;
+  double depth_error = 0.0;
+  for (int j = 0; j < ny; j++) {
+    for (int i = 0; i < nx; i++) {
+      const int x = (2*i + 1)*800/(2*nx), y = (2*j + 1)*600/(2*ny);
+      GLdouble winz_select, winz_ray;
+      double t0 = now();
+      const GLuint name_select = selectBuffer(ps, in, x, y, buffer,
+					      winz_select);
+      times_select.push_back(now() - t0);
+      t0 = now();
+      const GLuint name_ray = castRay(ps, boxes, in, x, y, hits, winz_ray);
+      times_ray.push_back(now() - t0);
+      if (name_select != ~0u) {
+	nhits++;
+      }
+      if (name_select == name_ray) {
+	nsame++;
+	if (name_ray != ~0u) {
+	  depth_error = max(depth_error, fabs(winz_ray - winz_select));
+	}
+      }
+      else if (name_select != ~0u) {
+	/* Nearest in the pixel, but not at its center? */
+	const GLdouble winx = x, winy = in.viewport[3] - 1 - y;
+	const GLdouble wins[6] = {winx, winy, 0.0, winx, winy, 1.0};
+	GLdouble objs[6];
+	in.unprojector.unproject(2, wins, objs);
+	const GLdouble direction[3] = {objs[3] - objs[0], objs[4] - objs[1],
+				       objs[5] - objs[2]};
+	GLdouble t = 1.0;
+	if ((*ps[name_select]).intersect(objs, direction, t, grid)) {
+	  nbehind++;
+	}
+      }
+    }
+  }
+  const int n = nx*ny;
+  printf("pick: %s, %d copies, %d strokes, %d picks, %d on strokes\n", name,
+	 ncopies, static_cast<int>(ps.size()), n, nhits);
+  printf("  %-10s %10s %10s\n", "", "us/pick", "99%");
+  printf("  %-10s %10.1f %10.1f\n", "GL_SELECT",
+	 1.0e6*percentile(times_select, 50.0),
+	 1.0e6*percentile(times_select, 99.0));
+  printf("  %-10s %10.1f %10.1f\n", "rays", 1.0e6*percentile(times_ray, 50.0),
+	 1.0e6*percentile(times_ray, 99.0));
+  printf("  same stroke: %d of %d (%.2f%%), max depth difference %.2g\n",
+	 nsame, n, 100.0*nsame/n, depth_error);
+  printf("  other stroke, the one of GL_SELECT being behind at the pixel "
+	 "center: %d\n", nbehind);
+  for (std::list<Stroke3D>::iterator q = strokes.begin(); q != strokes.end();
+       q++) {
+    (*q).clean(window);
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ *  feedbackProbe :
+ *  Nearest object under pixel (x, y) as draw.cc used to find it for the
+ *  local planes: scene and probability surfaces rendered in GL_FEEDBACK
+ *  mode through a pick matrix of one pixel, each class marked by a pass
+ *  through token, the least mean depth of the polygons of each class
+ *  kept, and the strokes preferred to the scene if any. Returns
+ *  Input::NO_INDEX if none, and -2 if the buffer overflowed.
+ */
+int feedbackProbe(const std::vector<const Stroke3D*>& strokes,
+		  const GLuint scene, const Input& in, const int x, const int y,
+		  std::vector<GLfloat>& buffer, GLdouble& winz) {
+  glFeedbackBuffer(buffer.size(), GL_3D, &buffer[0]);
+  static_cast<GLvoid>(glRenderMode(GL_FEEDBACK));
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPickMatrix(x, in.viewport[3] - 1 - y, 1.0, 1.0,
+		const_cast<GLint*>(in.viewport));
+  glMultMatrixd(in.proj_matrix);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixd(in.mv_matrix);
+  glPassThrough(Input::SCENE_INDEX);
+  glCallList(scene);
+  glPassThrough(Input::PROBA_SURFACE_INDEX);
+  for (int i = 0; i < strokes.size(); i++) {
+    (*strokes[i]).drawProbaSurfacePicking();
+  }
+  const GLint size = glRenderMode(GL_RENDER);
+  if (size < 0) {
+    return -2;
+  }
+  GLfloat winz_min[2] = {2.0, 2.0};
+  int object = Input::NO_INDEX;
+  GLint i = 0;
+  while (i < size) {
+    const GLfloat token = buffer[i++];
+    if (token == GL_PASS_THROUGH_TOKEN) {
+      object = static_cast<int>(buffer[i++]);
+    }
+    else if (token == GL_POLYGON_TOKEN) {
+      const int n = static_cast<int>(buffer[i++]);
+      GLfloat mean_winz = 0.0;
+      for (int k = 0; k < n; k++, i += 3) {
+	mean_winz += buffer[i + 2];
+      }
+      mean_winz /= n;
+      winz_min[object] = min(winz_min[object], mean_winz);
+    }
+    else if (token == GL_LINE_TOKEN || token == GL_LINE_RESET_TOKEN) {
+      i += 6;
+    }
+    else {
+      i += 3;
+    }
+  }
+  for (object = Input::PROBA_SURFACE_INDEX; object >= Input::SCENE_INDEX;
+       object--) {
+    if (winz_min[object] <= 1.0) {
+      winz = winz_min[object];
+      return object;
+    }
+  }
+  return Input::NO_INDEX;
+}
+
+/*
+ *  cpuProbe :
+ *  Nearest object under pixel (x, y) as draw.cc finds it now: segment
+ *  through the pixel cast against the triangles of the scene, then against
+ *  the strokes, the nearest hit kept.
+ */
+int cpuProbe(const std::vector<const Stroke3D*>& strokes,
+	     const Stroke3D::tree& boxes, const Scene_Mesh& scene,
+	     const Input& in, const int x, const int y, std::vector<int>& hits,
+	     GLdouble& winz) {
+  GLdouble origin[3], direction[3];
+  in.segment(x, y, origin, direction);
+  GLdouble t = 1.0;
+  int object = Input::NO_INDEX;
+  if (scene.intersect(origin, direction, t)) {
+    object = Input::SCENE_INDEX;
+  }
+  hits.clear();
+  hit_params.clear();
+  boxes.query(Stroke3D::tree::vec(origin[0], origin[1], origin[2]),
+	      Stroke3D::tree::vec(direction[0], direction[1], direction[2]),
+	      hits, &hit_params);
+  for (int i = 0; i < hits.size() && hit_params[i] <= t; i++) {
+    if ((*strokes[hits[i]]).intersect(origin, direction, t, grid)) {
+      object = Input::PROBA_SURFACE_INDEX;
+    }
+  }
+  const GLdouble point[3] = {origin[0] + t*direction[0],
+			     origin[1] + t*direction[1],
+			     origin[2] + t*direction[2]};
+  winz = object == Input::NO_INDEX ? 1.0 : in.depth(point);
+  return object;
+}
+
+/*
+ *  benchProbe :
+ *  Probes of the local planes on a grid of nprobes pixels of the board
+ *  camera, over a drawing and a scene of 256 triangles: GL_FEEDBACK
+ *  rendering (in a buffer of the size draw.cc used) against segments cast
+ *  on the CPU, after one capture of the scene. Both find the same object where
+ *  only one class is under the pixel; where both are, the feedback probe
+ *  took the strokes even behind the scene, the CPU probe the nearest.
+ */
+int benchProbe(const char* name, const int nprobes) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  glutInitWindowSize(800, 600);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  if (!readStrokes(name, window, strokes) || strokes.empty()) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  std::vector<const Stroke3D*> ps;
+  Stroke3D::tree boxes;
+  std::list<Stroke3D>::const_iterator p;
+  for (p = strokes.begin(); p != strokes.end(); p++) {
+    boxes.insert(ps.size(), (*p).box);
+    ps.push_back(&(*p));
+  }
+  boxes.rebuild();
+  
+  /* Scene: a column on a disk, in separate triangles (some software
+     renderers fail to replay strips and fans from a list in feedback
+     mode) */
+  const GLuint scene = glGenLists(1);
+  glNewList(scene, GL_COMPILE);
+  glBegin(GL_TRIANGLES);
+  const int nslices = 64;
+  for (int k = 0; k < nslices; k++) {
+    const double a0 = 2.0*M_PI*k/nslices, a1 = 2.0*M_PI*(k + 1)/nslices;
+    const double c0 = cos(a0), s0 = sin(a0), c1 = cos(a1), s1 = sin(a1);
+    glVertex3d(0.2, -0.4, -0.3); // Disk
+    glVertex3d(0.2 + 1.5*c0, -0.4, -0.3 + 1.5*s0);
+    glVertex3d(0.2 + 1.5*c1, -0.4, -0.3 + 1.5*s1);
+    glVertex3d(0.2 + 0.3*c0, -0.4, -0.3 + 0.3*s0); // Column
+    glVertex3d(0.2 + 0.3*c1, -0.4, -0.3 + 0.3*s1);
+    glVertex3d(0.2 + 0.3*c1, 0.4, -0.3 + 0.3*s1);
+    glVertex3d(0.2 + 0.3*c0, -0.4, -0.3 + 0.3*s0);
+    glVertex3d(0.2 + 0.3*c1, 0.4, -0.3 + 0.3*s1);
+    glVertex3d(0.2 + 0.3*c0, 0.4, -0.3 + 0.3*s0);
+    glVertex3d(0.2, 0.4, -0.3); // Top
+    glVertex3d(0.2 + 0.3*c0, 0.4, -0.3 + 0.3*s0);
+    glVertex3d(0.2 + 0.3*c1, 0.4, -0.3 + 0.3*s1);
+  }
+  glEnd();
+  glEndList();
+  Scene_Mesh mesh;
+  double t0 = now();
+  mesh.capture(scene, 10.0); // As draw.cc
+  const double capture_time = now() - t0;
+  
+  Input in;
+  in.window = window;
+  in.viewport[0] = 0; in.viewport[1] = 0;
+  in.viewport[2] = 800; in.viewport[3] = 600;
+  glViewport(0, 0, 800, 600);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPerspective(60.0, 800.0/600.0, 1.0, 10.0); // As the drawing board
+  glGetDoublev(GL_PROJECTION_MATRIX, in.proj_matrix);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  glTranslated(0.0, 0.0, -2.05); // Board camera
+  glRotated(20.0, 1.0, 0.0, 0.0);
+  glRotated(30.0, 0.0, 1.0, 0.0);
+  glGetDoublev(GL_MODELVIEW_MATRIX, in.mv_matrix);
+  in.setUnprojector();
+  
+  const int nx = static_cast<int>(sqrt(nprobes*800.0/600.0));
+  const int ny = nprobes/nx;
+  std::vector<GLfloat> buffer(4096); // As draw.cc
+  std::vector<int> hits;
+  std::vector<double> times_feedback, times_cpu;
+  int counts[3] = {0, 0, 0}; // Objects found on the CPU, by class
+  int noverflows = 0, nsame = 0, nhidden = 0;
+  double depth_error = 0.0;
+  for (int j = 0; j < ny; j++) {
+    for (int i = 0; i < nx; i++) {
+      const int x = (2*i + 1)*800/(2*nx), y = (2*j + 1)*600/(2*ny);
+      GLdouble winz_feedback = 1.0, winz_cpu;
+      t0 = now();
+      const int object_feedback = feedbackProbe(ps, scene, in, x, y, buffer,
+						winz_feedback);
+      times_feedback.push_back(now() - t0);
+      t0 = now();
+      const int object_cpu = cpuProbe(ps, boxes, mesh, in, x, y, hits,
+				      winz_cpu);
+      times_cpu.push_back(now() - t0);
+      counts[object_cpu + 1]++;
+      if (object_feedback == -2) {
+	noverflows++;
+      }
+      else if (object_feedback == object_cpu) {
+	nsame++;
+	if (object_cpu != Input::NO_INDEX) {
+	  depth_error = max(depth_error, fabs(winz_cpu - winz_feedback));
+	}
+      }
+      else if (object_feedback == Input::PROBA_SURFACE_INDEX &&
+	       object_cpu == Input::SCENE_INDEX) {
+	nhidden++;
+      }
+    }
+  }
+  const int n = nx*ny;
+  printf("probe: %s, %d strokes, scene of %d triangles captured in %.1f ms\n",
+	 name, static_cast<int>(ps.size()), mesh.triangles(),
+	 1.0e3*capture_time);
+  printf("  %d probes: %d on nothing, %d on the scene, %d on strokes\n", n,
+	 counts[0], counts[1], counts[2]);
+  printf("  %-10s %10s %10s\n", "", "us/probe", "99%");
+  printf("  %-10s %10.1f %10.1f\n", "feedback",
+	 1.0e6*percentile(times_feedback, 50.0),
+	 1.0e6*percentile(times_feedback, 99.0));
+  printf("  %-10s %10.1f %10.1f\n", "CPU", 1.0e6*percentile(times_cpu, 50.0),
+	 1.0e6*percentile(times_cpu, 99.0));
+  printf("  same object: %d of %d (%.2f%%), max depth difference %.2g\n",
+	 nsame, n, 100.0*nsame/n, depth_error);
+  printf("  strokes behind the scene taken by feedback: %d, overflows: %d\n",
+	 nhidden, noverflows);
+  glDeleteLists(scene, 1);
+  for (std::list<Stroke3D>::iterator q = strokes.begin(); q != strokes.end();
+       q++) {
+    (*q).clean(window);
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ *  walkStrokes :
+ *  The three loops over the strokes of Drawing::draw, without their GL
+ *  calls: what they read of each stroke is summed. Time per frame.
+ */
+template <class Strokes>
+double walkStrokes(const Strokes& strokes, const Clipping_Planes& planes,
+		   const int nframes, double& sum) {
+  typename Strokes::const_iterator p;
+  const double t0 = now();
+  for (int f = 0; f < nframes; f++) {
+    for (p = strokes.begin(); p != strokes.end(); p++) {
+      if ((*p).drawing_mode == Stroke3D::LINE) {
+	sum += (*p).color[0];
+      }
+      else if ((*p).drawing_mode == Stroke3D::TEXTURED_POLYGON) {
+	sum += (*p).color[0] + planes.equations((*p).node)[3];
+      }
+    }
+    for (p = strokes.begin(); p != strokes.end(); p++) {
+      if ((*p).drawing_mode == Stroke3D::TEXTURED_POLYGON ||
+	  (*p).drawing_mode == Stroke3D::OCCLUSION) {
+	sum += (*p).lod;
+      }
+    }
+    for (p = strokes.begin(); p != strokes.end(); p++) {
+      if ((*p).drawing_mode == Stroke3D::TEXTURED_POLYGON) {
+	sum += planes.equations((*p).node)[7];
+      }
+      else if ((*p).drawing_mode == Stroke3D::OCCLUSION) {
+	sum += (*p).lod;
+      }
+    }
+  }
+  return (now() - t0)/nframes;
+}
+
+/*
+ *  drawStrokes :
+ *  Curves and probability surfaces of the strokes, at their current level
+ *  of detail. Time per frame.
+ */
+template <class Strokes>
+double drawStrokes(const Strokes& strokes, const int nframes) {
+  typename Strokes::const_iterator p;
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPerspective(60.0, 800.0/600.0, 1.0, 10.0); // As the drawing board
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  glTranslated(0.0, 0.0, -2.05); // Board camera
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_MAP1_VERTEX_3);
+  const double t0 = now();
+  for (int f = 0; f < nframes; f++) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (p = strokes.begin(); p != strokes.end(); p++) {
+      if ((*p).drawing_mode == Stroke3D::LINE) {
+	(*p).drawSpline();
+      }
+      else {
+	(*p).drawProbaSurface();
+      }
+    }
+    glFinish();
+  }
+  return (now() - t0)/nframes;
+}
+
+/*
+ *  benchSlots :
+ *  Strokes of ncopies copies of a drawing in a list, as Drawing kept them,
+ *  then handed over to a slot map: loops of Drawing::draw without and with
+ *  their GL calls, then lookup of random strokes by selection name, their
+ *  position in the list or their handle in the map, and removal and
+ *  insertion (undo and redo) in the map. Last, insertion and removal of a
+ *  stroke over and over, in the same slot until its generations run out:
+ *  none of the handles removed may be valid again.
+ */
+int benchSlots(const char* name, const int ncopies, const int nframes) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  glutInitWindowSize(800, 600);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  for (int c = 0; c < ncopies; c++) {
+    if (!readStrokes(name, window, strokes) || strokes.empty()) {
+      fprintf(stderr, "Error: cannot read %s !\n", name);
+      return EXIT_FAILURE;
+    }
+  }
+  const int n = strokes.size();
+  Clipping_Planes planes;
+  std::list<Stroke3D>::iterator p;
+  int i = 0;
+  for (p = strokes.begin(); p != strokes.end(); p++, i++) {
+    (*p).node = i;
+    const GLdouble barycenter[3] = {(*p).barycenter_global[0],
+				    (*p).barycenter_global[1],
+				    (*p).barycenter_global[2]};
+    planes.set(i, barycenter, (*p).mean_radius);
+  }
+  const GLdouble view[3] = {0.0, 0.0, -1.0};
+  planes.update(view);
+  
+  double sum_list = 0.0, sum_map = 0.0;
+  const double walk_list = walkStrokes(strokes, planes, nframes, sum_list);
+  const double draw_list = drawStrokes(strokes, nframes);
+  std::vector<int> names(100000); // Magic number!
+  for (i = 0; i < names.size(); i++) {
+    names[i] = rand() % n;
+  }
+  double t0 = now();
+  for (i = 0; i < names.size(); i++) {
+    std::list<Stroke3D>::iterator q = strokes.begin();
+    std::advance(q, names[i]);
+    sum_list += (*q).lod;
+  }
+  const double lookup_list = (now() - t0)/names.size();
+  
+  Stroke3D::map map;
+  std::vector<Stroke3D::map::handle> handles;
+  for (p = strokes.begin(); p != strokes.end(); p++) {
+    handles.push_back(map.insert(*p));
+  }
+  const double walk_map = walkStrokes(map, planes, nframes, sum_map);
+  const double draw_map = drawStrokes(map, nframes);
+  t0 = now();
+  for (i = 0; i < names.size(); i++) {
+    sum_map += map[handles[names[i]]].lod;
+  }
+  const double lookup_map = (now() - t0)/names.size();
+  
+  /* Undo of random strokes, then redo */
+  std::vector<Stroke3D> undone(n/2);
+  t0 = now();
+  for (i = 0; i < n/2; i++) {
+    const int k = rand() % n;
+    if (!map.contains(handles[k])) {
+      continue;
+    }
+    undone[i].swap(map[handles[k]]);
+    map.remove(handles[k]);
+  }
+  for (i = 0; i < n/2; i++) {
+    if (!undone[i].empty()) {
+      map.insert(undone[i]);
+    }
+  }
+  const double churn_map = (now() - t0)/n;
+  
+  /* Generations of a slot */
+  Stroke3D::map cycled;
+  std::vector<Stroke3D::map::handle> removed;
+  const int ncycles = 3 << (32 - Stroke3D::map::SLOT_BITS); // Magic number!
+  for (i = 0; i < ncycles; i++) {
+    Stroke3D s;
+    const Stroke3D::map::handle h = cycled.insert(s);
+    cycled.remove(h);
+    removed.push_back(h);
+  }
+  Stroke3D s_last;
+  const Stroke3D::map::handle h_last = cycled.insert(s_last);
+  int nstale = 0; // Handles removed but valid, or equal to the last one
+  for (i = 0; i < removed.size(); i++) {
+    if (cycled.contains(removed[i]) || removed[i] == h_last) {
+      nstale++;
+    }
+  }
+  
+  printf("slots: %s, %d copies, %d strokes, %d frames\n", name, ncopies, n,
+	 nframes);
+  printf("  %-6s %12s %12s %12s\n", "", "walk us", "draw ms", "lookup us");
+  printf("  %-6s %12.1f %12.2f %12.3f\n", "list", 1.0e6*walk_list,
+	 1.0e3*draw_list, 1.0e6*lookup_list);
+  printf("  %-6s %12.1f %12.2f %12.3f\n", "map", 1.0e6*walk_map,
+	 1.0e3*draw_map, 1.0e6*lookup_map);
+  printf("  undo and redo: %.3f us per stroke, map %s, %d strokes\n",
+	 1.0e6*churn_map, map.valid() ? "valid" : "INVALID", map.size());
+  printf("  same sums: %s\n", sum_list == sum_map ? "yes" : "NO");
+  printf("  %d insertions and removals: %d stale handles valid, map %s\n",
+	 ncycles, nstale, cycled.valid() ? "valid" : "INVALID");
+  const bool ok = map.valid() && map.size() == n && sum_list == sum_map &&
+    nstale == 0 && cycled.valid();
+  for (Stroke3D::map::iterator q = map.begin(); q != map.end(); q++) {
+    (*q).clean(window);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *  benchCull :
+ *  Frames of ncopies copies of a drawing, side by side on a square grid
+ *  (through their model transforms), seen by the board camera turning
+ *  around the first one and zooming in and out, as drawFrames, with and
+ *  without frustum culling:
+ *  strokes in the frustum found by the tree of boxes, checked against a
+ *  test of every box, and time per frame of both, then of drawing all the
+ *  strokes or only those found.
+ */
+int benchCull(const char* name, const int ncopies, const int nframes) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  glutInitWindowSize(800, 600);
+  const int window = glutCreateWindow("bench");
+  
+  std::list<Stroke3D> strokes;
+  const int side = static_cast<int>(ceil(sqrt(static_cast<double>(ncopies))));
+  for (int c = 0; c < ncopies; c++) {
+    std::list<Stroke3D> copy;
+    if (!readStrokes(name, window, copy) || copy.empty()) {
+      fprintf(stderr, "Error: cannot read %s !\n", name);
+      return EXIT_FAILURE;
+    }
+    for (std::list<Stroke3D>::iterator p = copy.begin(); p != copy.end();
+	 p++) {
+      (*p).transform = Stroke3D::tree::vec(2.0*(c % side), 0.0,
+					   -2.0*(c/side)); // Magic number!
+      (*p).computeBoundingBox();
+    }
+    strokes.splice(strokes.end(), copy);
+  }
+  std::vector<const Stroke3D*> ps;
+  Stroke3D::tree boxes;
+  std::list<Stroke3D>::const_iterator p;
+  for (p = strokes.begin(); p != strokes.end(); p++) {
+    boxes.insert(ps.size(), (*p).box);
+    ps.push_back(&(*p));
+  }
+  boxes.rebuild();
+  const int n = ps.size();
+  
+  Input in;
+  in.window = window;
+  in.viewport[0] = 0; in.viewport[1] = 0;
+  in.viewport[2] = 800; in.viewport[3] = 600;
+  glViewport(0, 0, 800, 600);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPerspective(60.0, 800.0/600.0, 1.0, 10.0); // As the drawing board
+  glGetDoublev(GL_PROJECTION_MATRIX, in.proj_matrix);
+  glMatrixMode(GL_MODELVIEW);
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_MAP1_VERTEX_3);
+  
+  std::vector<int> hits, all;
+  std::vector<bool> in_box(n);
+  double time_tree = 0.0, time_boxes = 0.0, time_all = 0.0, time_culled = 0.0;
+  long nvisible = 0;
+  int nvisible_min = n, ndiffs = 0;
+  for (int f = 0; f < nframes; f++) {
+    const double phase = static_cast<double>(f)/nframes;
+    const double zoom = 0.75*(1.0 - cos(4.0*M_PI*phase)) - 1.0;
+    glLoadIdentity();
+    glTranslated(0.0, 0.0, -2.05*pow(2.0, zoom)); // Board camera at 2.05
+    glRotated(20.0, 1.0, 0.0, 0.0);
+    glRotated(360.0*phase, 0.0, 1.0, 0.0);
+    glGetDoublev(GL_MODELVIEW_MATRIX, in.mv_matrix);
+    GLdouble frustum[6][4];
+    in.frustum(frustum);
+    Stroke3D::tree::real planes[6*4];
+    int i, k;
+    for (i = 0; i < 6*4; i++) {
+      planes[i] = frustum[i/4][i%4];
+    }
+    
+    double t0 = now();
+    hits.clear();
+    boxes.query(6, planes, hits);
+    time_tree += now() - t0;
+    t0 = now();
+    all.clear();
+    for (i = 0; i < n; i++) {
+      for (k = 0; k < 6 && (*ps[i]).box.side(planes + 4*k) >= 0; k++) {}
+      if (k == 6) {
+	all.push_back(i);
+      }
+    }
+    time_boxes += now() - t0;
+    std::sort(hits.begin(), hits.end());
+    if (hits != all) {
+      ndiffs++;
+    }
+    nvisible += hits.size();
+    nvisible_min = min(nvisible_min, static_cast<int>(hits.size()));
+    
+    for (int culled = 0; culled < 2; culled++) {
+      const int m = culled ? hits.size() : n;
+      t0 = now();
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      for (i = 0; i < m; i++) {
+	const Stroke3D& s = *ps[culled ? hits[i] : i];
+	if (s.drawing_mode == Stroke3D::LINE) {
+	  s.drawSpline();
+	}
+	else {
+	  s.drawProbaSurface();
+	}
+      }
+      glFinish();
+      (culled ? time_culled : time_all) += now() - t0;
+    }
+  }
+  printf("cull: %s, %d copies, %d strokes, %d frames\n", name, ncopies, n,
+	 nframes);
+  printf("  visible: %.1f on average, %d at least\n",
+	 static_cast<double>(nvisible)/nframes, nvisible_min);
+  printf("  culling: tree %.1f us, every box %.1f us, %d frames differing\n",
+	 1.0e6*time_tree/nframes, 1.0e6*time_boxes/nframes, ndiffs);
+  printf("  drawing: all %.2f ms, culled %.2f ms\n",
+	 1.0e3*time_all/nframes, 1.0e3*time_culled/nframes);
+  for (std::list<Stroke3D>::iterator q = strokes.begin(); q != strokes.end();
+       q++) {
+    (*q).clean(window);
+  }
+  return ndiffs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *  benchOrder :
+ *  Strokes of a drawing picked under a grid of pixels and removed, as
+ *  with a click and the 'x' key, nremovals times at most, each removal
+ *  followed by a frame of drawInformations: the strokes of each frame have
+ *  to be drawn in the order they were added, not in the order of the
+ *  array, which removals change.
+ */
+int benchOrder(const char* name, const int nremovals) {
+  int argc = 1;
+  char* argv[] = {const_cast<char*>("bench"), 0};
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
+  glutInitWindowSize(800, 600);
+  const int window = glutCreateWindow("bench");
+  
+  Drawing D;
+  if (!D.read(name, window) || D.totalStrokes() == 0) {
+    fprintf(stderr, "Error: cannot read %s !\n", name);
+    return EXIT_FAILURE;
+  }
+  const int n = D.totalStrokes();
+  
+  Input in;
+  in.window = window;
+  in.viewport[0] = 0; in.viewport[1] = 0;
+  in.viewport[2] = 800; in.viewport[3] = 600;
+  glViewport(0, 0, 800, 600);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPerspective(60.0, 800.0/600.0, 1.0, 10.0); // As the drawing board
+  glGetDoublev(GL_PROJECTION_MATRIX, in.proj_matrix);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  glTranslated(0.0, 0.0, -2.05); // Board camera
+  glRotated(20.0, 1.0, 0.0, 0.0);
+  glRotated(30.0, 0.0, 1.0, 0.0);
+  glGetDoublev(GL_MODELVIEW_MATRIX, in.mv_matrix);
+  in.setViewVector();
+  in.setUnprojector();
+  
+  D.drawInformations(in);
+  int nframes = 1, nwrong = D.inDrawingOrder() ? 0 : 1, nremoved = 0;
+  for (int y = 15; y < 600 && nremoved < nremovals; y += 30) {
+    for (int x = 20; x < 800 && nremoved < nremovals; x += 40) {
+      if (!D.pickStroke(x, y, in)) {
+	continue;
+      }
+      D.markStroke(in);
+      D.removeStroke(in);
+      nremoved++;
+      D.drawInformations(in);
+      nframes++;
+      if (!D.inDrawingOrder()) {
+	nwrong++;
+      }
+    }
+  }
+  
+  printf("order: %s, %d strokes, %d removed, %d visible at the end\n", name,
+	 n, nremoved, D.visibleStrokes());
+  printf("  frames out of order: %d of %d\n", nwrong, nframes);
+  D.clearStrokes(in);
+  return nwrong == 0 && nremoved > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  if (strcmp(argv[1], "kernel") == 0) {
+    const int npoints = argc > 2 ? atoi(argv[2]) : 2048;
+    const int nruns = argc > 3 ? atoi(argv[3]) : 1000;
+    benchKernel(npoints, nruns);
+  }
+  else if (strcmp(argv[1], "spans") == 0) {
+    const int ncorners = argc > 2 ? atoi(argv[2]) : 48;
+    const int nthreads = argc > 3 ? atoi(argv[3]) : 0;
+    const int nruns = argc > 4 ? atoi(argv[4]) : 100;
+    benchSpans(ncorners, nthreads, nruns);
+  }
+  else if (strcmp(argv[1], "length") == 0) {
+    const int nstrokes = argc > 2 ? atoi(argv[2]) : 100;
+    const int nruns = argc > 3 ? atoi(argv[3]) : 100;
+    benchLength(nstrokes, nruns);
+  }
+  else if (strcmp(argv[1], "traces") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int nruns = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 20;
+    const int nthreads = argc > 4 ? atoi(argv[4]) : 1;
+    return benchTraces(argv[2], nruns, nthreads);
+  }
+  else if (strcmp(argv[1], "memory") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    return benchMemory(argv[2]);
+  }
+  else if (strcmp(argv[1], "unproject") == 0) {
+    const int npoints = argc > 2 ? atoi(argv[2]) : 64;
+    const int nruns = argc > 3 ? atoi(argv[3]) : 100000;
+    benchUnproject(npoints, nruns);
+  }
+  else if (strcmp(argv[1], "reverse") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int nruns = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 10;
+    return benchReverse(argv[2], nruns);
+  }
+  else if (strcmp(argv[1], "boxes") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int nruns = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 20;
+    return benchBoxes(argv[2], nruns);
+  }
+  else if (strcmp(argv[1], "lod") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int nframes = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 360;
+    return benchLod(argv[2], nframes);
+  }
+  else if (strcmp(argv[1], "strokes") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    return benchStrokes(argv[2]);
+  }
+  else if (strcmp(argv[1], "load") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int nruns = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 20;
+    return benchLoad(argv[2], nruns);
+  }
+  else if (strcmp(argv[1], "graph") == 0) {
+    const int nstrokes = argc > 2 && atoi(argv[2]) > 0 ? atoi(argv[2]) : 5000;
+    const int nrounds = argc > 3 ? atoi(argv[3]) : 20;
+    return benchGraph(nstrokes, nrounds);
+  }
+  else if (strcmp(argv[1], "planes") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int nframes = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 360;
+    return benchPlanes(argv[2], nframes);
+  }
+  else if (strcmp(argv[1], "tree") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    std::vector<int> sizes;
+    for (int i = 3; i < argc; i++) {
+      if (atoi(argv[i]) > 0) {
+	sizes.push_back(atoi(argv[i]));
+      }
+    }
+    if (sizes.empty()) {
+      sizes.push_back(1000);
+      sizes.push_back(10000);
+      sizes.push_back(100000);
+    }
+    return benchTree(argv[2], sizes);
+  }
+  else if (strcmp(argv[1], "pick") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int ncopies = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 1;
+    const int npicks = argc > 4 && atoi(argv[4]) > 0 ? atoi(argv[4]) : 1200;
+    return benchPick(argv[2], ncopies, npicks);
+  }
+  else if (strcmp(argv[1], "probe") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int nprobes = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 1200;
+    return benchProbe(argv[2], nprobes);
+  }
+  else if (strcmp(argv[1], "slots") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int ncopies = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 32;
+    const int nframes = argc > 4 && atoi(argv[4]) > 0 ? atoi(argv[4]) : 100;
+    return benchSlots(argv[2], ncopies, nframes);
+  }
+  else if (strcmp(argv[1], "cull") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int ncopies = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 1;
+    const int nframes = argc > 4 && atoi(argv[4]) > 0 ? atoi(argv[4]) : 360;
+    return benchCull(argv[2], ncopies, nframes);
+  }
+  else if (strcmp(argv[1], "order") == 0) {
+    if (argc < 3) {
+      usage();
+      return EXIT_FAILURE;
+    }
+    const int nremovals = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : 20;
+    return benchOrder(argv[2], nremovals);
+  }
+  else {
+    fprintf(stderr, "Error: unknown mode %s !\n", argv[1]);
+    usage();
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
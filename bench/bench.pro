@@ -0,0 +1,15 @@
+#
+# bench.pro
+# tmake project file
+#
+TEMPLATE	= app.t
+CONFIG		= opengl release
+INCLUDEPATH = .. ../bezier ../aabb
+LIBS		+= -lglut -lpthread
+#
+SOURCES     = bench.cc ../stroke2D.cc ../curve_fitter.cc ../stream_fitter.cc \
+	      ../decimator.cc ../parallel_fitter.cc ../thread_pool.cc \
+	      ../input.cc ../opengl_utils.cc ../unprojector.cc \
+	      ../stroke3D.cc ../surface_mesh.cc ../clipping_planes.cc \
+	      ../scene_mesh.cc ../drawing.cc ../texture.cc ../texload.c
+TARGET      = bench
@@ -1,17 +1,45 @@
 #ifndef BEZIER_H
 #define BEZIER_H
 
+#include <cassert>
 #include <fstream>
 #include <vector>
 #include "vec3.h"
 #include "point.h"
+#include "arc_length.h"
+#include "inline_vector.h"
 
-template < class Real, class Vec = Vec2<Real> >
+/*
+ *  Container of the data of a Bezier curve, for n control points at most,
+ *  or any number if n is 0.
+ */
+template < class T, int N >
+class Bezier_Storage {
+public:
+  typedef Inline_Vector<T, N> type;
+};
+
+template < class T >
+class Bezier_Storage<T, 0> {
+public:
+  typedef std::vector<T> type;
+};
+
+/*
+ *  Bezier curve of a given degree, whose data are then stored inline, or
+ *  of any degree (Degree = -1), whose data are then on the heap.
+ */
+template < class Real, class Vec = Vec2<Real>, int Degree = -1 >
 class Bezier {
+protected:
+  enum {NV  = Degree < 0 ? 0 : Degree+1, // Capacities, 0 for any size
+	ND1 = Degree < 1 ? 0 : Degree,
+	ND2 = Degree < 2 ? 0 : Degree-1};
+  
 public:
-  typedef Real             real;
-  typedef Vec              vec;
-  typedef std::vector<Vec> ctrl_points;
+  typedef Real                                     real;
+  typedef Vec                                      vec;
+  typedef typename Bezier_Storage<Vec, NV>::type   ctrl_points;
   
   Bezier();
   Bezier(const int degree);
@@ -20,9 +48,16 @@ public:
   /* Evaluate a Bezier curve at a particular parameter value */
   void evaluate(const Real t, Vec& Q) const;
   void evalDerivative(const int order, const Real t, Vec& Q) const;
+  void evalDerivatives(const Real t, Vec& Q, Vec& Q_prime,
+		       Vec& Q_second) const;
   bool evalDiffGeomProperties(const Real t, Vec& Q, Vec& Q_prime,
 			      Vec& Q_second, Vec& CC) const;
   
+  /* First and second hodographs (degree+1-order points), built on first
+     use */
+  const Vec* hodograph(const int order) const;
+  void invalidateHodographs(); // To be called after changing V
+  
   /* Bernstein polynomials */
   static const Real B30(const Real u);
   static const Real B31(const Real u);
@@ -30,20 +65,32 @@ public:
   static const Real B33(const Real u);
   
   ctrl_points V;  // Control points
+  
+private:
+  enum {MAX_DEGREE = 15}; // Of the curves evaluated without allocation
+  
+  static void deCasteljau(const Vec* P, const int degree, const Real t,
+			  Vec& Q);
+  void buildHodographs() const;
+  
+  mutable typename Bezier_Storage<Vec, ND1>::type D1; // Control points of Q'
+  mutable typename Bezier_Storage<Vec, ND2>::type D2; // Control points of Q''
 };
 
-template < class Real, class Vec = Vec2<Real> >
-class Bezier_Augmented : public Bezier<Real, Vec> {
+template < class Real, class Vec = Vec2<Real>, int Degree = -1 >
+class Bezier_Augmented : public Bezier<Real, Vec, Degree> {
 public:
-  typedef std::vector<Real> parameters;
-  typedef std::vector<Vec>  curv_centers;
-  typedef std::vector<Real> radii;
-  typedef std::vector<Vec>  normals;
+  typedef Bezier<Real, Vec, Degree>                     base;
+  typedef typename Bezier_Storage<Real, base::NV>::type parameters;
+  typedef typename Bezier_Storage<Vec, base::NV>::type  curv_centers;
+  typedef typename Bezier_Storage<Real, base::NV>::type radii;
+  typedef typename Bezier_Storage<Vec, base::NV>::type  normals;
   
   Bezier_Augmented();
   Bezier_Augmented(const int degree);
   Bezier_Augmented(const Bezier_Augmented& b);
   void evalLength(const int nstep);
+  void evalArcLength();
   /*
    *  findNewtonRaphsonRoot :
    *  Use Newton-Raphson iteration to find better root.
@@ -53,7 +100,7 @@ public:
   void evalParameters();
   void computeRadii();
   void computeNormals();
-  void read(std::ifstream& file_in);
+  bool read(std::ifstream& file_in);
   void write(std::ofstream& file_out) const;
   
   Real length;
@@ -68,40 +115,116 @@ public:
  *  Definition of inlined methods
  */
 
-template <class Real, class Vec>
-inline Bezier<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline Bezier<Real, Vec, Degree>::
 Bezier()
-  : V() {}
+  : V(), D1(), D2() {}
 
-template <class Real, class Vec>
-inline Bezier<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline Bezier<Real, Vec, Degree>::
 Bezier(const int degree)
-  : V(degree+1) {}
+  : V(degree+1), D1(), D2() {}
 
-template <class Real, class Vec>
-inline Bezier<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline Bezier<Real, Vec, Degree>::
 Bezier(const Bezier& b)
-  : V(b.V) {}
+  : V(b.V), D1(b.D1), D2(b.D2) {}
 
-template <class Real, class Vec>
-inline void Bezier<Real, Vec>::
-evaluate(const Real t, Vec& Q) const {
-  ctrl_points V_tmp(V);    /* Local copy of control points */
-  int degree = V.size()-1; /* Degree of the Bezier curve */
+/*
+ *  deCasteljau :
+ *  Point at parameter t of the Bezier curve of control points P[0..degree].
+ */
+template <class Real, class Vec, int Degree>
+inline void Bezier<Real, Vec, Degree>::
+deCasteljau(const Vec* P, const int degree, const Real t, Vec& Q) {
+  if (degree > MAX_DEGREE) {
+    std::vector<Vec> P_tmp(P, P + degree+1); /* Local copy */
+    for (int i = 1; i <= degree; i++) {
+      for (typename std::vector<Vec>::iterator p = P_tmp.begin();
+	   p != P_tmp.end()-i; p++) {
+	(*p) = (*p)*(1.0 - t) + (*(p+1))*(t);
+      }
+    }
+    Q = P_tmp.front();
+    return;
+  }
+  Vec P_tmp[MAX_DEGREE+1];
+  int i, j;
+  for (i = 0; i <= degree; i++) {
+    P_tmp[i] = P[i];
+  }
   
   /* Triangle computation: de Casteljau's algorithm */
-  for (int i = 1; i <= degree; i++) {
-    for (typename ctrl_points::iterator p = V_tmp.begin();
-	 p != V_tmp.end()-i; p++) {
-      (*p) = (*p)*(1.0 - t) + (*(p+1))*(t);
+  for (j = 1; j <= degree; j++) {
+    for (i = 0; i <= degree-j; i++) {
+      P_tmp[i] = P_tmp[i]*(1.0 - t) + P_tmp[i+1]*(t);
     }
   }
-  Q = V_tmp.front(); /* Point on curve at parameter t */
+  Q = P_tmp[0]; /* Point on curve at parameter t */
+}
+
+/*
+ *  buildHodographs :
+ *  Q' is the Bezier curve of control points degree*(V[i+1] - V[i]), and
+ *  Q'' that of the differences of the former, times degree-1.
+ */
+template <class Real, class Vec, int Degree>
+inline void Bezier<Real, Vec, Degree>::
+buildHodographs() const {
+  const int degree = Degree < 0 ? static_cast<int>(V.size())-1 : Degree;
+  if (!D1.empty() || degree < 1) {
+    return;
+  }
+  int i;
+  D1.resize(degree);
+  for (i = 0; i < degree; i++) {
+    D1[i] = (V[i+1] - V[i])*static_cast<Real>(degree);
+  }
+  D2.resize(degree-1);
+  for (i = 0; i < degree-1; i++) {
+    D2[i] = (D1[i+1] - D1[i])*static_cast<Real>(degree-1);
+  }
+}
+
+template <class Real, class Vec, int Degree>
+inline const Vec* Bezier<Real, Vec, Degree>::
+hodograph(const int order) const {
+  assert(order == 1 || order == 2);
+  buildHodographs();
+  if (order == 1) {
+    return D1.empty() ? 0 : &D1[0];
+  }
+  return D2.empty() ? 0 : &D2[0];
 }
 
-template <class Real, class Vec>
-inline void Bezier<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline void Bezier<Real, Vec, Degree>::
+invalidateHodographs() {
+  D1.clear();
+  D2.clear();
+}
+
+template <class Real, class Vec, int Degree>
+inline void Bezier<Real, Vec, Degree>::
+evaluate(const Real t, Vec& Q) const {
+  deCasteljau(&V[0], Degree < 0 ? static_cast<int>(V.size())-1 : Degree,
+	      t, Q);
+}
+
+template <class Real, class Vec, int Degree>
+inline void Bezier<Real, Vec, Degree>::
 evalDerivative(const int order, const Real t, Vec& Q) const {
+  if (order == 1 || order == 2) {
+    const Vec* D = hodograph(order);
+    if (D == 0) {
+      Q = V.front()*0.0;
+    }
+    else {
+      deCasteljau(D, static_cast<int>(V.size())-1 - order, t, Q);
+    }
+    return;
+  }
+  
   ctrl_points V_tmp(V);    /* Local copy of control points */
   int degree = V.size()-1; /* Degree of the Bezier curve */
   
@@ -132,13 +255,62 @@ evalDerivative(const int order, const Real t, Vec& Q) const {
   Q = V_tmp.front()*(n/m); /* Nth order derivative at parameter t */
 }
 
-template <class Real, class Vec>
-inline bool Bezier<Real, Vec>::
+/*
+ *  evalDerivatives :
+ *  Q, Q' and Q'' at t in one pass: the Bernstein polynomials are raised
+ *  from degree 0 to the degree of the curve, and combined with the control
+ *  points of the second hodograph, the first one, then the curve, as their
+ *  degree is reached.
+ */
+template <class Real, class Vec, int Degree>
+inline void Bezier<Real, Vec, Degree>::
+evalDerivatives(const Real t, Vec& Q, Vec& Q_prime, Vec& Q_second) const {
+  const int degree = Degree < 0 ? static_cast<int>(V.size())-1 : Degree;
+  if (degree > MAX_DEGREE) {
+    evaluate(t, Q);
+    evalDerivative(1, t, Q_prime);
+    evalDerivative(2, t, Q_second);
+    return;
+  }
+  buildHodographs();
+  
+  const Real s = 1.0 - t;
+  Real B[MAX_DEGREE+1];
+  Q_prime = V.front()*0.0;
+  Q_second = Q_prime;
+  B[0] = 1.0;
+  for (int k = 0; k <= degree; k++) {
+    if (k > 0) {
+      B[k] = t*B[k-1];
+      for (int i = k-1; i > 0; i--) {
+	B[i] = s*B[i] + t*B[i-1];
+      }
+      B[0] *= s;
+    }
+    if (k == degree-2) {
+      Q_second = D2[0]*B[0];
+      for (int i = 1; i <= k; i++) {
+	Q_second += D2[i]*B[i];
+      }
+    }
+    else if (k == degree-1) {
+      Q_prime = D1[0]*B[0];
+      for (int i = 1; i <= k; i++) {
+	Q_prime += D1[i]*B[i];
+      }
+    }
+  }
+  Q = V[0]*B[0];
+  for (int i = 1; i <= degree; i++) {
+    Q += V[i]*B[i];
+  }
+}
+
+template <class Real, class Vec, int Degree>
+inline bool Bezier<Real, Vec, Degree>::
 evalDiffGeomProperties(const Real t, Vec& Q, Vec& Q_prime, Vec& Q_second,
 		       Vec& CC) const {
-  evaluate(t, Q);
-  evalDerivative(1, t, Q_prime);
-  evalDerivative(2, t, Q_second);
+  evalDerivatives(t, Q, Q_prime, Q_second);
   Real tmp = dot(Q_prime, Q_prime)/cross(Q_prime, Q_second);
   if (Numerics<Real>::isfinite(tmp)) {
     CC.setx(Q.x() - Q_prime.y()*tmp); // Center of curvature
@@ -152,59 +324,57 @@ evalDiffGeomProperties(const Real t, Vec& Q, Vec& Q_prime, Vec& Q_second,
   }
 }
 
-template <class Real, class Vec>
-inline const Real Bezier<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline const Real Bezier<Real, Vec, Degree>::
 B30(const Real u) {
   Real tmp = 1.0 - u;
   return (tmp * tmp * tmp);
 }
 
-template <class Real, class Vec>
-inline const Real Bezier<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline const Real Bezier<Real, Vec, Degree>::
 B31(const Real u) {
   Real tmp = 1.0 - u;
   return (3.0 * u * tmp * tmp);
 }
 
-template <class Real, class Vec>
-inline const Real Bezier<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline const Real Bezier<Real, Vec, Degree>::
 B32(const Real u) {
   Real tmp = 1.0 - u;
   return (3.0 * u * u * tmp);
 }
 
-template <class Real, class Vec>
-inline const Real Bezier<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline const Real Bezier<Real, Vec, Degree>::
 B33(const Real u) {
   return (u * u * u);
 }
 
-template <class Real, class Vec>
-inline Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline Bezier_Augmented<Real, Vec, Degree>::
 Bezier_Augmented()
-  : Bezier<Real, Vec>(),
+  : Bezier<Real, Vec, Degree>(),
   length(0.0), T(), C(), R(), N() {}
 
-template <class Real, class Vec>
-inline Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline Bezier_Augmented<Real, Vec, Degree>::
 Bezier_Augmented(const int degree)
-  : Bezier<Real, Vec>(degree),
+  : Bezier<Real, Vec, Degree>(degree),
   length(0.0), T(degree+1), C(degree+1), R(degree+1), N(degree+1) {}
 
-template <class Real, class Vec>
-inline Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline Bezier_Augmented<Real, Vec, Degree>::
 Bezier_Augmented(const Bezier_Augmented& b)
-  : Bezier<Real, Vec>(b),
+  : Bezier<Real, Vec, Degree>(b),
   length(b.length), T(b.T), C(b.C), R(b.R), N(b.N) {}
 
-template <class Real, class Vec>
-inline void Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline void Bezier_Augmented<Real, Vec, Degree>::
 findNewtonRaphsonRoot(Point<Real, Vec>& P) {
   /* Q, Q' and Q'' evaluated at u */
   Vec Q_u, Q1_u, Q2_u;
-  evaluate(P.u, Q_u);
-  evalDerivative(1, P.u, Q1_u);
-  evalDerivative(2, P.u, Q2_u);
+  evalDerivatives(P.u, Q_u, Q1_u, Q2_u);
   
   /* Compute f(u)/f'(u) */
   Real numerator = (Q_u.x() - P.pos.x()) * (Q1_u.x()) +
@@ -218,8 +388,8 @@ findNewtonRaphsonRoot(Point<Real, Vec>& P) {
   P.u -= numerator/denominator;
 }
 
-template <class Real, class Vec>
-inline void Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline void Bezier_Augmented<Real, Vec, Degree>::
 evalLength(const int nstep) {
   const Real step_size = 1.0/nstep;
   Vec Q_prev, Q_curr;
@@ -231,8 +401,19 @@ evalLength(const int nstep) {
   }
 }
 
-template <class Real, class Vec>
-inline void Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline void Bezier_Augmented<Real, Vec, Degree>::
+evalArcLength() {
+  if (V.empty()) {
+    length = 0.0;
+  }
+  else {
+    length = Arc_Length<Real, Vec>::evaluate(&V[0], V.size());
+  }
+}
+
+template <class Real, class Vec, int Degree>
+inline void Bezier_Augmented<Real, Vec, Degree>::
 evalParameters() {
   /* Warning: Only valid for cubic Bezier curves! */
 #if 0
@@ -265,15 +446,14 @@ evalParameters() {
   Point<Real, Vec> P1(V[1], u1);
   Point<Real, Vec> P2(V[2], u2);
   
-  Vec Q, Q_prime;
+  Vec Q, Q_prime, Q_second;
   const int maxIterations = 4;   // Magic number!
   const Real threshold = 1.0e-3; // Magic number!
   int iter;
   for (iter = 0; iter < maxIterations; iter++) {
     findNewtonRaphsonRoot(P1);
     //cerr << "P1.u " << P1.u << endl;
-    evaluate(P1.u, Q);
-    evalDerivative(1, P1.u, Q_prime);
+    evalDerivatives(P1.u, Q, Q_prime, Q_second);
     Real result = Numerics<Real>::fpabs(dot(Q - V[1], Q_prime));
     if (result < threshold) {
       break;
@@ -282,8 +462,7 @@ evalParameters() {
   for (iter = 0; iter < maxIterations; iter++) {
     findNewtonRaphsonRoot(P2);
     //cerr << "P2.u " << P2.u << endl;
-    evaluate(P2.u, Q);
-    evalDerivative(1, P2.u, Q_prime);
+    evalDerivatives(P2.u, Q, Q_prime, Q_second);
     Real result = Numerics<Real>::fpabs(dot(Q - V[2], Q_prime));
     if (result < threshold) {
       break;
@@ -304,8 +483,8 @@ evalParameters() {
   }
 }
 
-template <class Real, class Vec>
-inline void Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline void Bezier_Augmented<Real, Vec, Degree>::
 computeRadii() {
   if (R.empty()) {
     for (int i = 0; i < V.size(); i++) {
@@ -319,8 +498,8 @@ computeRadii() {
   }
 }
 
-template <class Real, class Vec>
-inline void Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline void Bezier_Augmented<Real, Vec, Degree>::
 computeNormals() {
   if (N.empty()) {
     for (int i = 0; i < V.size(); i++) {
@@ -334,28 +513,34 @@ computeNormals() {
   }
 }
 
-template <class Real, class Vec>
-inline void Bezier_Augmented<Real, Vec>::
-read(std::ifstream& file_in) {}
-
-template <>
-inline void Bezier_Augmented< double, Vec3<double> >::
+/*
+ *  read :
+ *  Only for curves in space (Vec3), into empty data. False if the number
+ *  of control points is not Degree + 1 (for a fixed degree), or if the
+ *  file ends before the data.
+ */
+template <class Real, class Vec, int Degree>
+inline bool Bezier_Augmented<Real, Vec, Degree>::
 read(std::ifstream& file_in) {
   char line[256];
   file_in.getline(line, 256, '\n');
   int n;
-  sscanf(line, "%d", &n);
+  if (!file_in || sscanf(line, "%d", &n) != 1 || n < 0 ||
+      (Degree >= 0 && n != Degree + 1)) {
+    return false;
+  }
   file_in.getline(line, 256, '\n');
-  sscanf(line, "%lf", &length);
-  
   double r;
-  Vec3<double> v;
+  sscanf(line, "%lf", &r);
+  length = r;
+  
+  double x, y, z;
   
   int i;
   for (i = 0; i < n; i++) {
     file_in.getline(line, 256, '\n');
-    sscanf(line, "%lf %lf %lf", &v[0], &v[1], &v[2]);
-    V.push_back(v);
+    sscanf(line, "%lf %lf %lf", &x, &y, &z);
+    V.push_back(Vec(x, y, z));
   }
   for (i = 0; i < n; i++) {
     file_in.getline(line, 256, '\n');
@@ -364,8 +549,8 @@ read(std::ifstream& file_in) {
   }
   for (i = 0; i < n; i++) {
     file_in.getline(line, 256, '\n');
-    sscanf(line, "%lf %lf %lf", &v[0], &v[1], &v[2]);
-    C.push_back(v);
+    sscanf(line, "%lf %lf %lf", &x, &y, &z);
+    C.push_back(Vec(x, y, z));
   }
   for (i = 0; i < n; i++) {
     file_in.getline(line, 256, '\n');
@@ -374,13 +559,14 @@ read(std::ifstream& file_in) {
   }
   for (i = 0; i < n; i++) {
     file_in.getline(line, 256, '\n');
-    sscanf(line, "%lf %lf %lf", &v[0], &v[1], &v[2]);
-    N.push_back(v);
+    sscanf(line, "%lf %lf %lf", &x, &y, &z);
+    N.push_back(Vec(x, y, z));
   }
+  return !file_in.fail();
 }
 
-template <class Real, class Vec>
-inline void Bezier_Augmented<Real, Vec>::
+template <class Real, class Vec, int Degree>
+inline void Bezier_Augmented<Real, Vec, Degree>::
 write(std::ofstream& file_out) const {
   file_out << V.size() << endl;
   file_out << length << endl;
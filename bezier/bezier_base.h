@@ -5,44 +5,55 @@
 #include "vec2.h"
 #include "vec3.h"
 
-template <class Real, class Vec>
+/*
+ *  Control points stored in Points, a std::vector by default, or any
+ *  container with the same interface (a fixed capacity inline one, say).
+ */
+template < class Real, class Vec, class Points = std::vector<Vec> >
 class Bezier_Base {
 public:
   typedef Real                       real;
   typedef Vec                        vec;
   typedef Vec                        control_point;
-  typedef std::vector<control_point> control_points;
+  typedef Points                     control_points;
   
   Bezier_Base();
   Bezier_Base(const typename control_points::size_type size);
   Bezier_Base(const Bezier_Base& b);
   void drawControlPoints() const;
   static Real Bernstein(const int i, const int n, const Real t);
+  static void Bernstein(const int n, const Real t, Real* B);
   
   control_points V;
+  
+protected:
+  static void vertex(const Vec3<GLfloat>& P);
+  static void vertex(const Vec3<GLdouble>& P);
+  template <class Point>
+  static void vertex(const Point& P) {}
 };
 
 /*
  *  Definition of inlined methods
  */
 
-template <class Real, class Vec>
-inline Bezier_Base<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline Bezier_Base<Real, Vec, Points>::
 Bezier_Base()
   : V() {}
 
-template <class Real, class Vec>
-inline Bezier_Base<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline Bezier_Base<Real, Vec, Points>::
 Bezier_Base(const typename control_points::size_type size)
   : V(size) {}
 
-template <class Real, class Vec>
-inline Bezier_Base<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline Bezier_Base<Real, Vec, Points>::
 Bezier_Base(const Bezier_Base& b)
   : V(b.V) {}
 
-template <class Real, class Vec>
-inline Real Bezier_Base<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline Real Bezier_Base<Real, Vec, Points>::
 Bernstein(const int i, const int n, const Real t) {
   const Real binomial_coefficient
     =  Numerics<int>::factorial(n) /
@@ -51,28 +62,49 @@ Bernstein(const int i, const int n, const Real t) {
                                 Numerics<real>::power(1.0 - t, n - i);
 }
 
-template <class Real, class Vec>
-inline void Bezier_Base<Real, Vec>::
-drawControlPoints() const {}
-
-template <>
-inline void Bezier_Base< GLfloat, Vec3<GLfloat> >::
-drawControlPoints() const {
-  glBegin(GL_POINTS);
-  for (control_points::const_iterator p = V.begin(); p != V.end(); p++) {
-    glVertex3fv(&(*p)[0]);
+/*
+ *  Bernstein :
+ *  All the Bernstein polynomials of degree n at t, in B[0..n], by the
+ *  recurrence B(i, k) = (1-t) B(i, k-1) + t B(i-1, k-1).
+ */
+template <class Real, class Vec, class Points>
+inline void Bezier_Base<Real, Vec, Points>::
+Bernstein(const int n, const Real t, Real* B) {
+  B[0] = 1.0;
+  for (int k = 1; k <= n; k++) {
+    B[k] = t*B[k-1];
+    for (int i = k-1; i > 0; i--) {
+      B[i] = (1.0 - t)*B[i] + t*B[i-1];
+    }
+    B[0] *= 1.0 - t;
   }
-  glEnd();
 }
 
-template <>
-inline void Bezier_Base< GLdouble, Vec3<GLdouble> >::
+template <class Real, class Vec, class Points>
+inline void Bezier_Base<Real, Vec, Points>::
 drawControlPoints() const {
   glBegin(GL_POINTS);
-  for (control_points::const_iterator p = V.begin(); p != V.end(); p++) {
-    glVertex3dv(&(*p)[0]);
+  for (typename control_points::const_iterator p = V.begin(); p != V.end();
+       p++) {
+    vertex(*p);
   }
   glEnd();
 }
 
+/*
+ *  vertex :
+ *  glVertex3 of a point in space, nothing for other points.
+ */
+template <class Real, class Vec, class Points>
+inline void Bezier_Base<Real, Vec, Points>::
+vertex(const Vec3<GLfloat>& P) {
+  glVertex3fv(&P[0]);
+}
+
+template <class Real, class Vec, class Points>
+inline void Bezier_Base<Real, Vec, Points>::
+vertex(const Vec3<GLdouble>& P) {
+  glVertex3dv(&P[0]);
+}
+
 #endif // BEZIER_BASE_H
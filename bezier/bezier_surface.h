@@ -1,13 +1,14 @@
 #ifndef BEZIER_SURFACE_H
 #define BEZIER_SURFACE_H
 
+#include <cassert>
 #include <GL/gl.h>
 #include <bezier_base.h>
 
-template <class Real, class Vec>
-class Bezier_Surface : public Bezier_Base<Real, Vec> {
+template < class Real, class Vec, class Points = std::vector<Vec> >
+class Bezier_Surface : public Bezier_Base<Real, Vec, Points> {
 private:
-  typedef Bezier_Base<Real, Vec> base;
+  typedef Bezier_Base<Real, Vec, Points> base;
   
 public:
   Bezier_Surface();
@@ -15,6 +16,11 @@ public:
   Bezier_Surface(const Bezier_Surface& b);
   void setControlPoint(const int i, const int j, const Vec& V_ij);
   void evaluate(const Real u, const Real v, Vec& Q) const;
+  void evaluateGrid(const int nstep_u, const int nstep_v, Vec* Q) const;
+  void splitU(const Real u, Bezier_Surface& first,
+	      Bezier_Surface& second) const;
+  void splitV(const Real v, Bezier_Surface& first,
+	      Bezier_Surface& second) const;
 #if 0
   void evaluateDerivative(const int order,
 		          const Real u, const Real v, Vec& Q) const;
@@ -22,36 +28,49 @@ public:
   void draw(const GLint nstep_u, const GLint nstep_v) const;
   
   typename base::control_points::size_type order_u, order_v;
+  
+private:
+  static void deCasteljauSplit(const Vec* P, const int stride,
+			       const int order, const Real t,
+			       Vec* first, Vec* second);
+  static bool map(const Vec3<GLfloat>* P, const int order_u,
+		  const int order_v);
+  static bool map(const Vec3<GLdouble>* P, const int order_u,
+		  const int order_v);
+  template <class Point>
+  static bool map(const Point* P, const int order_u, const int order_v) {
+    return false;
+  }
 };
 
 /*
  *  Definition of inlined methods
  */
 
-template <class Real, class Vec>
-inline Bezier_Surface<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline Bezier_Surface<Real, Vec, Points>::
 Bezier_Surface()
-  : Bezier_Base<Real, Vec>(), order_u(0), order_v(0) {}
+  : base(), order_u(0), order_v(0) {}
 
-template <class Real, class Vec>
-inline Bezier_Surface<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline Bezier_Surface<Real, Vec, Points>::
 Bezier_Surface(const int degree_u, const int degree_v)
-  : Bezier_Base<Real, Vec>((degree_u + 1)*(degree_v + 1)),
+  : base((degree_u + 1)*(degree_v + 1)),
   order_u(degree_u + 1), order_v(degree_v + 1) {}
 
-template <class Real, class Vec>
-inline Bezier_Surface<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline Bezier_Surface<Real, Vec, Points>::
 Bezier_Surface(const Bezier_Surface& b)
-  : Bezier_Base<Real, Vec>(b), order_u(b.order_u), order_v(b.order_v) {}
+  : base(b), order_u(b.order_u), order_v(b.order_v) {}
 
-template <class Real, class Vec>
-inline void Bezier_Surface<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline void Bezier_Surface<Real, Vec, Points>::
 setControlPoint(const int i, const int j, const Vec& V_ij) {
   V[j*order_u + i] = V_ij;
 }
 
-template <class Real, class Vec>
-inline void Bezier_Surface<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline void Bezier_Surface<Real, Vec, Points>::
 evaluate(const Real u, const Real v, Vec& Q) const {
   typename base::control_points::size_type degree_u = order_u - 1;
   typename base::control_points::size_type degree_v = order_v - 1;
@@ -59,8 +78,8 @@ evaluate(const Real u, const Real v, Vec& Q) const {
   /* Tensor product approach */
   typename base::control_points V_tmp_v;
   for (int j = 0; j < order_v; j++) {
-    typename base::control_points V_tmp_u(V.begin() + j*order_u,
-				          V.begin() + (j+1)*order_u);
+    typename base::control_points V_tmp_u;
+    V_tmp_u.assign(V.begin() + j*order_u, V.begin() + (j+1)*order_u);
     // Triangle computation: de Casteljau's algorithm (along u)
     for (int i = 1; i <= degree_u; i++) {
       for (typename base::control_points::iterator p = V_tmp_u.begin();
@@ -81,33 +100,134 @@ evaluate(const Real u, const Real v, Vec& Q) const {
   Q = V_tmp_v.front(); // Point on curve at parameters (u,v)
 }
 
+/*
+ *  evaluateGrid :
+ *  Points of the surface at the parameters of a regular grid, as
+ *  glEvalMesh2 would evaluate them, stored in Q row after row of constant v
+ *  ((nstep_u + 1)*(nstep_v + 1) points). The Bernstein polynomials are
+ *  computed once per row and column, rather than once per point.
+ */
+template <class Real, class Vec, class Points>
+inline void Bezier_Surface<Real, Vec, Points>::
+evaluateGrid(const int nstep_u, const int nstep_v, Vec* Q) const {
+  const int ou = order_u, ov = order_v;
+  std::vector<Real> B_u((nstep_u + 1)*ou), B_v((nstep_v + 1)*ov);
+  for (int i = 0; i <= nstep_u; i++) {
+    base::Bernstein(ou - 1, static_cast<Real>(i)/nstep_u, &B_u[i*ou]);
+  }
+  for (int j = 0; j <= nstep_v; j++) {
+    base::Bernstein(ov - 1, static_cast<Real>(j)/nstep_v, &B_v[j*ov]);
+  }
+  
+  /* Rows of control points blended along v, then along u */
+  typename base::control_points V_tmp(ou);
+  for (int j = 0; j <= nstep_v; j++) {
+    const Real* b_v = &B_v[j*ov];
+    for (int k = 0; k < ou; k++) {
+      V_tmp[k] = V[k]*b_v[0];
+      for (int l = 1; l < ov; l++) {
+	V_tmp[k] += V[l*ou + k]*b_v[l];
+      }
+    }
+    for (int i = 0; i <= nstep_u; i++, Q++) {
+      const Real* b_u = &B_u[i*ou];
+      (*Q) = V_tmp[0]*b_u[0];
+      for (int k = 1; k < ou; k++) {
+	(*Q) += V_tmp[k]*b_u[k];
+      }
+    }
+  }
+}
+
+/*
+ *  splitU, splitV :
+ *  The two patches of the surface over [0,u] and [u,1] (or [0,v] and
+ *  [v,1]), by de Casteljau's algorithm on each row (or column) of control
+ *  points.
+ */
+template <class Real, class Vec, class Points>
+inline void Bezier_Surface<Real, Vec, Points>::
+splitU(const Real u, Bezier_Surface& first, Bezier_Surface& second) const {
+  first = second = *this;
+  for (int j = 0; j < order_v; j++) {
+    deCasteljauSplit(&V[j*order_u], 1, order_u, u,
+		     &first.V[j*order_u], &second.V[j*order_u]);
+  }
+}
+
+template <class Real, class Vec, class Points>
+inline void Bezier_Surface<Real, Vec, Points>::
+splitV(const Real v, Bezier_Surface& first, Bezier_Surface& second) const {
+  first = second = *this;
+  for (int i = 0; i < order_u; i++) {
+    deCasteljauSplit(&V[i], order_u, order_v, v,
+		     &first.V[i], &second.V[i]);
+  }
+}
+
+/*
+ *  deCasteljauSplit :
+ *  Control points of the two halves, at t, of the curve of the given order
+ *  whose control points are stride apart in P (and in first and second).
+ */
+template <class Real, class Vec, class Points>
+inline void Bezier_Surface<Real, Vec, Points>::
+deCasteljauSplit(const Vec* P, const int stride, const int order,
+		 const Real t, Vec* first, Vec* second) {
+  enum {MAX_ORDER = 16}; // Of the curves split without allocation
+  assert(order <= MAX_ORDER);
+  Vec Q[MAX_ORDER];
+  int i;
+  for (i = 0; i < order; i++) {
+    Q[i] = P[i*stride];
+  }
+  const int degree = order - 1;
+  first[0] = Q[0];
+  second[degree*stride] = Q[degree];
+  for (int k = 1; k <= degree; k++) {
+    for (i = 0; i <= degree - k; i++) {
+      Q[i] = Q[i]*(1.0 - t) + Q[i+1]*(t);
+    }
+    first[k*stride] = Q[0];
+    second[(degree - k)*stride] = Q[degree - k];
+  }
+}
+
 #if 0
-template <class Real, class Vec>
-inline void Bezier_Surface<Real, Vec>::
+template <class Real, class Vec, class Points>
+inline void Bezier_Surface<Real, Vec, Points>::
 evaluateDerivative(const int order, const Real u, const Real v, Vec& Q) const {
 }
 #endif
 
-template <class Real, class Vec>
-inline void Bezier_Surface<Real, Vec>::
-draw(const GLint nstep_u, const GLint nstep_v) const {}
-
-template <>
-inline void Bezier_Surface< GLfloat, Vec3<GLfloat> >::
+template <class Real, class Vec, class Points>
+inline void Bezier_Surface<Real, Vec, Points>::
 draw(const GLint nstep_u, const GLint nstep_v) const {
+  if (map(&V[0], order_u, order_v)) {
+    glMapGrid2d(nstep_u, 0.0, 1.0, nstep_v, 0.0, 1.0);
+    glEvalMesh2(GL_FILL, 0, nstep_u, 0, nstep_v);
+  }
+}
+
+/*
+ *  map :
+ *  glMap2 of the control points of a surface in space, and true, or false
+ *  (and nothing) for other control points.
+ */
+template <class Real, class Vec, class Points>
+inline bool Bezier_Surface<Real, Vec, Points>::
+map(const Vec3<GLfloat>* P, const int order_u, const int order_v) {
   glMap2f(GL_MAP2_VERTEX_3, 0.0, 1.0,         3, order_u,
-                            0.0, 1.0, order_u*3, order_v, &V[0][0]);
-  glMapGrid2f(nstep_u, 0.0, 1.0, nstep_v, 0.0, 1.0);
-  glEvalMesh2(GL_FILL, 0, nstep_u, 0, nstep_v);
+                            0.0, 1.0, order_u*3, order_v, &P[0][0]);
+  return true;
 }
 
-template <>
-inline void Bezier_Surface< GLdouble, Vec3<GLdouble> >::
-draw(const GLint nstep_u, const GLint nstep_v) const {
+template <class Real, class Vec, class Points>
+inline bool Bezier_Surface<Real, Vec, Points>::
+map(const Vec3<GLdouble>* P, const int order_u, const int order_v) {
   glMap2d(GL_MAP2_VERTEX_3, 0.0, 1.0,         3, order_u,
-                            0.0, 1.0, order_u*3, order_v, &V[0][0]);
-  glMapGrid2d(nstep_u, 0.0, 1.0, nstep_v, 0.0, 1.0);
-  glEvalMesh2(GL_FILL, 0, nstep_u, 0, nstep_v);
+                            0.0, 1.0, order_u*3, order_v, &P[0][0]);
+  return true;
 }
 
 #endif // BEZIER_SURFACE_H
@@ -0,0 +1,148 @@
+#if __AVX__
+#include <immintrin.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+#include "clipping_planes.h"
+
+const Clipping_Planes::real Clipping_Planes::ratio
+  = /*0.25*/0.2; // Magic number!
+
+Clipping_Planes::Clipping_Planes()
+  : changed(true) {
+  view[0] = view[1] = view[2] = 0.0;
+}
+
+/*
+ *  set :
+ *  Barycenter and mean radius of stroke i, new or changed. The arrays grow
+ *  as needed, the equations are computed again by the next update.
+ */
+void Clipping_Planes::set(const int i, const real barycenter[3],
+			  const real mean_radius) {
+  if (i >= x.size()) {
+    x.resize(i + 1, 0.0);
+    y.resize(i + 1, 0.0);
+    z.resize(i + 1, 0.0);
+    radius.resize(i + 1, 0.0);
+    eqns.resize(8*(i + 1), 0.0);
+  }
+  x[i] = barycenter[0];
+  y[i] = barycenter[1];
+  z[i] = barycenter[2];
+  radius[i] = mean_radius;
+  changed = true;
+}
+
+void Clipping_Planes::clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  radius.clear();
+  eqns.clear();
+  changed = true;
+}
+
+/*
+ *  update :
+ *  Equations of the planes of all the strokes, if the view vector or one
+ *  of them changed. The first plane goes through the barycenter plus
+ *  ratio*mean_radius times the opposite of the view vector and faces the
+ *  view vector, the second one is its mirror image. Both are computed
+ *  coefficient after coefficient, the same way for every stroke, vector
+ *  lanes included.
+ */
+void Clipping_Planes::update(const real view_vector[3]) {
+  if (!changed &&
+      view[0] == view_vector[0] && view[1] == view_vector[1] &&
+      view[2] == view_vector[2]) {
+    return;
+  }
+  view[0] = view_vector[0];
+  view[1] = view_vector[1];
+  view[2] = view_vector[2];
+  changed = false;
+
+  const real n[3] = {-view[0], -view[1], -view[2]}; // Current normal
+  const int size = x.size();
+  GLdouble* eqn = size > 0 ? &eqns[0] : 0;
+  int i;
+  for (i = 0; i < size; i++, eqn += 8) {
+    eqn[0] = view[0]; eqn[1] = view[1]; eqn[2] = view[2];
+    eqn[4] = n[0];    eqn[5] = n[1];    eqn[6] = n[2];
+  }
+
+  i = 0;
+  eqn = size > 0 ? &eqns[0] : 0;
+#if __AVX__
+  {
+    const __m256d r = _mm256_set1_pd(ratio);
+    const __m256d n0 = _mm256_set1_pd(n[0]), v0 = _mm256_set1_pd(view[0]);
+    const __m256d n1 = _mm256_set1_pd(n[1]), v1 = _mm256_set1_pd(view[1]);
+    const __m256d n2 = _mm256_set1_pd(n[2]), v2 = _mm256_set1_pd(view[2]);
+    for (; i + 4 <= size; i += 4, eqn += 32) {
+      const __m256d k = _mm256_mul_pd(r, _mm256_loadu_pd(&radius[i]));
+      const __m256d o0 = _mm256_mul_pd(k, n0);
+      const __m256d o1 = _mm256_mul_pd(k, n1);
+      const __m256d o2 = _mm256_mul_pd(k, n2);
+      const __m256d b0 = _mm256_loadu_pd(&x[i]);
+      const __m256d b1 = _mm256_loadu_pd(&y[i]);
+      const __m256d b2 = _mm256_loadu_pd(&z[i]);
+      __m256d d0 = _mm256_setzero_pd(), d1 = _mm256_setzero_pd();
+      d0 = _mm256_sub_pd(d0, _mm256_mul_pd(v0, _mm256_add_pd(b0, o0)));
+      d0 = _mm256_sub_pd(d0, _mm256_mul_pd(v1, _mm256_add_pd(b1, o1)));
+      d0 = _mm256_sub_pd(d0, _mm256_mul_pd(v2, _mm256_add_pd(b2, o2)));
+      d1 = _mm256_sub_pd(d1, _mm256_mul_pd(n0, _mm256_sub_pd(b0, o0)));
+      d1 = _mm256_sub_pd(d1, _mm256_mul_pd(n1, _mm256_sub_pd(b1, o1)));
+      d1 = _mm256_sub_pd(d1, _mm256_mul_pd(n2, _mm256_sub_pd(b2, o2)));
+      real q0[4], q1[4];
+      _mm256_storeu_pd(q0, d0);
+      _mm256_storeu_pd(q1, d1);
+      for (int l = 0; l < 4; l++) {
+	eqn[8*l + 3] = q0[l];
+	eqn[8*l + 7] = q1[l];
+      }
+    }
+  }
+#elif __SSE2__
+  {
+    const __m128d r = _mm_set1_pd(ratio);
+    const __m128d n0 = _mm_set1_pd(n[0]), v0 = _mm_set1_pd(view[0]);
+    const __m128d n1 = _mm_set1_pd(n[1]), v1 = _mm_set1_pd(view[1]);
+    const __m128d n2 = _mm_set1_pd(n[2]), v2 = _mm_set1_pd(view[2]);
+    for (; i + 2 <= size; i += 2, eqn += 16) {
+      const __m128d k = _mm_mul_pd(r, _mm_loadu_pd(&radius[i]));
+      const __m128d o0 = _mm_mul_pd(k, n0);
+      const __m128d o1 = _mm_mul_pd(k, n1);
+      const __m128d o2 = _mm_mul_pd(k, n2);
+      const __m128d b0 = _mm_loadu_pd(&x[i]);
+      const __m128d b1 = _mm_loadu_pd(&y[i]);
+      const __m128d b2 = _mm_loadu_pd(&z[i]);
+      __m128d d0 = _mm_setzero_pd(), d1 = _mm_setzero_pd();
+      d0 = _mm_sub_pd(d0, _mm_mul_pd(v0, _mm_add_pd(b0, o0)));
+      d0 = _mm_sub_pd(d0, _mm_mul_pd(v1, _mm_add_pd(b1, o1)));
+      d0 = _mm_sub_pd(d0, _mm_mul_pd(v2, _mm_add_pd(b2, o2)));
+      d1 = _mm_sub_pd(d1, _mm_mul_pd(n0, _mm_sub_pd(b0, o0)));
+      d1 = _mm_sub_pd(d1, _mm_mul_pd(n1, _mm_sub_pd(b1, o1)));
+      d1 = _mm_sub_pd(d1, _mm_mul_pd(n2, _mm_sub_pd(b2, o2)));
+      real q0[2], q1[2];
+      _mm_storeu_pd(q0, d0);
+      _mm_storeu_pd(q1, d1);
+      eqn[3] = q0[0]; eqn[11] = q0[1];
+      eqn[7] = q1[0]; eqn[15] = q1[1];
+    }
+  }
+#endif
+  for (; i < size; i++, eqn += 8) {
+    const real k = ratio*radius[i];
+    const real o[3] = {k*n[0], k*n[1], k*n[2]};
+    eqn[3] = 0.0;
+    eqn[3] -= view[0]*(x[i] + o[0]);
+    eqn[3] -= view[1]*(y[i] + o[1]);
+    eqn[3] -= view[2]*(z[i] + o[2]);
+    eqn[7] = 0.0;
+    eqn[7] -= n[0]*(x[i] - o[0]);
+    eqn[7] -= n[1]*(y[i] - o[1]);
+    eqn[7] -= n[2]*(z[i] - o[2]);
+  }
+}
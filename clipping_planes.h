@@ -0,0 +1,55 @@
+#ifndef CLIPPING_PLANES_H
+#define CLIPPING_PLANES_H
+
+#include <vector>
+#include <GL/gl.h>
+
+/*
+ *  Clipping planes of the strokes of a drawing, which keep the part of a
+ *  stroke around its barycenter, across the view direction. Barycenters
+ *  and mean radii are stored in one array per coordinate, so that the
+ *  equations of all the strokes are computed in one pass when the view
+ *  changes, four strokes per (AVX) or two (SSE2) vector operations.
+ *  Strokes are indexed by small integers, as the nodes of their graph.
+ */
+class Clipping_Planes {
+public:
+  typedef GLdouble real;
+
+  Clipping_Planes();
+  void set(const int i, const real barycenter[3], const real mean_radius);
+  void clear();
+  void update(const real view_vector[3]);
+  const GLdouble* equations(const int i) const;
+  int size() const;
+
+  static const real ratio; // Of the mean radius, between the planes
+
+private:
+  std::vector<real> x, y, z; // Barycenters
+  std::vector<real> radius;  // Mean radii
+  std::vector<GLdouble> eqns; // Two planes of four coefficients per stroke
+  real view[3];              // Of the equations
+  bool changed;              // Since the equations
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+/*
+ *  equations :
+ *  Equations of the two planes of stroke i, one after the other, for
+ *  glClipPlane.
+ */
+inline const GLdouble* Clipping_Planes::
+equations(const int i) const {
+  return &eqns[8*i];
+}
+
+inline int Clipping_Planes::
+size() const {
+  return x.size();
+}
+
+#endif // CLIPPING_PLANES_H
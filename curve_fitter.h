@@ -0,0 +1,103 @@
+#ifndef CURVE_FITTER_H
+#define CURVE_FITTER_H
+
+#include <vector>
+#include <GL/gl.h>
+#include "bezier.h"
+#include "cubic_kernel.h"
+
+class Curve_Fitter {
+public:
+  typedef GLdouble                      real;
+  typedef Vec2<real>                    vec2;
+  typedef Point<real, vec2>             point;
+  typedef std::vector<point>            points;
+  typedef Bezier_Augmented<real, vec2, 3> bezier;
+  typedef std::vector<bezier>           beziers;
+
+private:
+  /* Pending region of the split stack */
+  class Span {
+  public:
+    Span() {}
+    Span(const int f, const int l, const vec2& t1, const vec2& t2)
+      : first(f), last(l), tanv1(t1), tanv2(t2) {}
+
+    int first, last;   // Indices of the first and last points
+    vec2 tanv1, tanv2; // Unit tangent vectors at endpoints
+  };
+
+  /*
+   *  Main source of inspiration for Bezier fitting:
+   *  An Algorithm for Automatically Fitting Digitized Curves
+   *  by Philip J. Schneider
+   *  from Graphics Gems, Academic Press, 1990.
+   */
+  void fitCubic(const points& pts, const Span& s, const real error,
+		beziers& bs);
+  void generateBezier(const points& pts, const Span& s);
+  void computeMaxError(const int first, const int last,
+		       int& split, real& maxError);
+  void chordLengthParameterize(const points& pts,
+			       const int first, const int last);
+  void reparameterize(const int first, const int last);
+  void setKernel();
+  void emit(const Span& s, beziers& bs);
+
+  vec2 leftTangent(const points& pts, const int first, const int npoints);
+  vec2 rightTangent(const points& pts, const int last, const int npoints);
+  vec2 centerTangent(const points& pts, const int split);
+
+  template <class T> void grow(std::vector<T>& v, const int n);
+
+  /* Workspace, reused from one stroke to the next */
+  std::vector<real> u;      // Parameter value of each point
+  std::vector<vec2> A1, A2; // Precomputed rhs of the least-squares system
+  std::vector<real> errors; // Distance of each point to the fitted curve
+  std::vector<real> px, py; // Coordinates of each point
+  std::vector<Span> stack;  // Regions still to be fitted
+  vec2 W[4];                // Control points of the current cubic
+  Cubic_Kernel kernel;      // Batch evaluator of the current cubic
+  int offset;               // Index of the first point of the curve
+  int emitted_first;        // Index of the first point of the last cubic
+
+  long nallocs;
+
+public:
+  Curve_Fitter();
+  void reserve(const int npoints);
+  void fitCurve(const points& pts, const int first, const int last,
+		const real error, beziers& bs);
+  void fitCurve(const points& pts, const int first, const int last,
+		const vec2& tanv1, const real error, beziers& bs);
+  int lastCubicFirst() const;
+  long allocations() const;
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+template <class T>
+inline void Curve_Fitter::
+grow(std::vector<T>& v, const int n) {
+  if (static_cast<int>(v.capacity()) < n) {
+    v.reserve(2*n);
+    nallocs++;
+  }
+  if (static_cast<int>(v.size()) < n) {
+    v.resize(n);
+  }
+}
+
+inline int Curve_Fitter::
+lastCubicFirst() const {
+  return emitted_first;
+}
+
+inline long Curve_Fitter::
+allocations() const {
+  return nallocs;
+}
+
+#endif // CURVE_FITTER_H
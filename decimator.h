@@ -0,0 +1,65 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <vector>
+#include <GL/gl.h>
+#include "point.h"
+
+/*
+ *  Pre-fit decimation of the input points, one of:
+ *  - RDP: Ramer-Douglas-Peucker, dropping points closer than tolerance to
+ *  the polyline of the kept ones;
+ *  - ARC_LENGTH: resampling of the input polyline every tolerance pixels;
+ *  - CURVATURE: dropping points while the sagitta of the arc since the last
+ *  kept point, estimated from its length and turning angle, stays below
+ *  tolerance (so spacing adapts to curvature).
+ *  Points are processed by chunks [first; last], whose end points are
+ *  always kept, so that decimation can follow the input while drawing.
+ */
+class Decimator {
+public:
+  typedef GLdouble          real;
+  typedef Vec2<real>        vec2;
+  typedef Point<real, vec2> point;
+  typedef std::vector<point> points;
+
+  enum decimationmode {NONE, RDP, ARC_LENGTH, CURVATURE};
+
+private:
+  void rdp(const points& in, const int first, const int last, points& out);
+  void resample(const points& in, const int first, const int last,
+		points& out);
+  void curvature(const points& in, const int first, const int last,
+		 points& out);
+
+  int mode;
+  real tolerance;
+  std::vector<int> stack;  // Workspace of rdp
+  std::vector<char> keep;
+  long nin, nout;          // Points read and written since reset
+
+public:
+  Decimator(const int m = NONE, const real tol = 1.0);
+  void setMode(const int m, const real tol);
+  int decimationMode() const;
+  void decimate(const points& in, const int first, const int last,
+		points& out);
+  void reset();
+  long removed() const;
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+inline int Decimator::
+decimationMode() const {
+  return mode;
+}
+
+inline long Decimator::
+removed() const {
+  return nin - nout;
+}
+
+#endif // DECIMATOR_H
@@ -3,6 +3,7 @@
 #include "drawing.h"
 #include "interface.h"
 #include "display_lists.h"
+#include "scene_mesh.h"
 
 using namespace std;
 
@@ -32,6 +33,7 @@ const GLfloat button_grey = 215.0/255.0;
 // Display lists
 GLuint axes_list, box_list, grid_list, persp_first_list, persp_second_list;
 std::vector<GLuint> scene_lists;
+std::vector<Scene_Mesh> scene_meshes; // Of the scene lists, for picking
 int scene_id = 0;
 bool draw_axes = false;
 bool draw_scene = false;
@@ -61,14 +63,6 @@ enum commandmode {NO_HIT = -1, LOAD_FILE, SAVE_FILE, VOID_FILE,//tmp
 		  EDIT_STROKE, MOVE_STROKE, UNDO,
 		  PENCIL, BRUSH, ERASER};
 int tool_type = PENCIL;
-//Picking
-const GLsizei selection_buf_capacity = 4096; // Magic number!
-GLuint selection_buf[selection_buf_capacity];
-GLint selection_buf_size;
-const GLsizei feedback_buf_capacity = 4096; // Magic number!
-GLfloat feedback_buf_front[feedback_buf_capacity];
-GLfloat feedback_buf_back[feedback_buf_capacity];
-GLint feedback_buf_size_front, feedback_buf_size_back;
 // GLUI
 GLUI *file_io, *file_error, *save_warning;
 enum gluiCallbackID {OK, CANCEL, SAVE};
@@ -84,6 +78,12 @@ bool rec_input = false;
 bool drawing_saved = true;
 // Others
 Input I;
+Stream_Fitter F; // Fits I progressively while drawing
+// Pre-fit decimation, per drawing tool
+bool decimation = true;
+Decimator pencil_decimator(Decimator::CURVATURE, 0.5); // Magic numbers!
+Decimator brush_decimator(Decimator::RDP, 1.0);
+Decimator eraser_decimator(Decimator::ARC_LENGTH, 6.0);
 Drawing D;
 
 /* Functions definition */
@@ -221,6 +221,11 @@ void initBoard() {
   }
   scene_lists.push_back(scene_list);
 #endif
+  // Triangles of the scene models, captured once
+  scene_meshes.resize(scene_lists.size());
+  for (int i = 0; i < scene_lists.size(); i++) {
+    scene_meshes[i].capture(scene_lists[i], 10.0); // Magic number!
+  }
   
   /* Textures */
   std::vector<GLsizei> dim_1D(1, 128);
@@ -452,6 +457,7 @@ void boardReshape(int width, int height) {
   glMultMatrixd(&tb_board_matrix[0][0]);
   glGetDoublev(GL_MODELVIEW_MATRIX, I.mv_matrix);
   I.setViewVector();
+  I.setUnprojector();
   I.setGlobalPlane();
   D.setBackgroundVertices(I);
   glPopMatrix();
@@ -468,6 +474,7 @@ void boardDisplay() {
   if (tb_board.isMoved()) {
     glGetDoublev(GL_MODELVIEW_MATRIX, I.mv_matrix);
     I.setViewVector();
+    I.setUnprojector();
     I.setGlobalPlane();
     D.setBackgroundVertices(I);
   }
@@ -498,74 +505,38 @@ void boardDisplay() {
   glutSwapBuffers();
 }
 
-void boardSelection(int x, int y) {
-  glSelectBuffer(selection_buf_capacity, selection_buf);
-  static_cast<GLvoid>(glRenderMode(GL_SELECT));
-  glInitNames();
-  glPushName(Input::DEFAULT_NAME);
-  
-  glMatrixMode(GL_PROJECTION);
-  glPushMatrix();
-  glLoadIdentity();
-  GLdouble winx = static_cast<GLdouble>(x);
-  GLdouble winy = static_cast<GLdouble>(I.viewport[3] - 1 - y);
-  gluPickMatrix(winx, winy, 1.0, 1.0, I.viewport);
-  gluPerspective(I.fovy, I.aspect, I.near, I.far);
-  
-  glMatrixMode(GL_MODELVIEW);
-  glPushMatrix();
-  glMultMatrixd(&tb_board_matrix[0][0]);
+/*
+ *  sceneHit :
+ *  Parameter of the nearest hit of the scene along the segment through
+ *  pixel (x, y), 1.0 if none or if the scene is not drawn.
+ */
+GLdouble sceneHit(int x, int y) {
+  GLdouble t = 1.0;
   if (draw_scene) {
-    glCallList(scene_lists[scene_id]);
+    GLdouble origin[3], direction[3];
+    I.segment(x, y, origin, direction);
+    static_cast<void>(scene_meshes[scene_id].intersect(origin, direction, t));
   }
-  D.drawSelection();
-  glPopMatrix();
-  
-  glMatrixMode(GL_PROJECTION);
-  glPopMatrix();
-  
-  glMatrixMode(GL_MODELVIEW);
-  
-  selection_buf_size = glRenderMode(GL_RENDER);
-  if (selection_buf_size == -1) {
-    assert(false);
-  }
-  glFlush();
+  return t;
 }
 
-void boardFeedback(GLint& feedback_buf_size, GLfloat* feedback_buf,
-		   int x, int y) {
-  glFeedbackBuffer(feedback_buf_capacity, GL_3D, feedback_buf);
-  static_cast<GLvoid>(glRenderMode(GL_FEEDBACK));
-  
-  glMatrixMode(GL_PROJECTION);
-  glPushMatrix();
-  glLoadIdentity();
-  GLdouble winx = static_cast<GLdouble>(x);
-  GLdouble winy = static_cast<GLdouble>(I.viewport[3] - 1 - y);
-  gluPickMatrix(winx, winy, 1.0, 1.0, I.viewport);
-  gluPerspective(I.fovy, I.aspect, I.near, I.far);
-  
-  glMatrixMode(GL_MODELVIEW);
-  glPushMatrix();
-  glMultMatrixd(&tb_board_matrix[0][0]);
-  if (draw_scene) {
-    glPassThrough(I.object_tokens[Input::SCENE_INDEX]);
-    glCallList(scene_lists[scene_id]);
-  }
-  D.drawFeedback(I);
-  glPopMatrix();
-  
-  glMatrixMode(GL_PROJECTION);
-  glPopMatrix();
-  
-  glMatrixMode(GL_MODELVIEW);
-  
-  feedback_buf_size = glRenderMode(GL_RENDER);
-  if (feedback_buf_size == -1) {
-    assert(false);
+/*
+ *  boardProbe :
+ *  Nearest object under pixel (x, y), the scene or a stroke (NO_INDEX if
+ *  none), and its window depth.
+ */
+void boardProbe(int x, int y, int& object, GLdouble& winz) {
+  GLdouble origin[3], direction[3];
+  I.segment(x, y, origin, direction);
+  GLdouble t = sceneHit(x, y);
+  object = t < 1.0 ? Input::SCENE_INDEX : Input::NO_INDEX;
+  if (D.intersect(origin, direction, t) != Input::DEFAULT_NAME) {
+    object = Input::PROBA_SURFACE_INDEX;
   }
-  glFlush();
+  const GLdouble point[3] = {origin[0] + t*direction[0],
+			     origin[1] + t*direction[1],
+			     origin[2] + t*direction[2]};
+  winz = object == Input::NO_INDEX ? 1.0 : I.depth(point);
 }
 
 void boardKeyboard(unsigned char key, int x, int y) {
@@ -604,6 +575,24 @@ void boardKeyboard(unsigned char key, int x, int y) {
       setColors();
     }
     break;
+  case 'd':
+    if (Stroke2D::fitter.threads() > 1) {
+      Stroke2D::fitter.setThreads(1);
+    }
+    else {
+      Stroke2D::fitter.setThreads(0);
+    }
+    printf("Fitting with %d thread(s)\n", Stroke2D::fitter.threads());
+    break;
+  case 'e':
+    if (decimation) {
+      decimation = false;
+    }
+    else {
+      decimation = true;
+    }
+    printf("Decimation %s\n", decimation ? "on" : "off");
+    break;
   case 'f':
     if (full_screen) {
       full_screen = false;
@@ -635,12 +624,16 @@ void boardKeyboard(unsigned char key, int x, int y) {
     printf("a\tdraw Axes switch\n");
     printf("b\tBackground texture switch\n");
     printf("c\tColor switch\n");
+    printf("d\tDispatch fitting to threads switch\n");
+    printf("e\tdEcimation before fitting switch\n");
     printf("f\tFull screen switch\n");
     printf("g\tdebuG infos switch\n");
     printf("h\tdisplay Help\n");
     printf("i\treInitialize trackball\n");
+    printf("k\tbaKe stroke moves into their geometry\n");
     printf("l\tLoad data file in step mode\n");
     printf("m\tModel choice\n");
+    printf("n\tNumber of strokes in the view frustum\n");
     printf("o\tplay One step\n");
     printf("p\tPlay input data file\n");
     printf("q\tQuit\n");
@@ -653,6 +646,9 @@ void boardKeyboard(unsigned char key, int x, int y) {
   case 'i':
     tb_board.reinitializeTransf();
     break;
+  case 'k':
+    D.applyStrokeTransforms(I);
+    break;
   case 'l':
     file_mode = STEP;
     file_name_old = file_name;
@@ -661,6 +657,10 @@ void boardKeyboard(unsigned char key, int x, int y) {
   case 'm':
     chooseModel();
     break;
+  case 'n':
+    printf("%d of %d strokes in the view frustum\n", D.visibleStrokes(),
+	   D.totalStrokes());
+    break;
   case 'o':
     if (!D.readOneByOne(file_name, board)) {
       file_error->show();
@@ -730,6 +730,26 @@ void boardKeyboard(unsigned char key, int x, int y) {
   redisplay();
 }
 
+/*
+ *  toolDecimator :
+ *  Decimator of the current drawing tool, if decimation is on.
+ */
+Decimator* toolDecimator() {
+  if (!decimation) {
+    return 0;
+  }
+  switch (tool_type) {
+  case PENCIL:
+    return &pencil_decimator;
+  case BRUSH:
+    return &brush_decimator;
+  case ERASER:
+    return &eraser_decimator;
+  default:
+    return 0;
+  }
+}
+
 void boardMouse(int button, int state, int x, int y) {
   switch (button) {
   case GLUT_LEFT_BUTTON:
@@ -740,8 +760,7 @@ void boardMouse(int button, int state, int x, int y) {
       }
       if (mouse_mode == EDIT) {
 	if (tool_type == EDIT_STROKE) {
-	  boardSelection(x, y);
-	  if (I.selectStroke(selection_buf_size, selection_buf)) {
+	  if (D.pickStroke(x, y, I, sceneHit(x, y))) {
 	    D.markStroke(I);
 	  }
         }
@@ -754,6 +773,11 @@ void boardMouse(int button, int state, int x, int y) {
       }
       else if (mouse_mode == DRAW) {
 	D.unmarkStroke();
+	Decimator* dec = toolDecimator();
+	if (dec != 0) {
+	  dec->reset();
+	}
+	F.setDecimator(dec);
       }
       else {
 	assert(false);
@@ -766,27 +790,34 @@ void boardMouse(int button, int state, int x, int y) {
         int winy_front = static_cast<int>(I.positions.front().pos.y());
         int winx_back  = static_cast<int>(I.positions.back().pos.x());
         int winy_back  = static_cast<int>(I.positions.back().pos.y());
-        boardFeedback(feedback_buf_size_front, feedback_buf_front,
-		      winx_front, winy_front);
-	boardFeedback(feedback_buf_size_back, feedback_buf_back,
-		      winx_back, winy_back);
-	I.setPlanes(feedback_buf_size_front, feedback_buf_front,
-		    feedback_buf_size_back, feedback_buf_back);
+	int object_front, object_back;
+	GLdouble winz_front, winz_back;
+	boardProbe(winx_front, winy_front, object_front, winz_front);
+	boardProbe(winx_back, winy_back, object_back, winz_back);
+	I.setPlanes(object_front, winz_front, object_back, winz_back);
 	
 	if (tool_type == PENCIL) {
-	  D.addStroke(Stroke3D(I, Stroke2D(I), Stroke3D::LINE));
+	  Stroke3D s(I, Stroke2D(I, F), Stroke3D::LINE);
+	  D.addStroke(s);
         }
         else if (tool_type == BRUSH) {
-	  D.addStroke(Stroke3D(I, Stroke2D(I), Stroke3D::TEXTURED_POLYGON));
+	  Stroke3D s(I, Stroke2D(I, F), Stroke3D::TEXTURED_POLYGON);
+	  D.addStroke(s);
         }
         else if (tool_type == ERASER) {
-	  D.addStroke(Stroke3D(I, Stroke2D(I), Stroke3D::OCCLUSION));
+	  Stroke3D s(I, Stroke2D(I, F), Stroke3D::OCCLUSION);
+	  D.addStroke(s);
         }
 	else {
 	  cerr << "MOUSE MODE DRAW" << endl;//tmp
 	  cerr << "TOOL TYPE " << tool_type << endl;//tmp
 	  assert(false);
         }
+	Decimator* dec = toolDecimator();
+	if (draw_infos && dec != 0) {
+	  printf("Decimation removed %ld of %d points\n", dec->removed(),
+		 static_cast<int>(I.positions.size()));
+	}
       }
       else if (mouse_mode == EDIT) {
 	if (tool_type == EDIT_STROKE) {
@@ -808,6 +839,7 @@ void boardMouse(int button, int state, int x, int y) {
 	I.write(input_file_name);
       }
       I.clear();
+      F.clear();
     }
     break;
   case GLUT_MIDDLE_BUTTON:
@@ -843,6 +875,7 @@ void boardMouse(int button, int state, int x, int y) {
 void boardMotion(int x, int y) {
   if (mouse_mode == DRAW) {
     I.addPoint(x, y);
+    F.update(I.positions);
   }
   else if (mouse_mode == TRACK) {
     tb_board.move(x, y);
@@ -851,6 +884,7 @@ void boardMotion(int x, int y) {
     if (tool_type == EDIT_STROKE) {
     }
     else if (tool_type == MOVE_STROKE) {
+      D.moveStroke(x, y, I);
     }
     else {
       cerr << "MOUSE MODE EDIT" << endl;//tmp
@@ -1133,7 +1167,8 @@ void gluiFileIOCallback(int id) {
       }
       else {
 	input_file_name = file_name;
-	D.addStroke(Stroke3D(I, Stroke2D(I)));
+	Stroke3D s(I, Stroke2D(I));
+	D.addStroke(s);
 	drawing_saved = false;
 	I.clear();
 	file_io->hide();
@@ -4,9 +4,9 @@
 #
 TEMPLATE	= app.t
 CONFIG		= opengl debug
-DEFINES		= HEAVY_MODELS #ALPHA_TEXTURE ANTIALIASING MULTITEXTURING TEST_TEXTURE
+DEFINES		= HEAVY_MODELS #ALPHA_TEXTURE ANTIALIASING MULTITEXTURING TEST_TEXTURE STROKE3D_FLOAT EVALUATORS
 INCLUDEPATH = ./bezier ./aabb
-LIBS		+= -lglut -lglui
+LIBS		+= -lglut -lglui -lpthread
 #
 SOURCES		=	draw.cc interface.cc \
 				models_cc/greek_rev_house.cc \
@@ -15,6 +15,8 @@ SOURCES		=	draw.cc interface.cc \
 				models_cc/woody.cc \
 				models_cc/she_model.cc\
 				drawing.cc texture.cc \
-				stroke3D.cc stroke2D.cc input.cc opengl_utils.cc \
+				stroke3D.cc stroke2D.cc curve_fitter.cc stream_fitter.cc decimator.cc \
+				parallel_fitter.cc thread_pool.cc input.cc opengl_utils.cc unprojector.cc surface_mesh.cc \
+				clipping_planes.cc scene_mesh.cc \
 				texload.c widgets.c
 TARGET      =	draw
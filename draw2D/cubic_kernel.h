@@ -0,0 +1,293 @@
+#ifndef CUBIC_KERNEL_H
+#define CUBIC_KERNEL_H
+
+#include <cmath>
+#include <GL/gl.h>
+#if __AVX__
+#include <immintrin.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ *  Batched evaluation of a planar cubic Bezier curve.
+ *  Parameters, data points and results are stored as separate arrays of
+ *  coordinates (SoA), and the curve is expanded on the explicit Bernstein
+ *  basis B30..B33, so that a whole span of parameters is processed four
+ *  (AVX) or two (SSE2) values at a time. Remaining values, or all values
+ *  when no vector extension is available, go through the scalar path.
+ */
+class Cubic_Kernel {
+public:
+  typedef GLdouble real;
+
+  Cubic_Kernel();
+  Cubic_Kernel(const real x[4], const real y[4]);
+  void setControlPoints(const real x[4], const real y[4]);
+
+  void evaluate(const int n, const real* t, real* qx, real* qy) const;
+  void evaluateDerivatives(const int n, const real* t,
+			   real* q1x, real* q1y, real* q2x, real* q2y) const;
+  void evaluateDistances(const int n, const real* t,
+			 const real* px, const real* py, real* d) const;
+  void newtonStep(const int n, real* t, const real* px, const real* py) const;
+
+private:
+  real cx[4], cy[4];    // Control points
+  real c1x[3], c1y[3];  // Control points of Q'
+  real c2x[2], c2y[2];  // Control points of Q''
+
+  void evalScalar(const real t, real& x, real& y) const;
+  void newtonScalar(real& t, const real px, const real py) const;
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+inline Cubic_Kernel::
+Cubic_Kernel() {}
+
+inline Cubic_Kernel::
+Cubic_Kernel(const real x[4], const real y[4]) {
+  setControlPoints(x, y);
+}
+
+inline void Cubic_Kernel::
+setControlPoints(const real x[4], const real y[4]) {
+  for (int i = 0; i < 4; i++) {
+    cx[i] = x[i];
+    cy[i] = y[i];
+  }
+  for (int i = 0; i < 3; i++) {
+    c1x[i] = 3.0*(cx[i+1] - cx[i]);
+    c1y[i] = 3.0*(cy[i+1] - cy[i]);
+  }
+  for (int i = 0; i < 2; i++) {
+    c2x[i] = 2.0*(c1x[i+1] - c1x[i]);
+    c2y[i] = 2.0*(c1y[i+1] - c1y[i]);
+  }
+}
+
+inline void Cubic_Kernel::
+evalScalar(const real t, real& x, real& y) const {
+  const real s = 1.0 - t;
+  const real b0 = s*s*s, b1 = 3.0*t*s*s, b2 = 3.0*t*t*s, b3 = t*t*t;
+  x = cx[0]*b0 + cx[1]*b1 + cx[2]*b2 + cx[3]*b3;
+  y = cy[0]*b0 + cy[1]*b1 + cy[2]*b2 + cy[3]*b3;
+}
+
+inline void Cubic_Kernel::
+newtonScalar(real& t, const real px, const real py) const {
+  const real s = 1.0 - t;
+  const real b0 = s*s*s, b1 = 3.0*t*s*s, b2 = 3.0*t*t*s, b3 = t*t*t;
+  const real e0 = s*s, e1 = 2.0*t*s, e2 = t*t;
+  const real dx = cx[0]*b0 + cx[1]*b1 + cx[2]*b2 + cx[3]*b3 - px;
+  const real dy = cy[0]*b0 + cy[1]*b1 + cy[2]*b2 + cy[3]*b3 - py;
+  const real q1x = c1x[0]*e0 + c1x[1]*e1 + c1x[2]*e2;
+  const real q1y = c1y[0]*e0 + c1y[1]*e1 + c1y[2]*e2;
+  const real q2x = c2x[0]*s + c2x[1]*t;
+  const real q2y = c2y[0]*s + c2y[1]*t;
+  t -= (dx*q1x + dy*q1y)/(q1x*q1x + q1y*q1y + dx*q2x + dy*q2y);
+}
+
+#if __AVX__
+
+/* Four parameters at a time */
+#define CUBIC_KERNEL_WIDTH 4
+#define ck_vec       __m256d
+#define ck_set1      _mm256_set1_pd
+#define ck_load      _mm256_loadu_pd
+#define ck_store     _mm256_storeu_pd
+#define ck_add       _mm256_add_pd
+#define ck_sub       _mm256_sub_pd
+#define ck_mul       _mm256_mul_pd
+#define ck_div       _mm256_div_pd
+#define ck_sqrt      _mm256_sqrt_pd
+
+#elif __SSE2__
+
+/* Two parameters at a time */
+#define CUBIC_KERNEL_WIDTH 2
+#define ck_vec       __m128d
+#define ck_set1      _mm_set1_pd
+#define ck_load      _mm_loadu_pd
+#define ck_store     _mm_storeu_pd
+#define ck_add       _mm_add_pd
+#define ck_sub       _mm_sub_pd
+#define ck_mul       _mm_mul_pd
+#define ck_div       _mm_div_pd
+#define ck_sqrt      _mm_sqrt_pd
+
+#endif
+
+inline void Cubic_Kernel::
+evaluate(const int n, const real* t, real* qx, real* qy) const {
+  int i = 0;
+#ifdef CUBIC_KERNEL_WIDTH
+  const ck_vec one = ck_set1(1.0), three = ck_set1(3.0);
+  const ck_vec x0 = ck_set1(cx[0]), x1 = ck_set1(cx[1]);
+  const ck_vec x2 = ck_set1(cx[2]), x3 = ck_set1(cx[3]);
+  const ck_vec y0 = ck_set1(cy[0]), y1 = ck_set1(cy[1]);
+  const ck_vec y2 = ck_set1(cy[2]), y3 = ck_set1(cy[3]);
+  for (; i + CUBIC_KERNEL_WIDTH <= n; i += CUBIC_KERNEL_WIDTH) {
+    const ck_vec u = ck_load(t + i);
+    const ck_vec s = ck_sub(one, u);
+    const ck_vec ss = ck_mul(s, s), uu = ck_mul(u, u);
+    const ck_vec b0 = ck_mul(ss, s);
+    const ck_vec b1 = ck_mul(three, ck_mul(u, ss));
+    const ck_vec b2 = ck_mul(three, ck_mul(uu, s));
+    const ck_vec b3 = ck_mul(uu, u);
+    ck_store(qx + i, ck_add(ck_add(ck_mul(x0, b0), ck_mul(x1, b1)),
+			    ck_add(ck_mul(x2, b2), ck_mul(x3, b3))));
+    ck_store(qy + i, ck_add(ck_add(ck_mul(y0, b0), ck_mul(y1, b1)),
+			    ck_add(ck_mul(y2, b2), ck_mul(y3, b3))));
+  }
+#endif
+  for (; i < n; i++) {
+    evalScalar(t[i], qx[i], qy[i]);
+  }
+}
+
+inline void Cubic_Kernel::
+evaluateDerivatives(const int n, const real* t,
+		    real* q1x, real* q1y, real* q2x, real* q2y) const {
+  int i = 0;
+#ifdef CUBIC_KERNEL_WIDTH
+  const ck_vec one = ck_set1(1.0), two = ck_set1(2.0);
+  const ck_vec x0 = ck_set1(c1x[0]), x1 = ck_set1(c1x[1]);
+  const ck_vec x2 = ck_set1(c1x[2]);
+  const ck_vec y0 = ck_set1(c1y[0]), y1 = ck_set1(c1y[1]);
+  const ck_vec y2 = ck_set1(c1y[2]);
+  const ck_vec xx0 = ck_set1(c2x[0]), xx1 = ck_set1(c2x[1]);
+  const ck_vec yy0 = ck_set1(c2y[0]), yy1 = ck_set1(c2y[1]);
+  for (; i + CUBIC_KERNEL_WIDTH <= n; i += CUBIC_KERNEL_WIDTH) {
+    const ck_vec u = ck_load(t + i);
+    const ck_vec s = ck_sub(one, u);
+    const ck_vec e0 = ck_mul(s, s);
+    const ck_vec e1 = ck_mul(two, ck_mul(u, s));
+    const ck_vec e2 = ck_mul(u, u);
+    ck_store(q1x + i, ck_add(ck_add(ck_mul(x0, e0), ck_mul(x1, e1)),
+			     ck_mul(x2, e2)));
+    ck_store(q1y + i, ck_add(ck_add(ck_mul(y0, e0), ck_mul(y1, e1)),
+			     ck_mul(y2, e2)));
+    ck_store(q2x + i, ck_add(ck_mul(xx0, s), ck_mul(xx1, u)));
+    ck_store(q2y + i, ck_add(ck_mul(yy0, s), ck_mul(yy1, u)));
+  }
+#endif
+  for (; i < n; i++) {
+    const real s = 1.0 - t[i];
+    const real e0 = s*s, e1 = 2.0*t[i]*s, e2 = t[i]*t[i];
+    q1x[i] = c1x[0]*e0 + c1x[1]*e1 + c1x[2]*e2;
+    q1y[i] = c1y[0]*e0 + c1y[1]*e1 + c1y[2]*e2;
+    q2x[i] = c2x[0]*s + c2x[1]*t[i];
+    q2y[i] = c2y[0]*s + c2y[1]*t[i];
+  }
+}
+
+/*
+ *  evaluateDistances :
+ *  Distance of each data point (px, py) to the point of the curve
+ *  at its parameter.
+ */
+inline void Cubic_Kernel::
+evaluateDistances(const int n, const real* t,
+		  const real* px, const real* py, real* d) const {
+  int i = 0;
+#ifdef CUBIC_KERNEL_WIDTH
+  const ck_vec one = ck_set1(1.0), three = ck_set1(3.0);
+  const ck_vec x0 = ck_set1(cx[0]), x1 = ck_set1(cx[1]);
+  const ck_vec x2 = ck_set1(cx[2]), x3 = ck_set1(cx[3]);
+  const ck_vec y0 = ck_set1(cy[0]), y1 = ck_set1(cy[1]);
+  const ck_vec y2 = ck_set1(cy[2]), y3 = ck_set1(cy[3]);
+  for (; i + CUBIC_KERNEL_WIDTH <= n; i += CUBIC_KERNEL_WIDTH) {
+    const ck_vec u = ck_load(t + i);
+    const ck_vec s = ck_sub(one, u);
+    const ck_vec ss = ck_mul(s, s), uu = ck_mul(u, u);
+    const ck_vec b0 = ck_mul(ss, s);
+    const ck_vec b1 = ck_mul(three, ck_mul(u, ss));
+    const ck_vec b2 = ck_mul(three, ck_mul(uu, s));
+    const ck_vec b3 = ck_mul(uu, u);
+    const ck_vec dx =
+      ck_sub(ck_add(ck_add(ck_mul(x0, b0), ck_mul(x1, b1)),
+		    ck_add(ck_mul(x2, b2), ck_mul(x3, b3))), ck_load(px + i));
+    const ck_vec dy =
+      ck_sub(ck_add(ck_add(ck_mul(y0, b0), ck_mul(y1, b1)),
+		    ck_add(ck_mul(y2, b2), ck_mul(y3, b3))), ck_load(py + i));
+    ck_store(d + i, ck_sqrt(ck_add(ck_mul(dx, dx), ck_mul(dy, dy))));
+  }
+#endif
+  for (; i < n; i++) {
+    real x, y;
+    evalScalar(t[i], x, y);
+    x -= px[i];
+    y -= py[i];
+    d[i] = sqrt(x*x + y*y);
+  }
+}
+
+/*
+ *  newtonStep :
+ *  One Newton-Raphson step per parameter, towards the point of the curve
+ *  closest to the corresponding data point (see Schneider's reparameterize).
+ */
+inline void Cubic_Kernel::
+newtonStep(const int n, real* t, const real* px, const real* py) const {
+  int i = 0;
+#ifdef CUBIC_KERNEL_WIDTH
+  const ck_vec one = ck_set1(1.0), two = ck_set1(2.0), three = ck_set1(3.0);
+  const ck_vec x0 = ck_set1(cx[0]), x1 = ck_set1(cx[1]);
+  const ck_vec x2 = ck_set1(cx[2]), x3 = ck_set1(cx[3]);
+  const ck_vec y0 = ck_set1(cy[0]), y1 = ck_set1(cy[1]);
+  const ck_vec y2 = ck_set1(cy[2]), y3 = ck_set1(cy[3]);
+  const ck_vec dx0 = ck_set1(c1x[0]), dx1 = ck_set1(c1x[1]);
+  const ck_vec dx2 = ck_set1(c1x[2]);
+  const ck_vec dy0 = ck_set1(c1y[0]), dy1 = ck_set1(c1y[1]);
+  const ck_vec dy2 = ck_set1(c1y[2]);
+  const ck_vec ddx0 = ck_set1(c2x[0]), ddx1 = ck_set1(c2x[1]);
+  const ck_vec ddy0 = ck_set1(c2y[0]), ddy1 = ck_set1(c2y[1]);
+  for (; i + CUBIC_KERNEL_WIDTH <= n; i += CUBIC_KERNEL_WIDTH) {
+    const ck_vec u = ck_load(t + i);
+    const ck_vec s = ck_sub(one, u);
+    const ck_vec ss = ck_mul(s, s), uu = ck_mul(u, u), us = ck_mul(u, s);
+    const ck_vec b0 = ck_mul(ss, s);
+    const ck_vec b1 = ck_mul(three, ck_mul(u, ss));
+    const ck_vec b2 = ck_mul(three, ck_mul(uu, s));
+    const ck_vec b3 = ck_mul(uu, u);
+    const ck_vec e1 = ck_mul(two, us);
+    const ck_vec dx =
+      ck_sub(ck_add(ck_add(ck_mul(x0, b0), ck_mul(x1, b1)),
+		    ck_add(ck_mul(x2, b2), ck_mul(x3, b3))), ck_load(px + i));
+    const ck_vec dy =
+      ck_sub(ck_add(ck_add(ck_mul(y0, b0), ck_mul(y1, b1)),
+		    ck_add(ck_mul(y2, b2), ck_mul(y3, b3))), ck_load(py + i));
+    const ck_vec q1x = ck_add(ck_add(ck_mul(dx0, ss), ck_mul(dx1, e1)),
+			      ck_mul(dx2, uu));
+    const ck_vec q1y = ck_add(ck_add(ck_mul(dy0, ss), ck_mul(dy1, e1)),
+			      ck_mul(dy2, uu));
+    const ck_vec q2x = ck_add(ck_mul(ddx0, s), ck_mul(ddx1, u));
+    const ck_vec q2y = ck_add(ck_mul(ddy0, s), ck_mul(ddy1, u));
+    const ck_vec num = ck_add(ck_mul(dx, q1x), ck_mul(dy, q1y));
+    const ck_vec den = ck_add(ck_add(ck_mul(q1x, q1x), ck_mul(q1y, q1y)),
+			      ck_add(ck_mul(dx, q2x), ck_mul(dy, q2y)));
+    ck_store(t + i, ck_sub(u, ck_div(num, den)));
+  }
+#endif
+  for (; i < n; i++) {
+    newtonScalar(t[i], px[i], py[i]);
+  }
+}
+
+#ifdef CUBIC_KERNEL_WIDTH
+#undef ck_vec
+#undef ck_set1
+#undef ck_load
+#undef ck_store
+#undef ck_add
+#undef ck_sub
+#undef ck_mul
+#undef ck_div
+#undef ck_sqrt
+#endif
+
+#endif // CUBIC_KERNEL_H
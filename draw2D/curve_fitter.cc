@@ -0,0 +1,329 @@
+#include "curve_fitter.h"
+
+using namespace std;
+
+/*
+ *  All these functions use indices into the points array, which is never
+ *  modified: parameter values are kept in the workspace (u), not in the
+ *  points themselves.
+ */
+
+/*
+ *  fitCubic :
+ *  Fit a Bezier curve to a (sub)set of digitized points
+ */
+void Curve_Fitter::fitCubic(const points& pts, const Span& s,
+			    const real error, beziers& bs) {
+  /* Number of points in subset */
+  const int npoints = s.last - s.first + 1;
+
+  /*  Use heuristic if region only has two points in it */
+  if (npoints == 2) {
+    real d = dist(pts[s.last].pos, pts[s.first].pos)/3.0;
+    W[0] = pts[s.first].pos;
+    W[3] = pts[s.last].pos;
+    W[1] = W[0] + s.tanv1*d;
+    W[2] = W[3] + s.tanv2*d;
+    emit(s, bs);
+    return;
+  }
+
+  /* Parameterize points, and attempt to fit curve */
+  chordLengthParameterize(pts, s.first, s.last);
+  generateBezier(pts, s);
+
+  /*  Find max deviation of points to fitted curve */
+  real maxError; /* Maximum fitting error */
+  int split;     /* Point to split point set at */
+  computeMaxError(s.first, s.last, split, maxError);
+  if (maxError < error) {
+    emit(s, bs);
+    return;
+  }
+
+  /* If error not too large, try some reparameterization */
+  /* and iteration */
+  real iterationError = error*error; /* Error below which you try iterating */
+  int maxIterations = 4;             /* Max times to try iterating */
+  if (maxError < iterationError) {
+    for (int i = 0; i < maxIterations; i++) {
+      reparameterize(s.first, s.last);
+      generateBezier(pts, s);
+      computeMaxError(s.first, s.last, split, maxError);
+      if (maxError < error) {
+	emit(s, bs);
+	return;
+      }
+    }
+  }
+
+  /* Fitting failed -- split at max error point and fit both halves, */
+  /* left one first (pushed last) */
+  vec2 tanv_center(centerTangent(pts, split)); /* Unit tangent vector */
+                                               /* at split point */
+  if (stack.size() + 2 > stack.capacity()) {
+    stack.reserve(2*stack.capacity() + 16);
+    nallocs++;
+  }
+  stack.push_back(Span(split, s.last, -tanv_center, s.tanv2));
+  stack.push_back(Span(s.first, split, s.tanv1, tanv_center));
+}
+
+/*
+ *  generateBezier :
+ *  Use least-squares method to find Bezier control points for region.
+ */
+void Curve_Fitter::generateBezier(const points& pts, const Span& s) {
+  const int first = s.first;
+  const int last  = s.last;
+  const vec2& tanv1 = s.tanv1;
+  const vec2& tanv2 = s.tanv2;
+
+  /* Compute the A's */
+  int p;
+  for (p = first; p <= last; p++) {
+    real t = u[p - offset];
+    A1[p - offset] = tanv1*bezier::B31(t);
+    A2[p - offset] = tanv2*bezier::B32(t);
+  }
+
+  /* Create the C and X matrices */
+  real C[2][2];
+  real X[2];
+
+  C[0][0] = 0.0; C[0][1] = 0.0;
+  C[1][0] = 0.0; C[1][1] = 0.0;
+
+  X[0] = 0.0;
+  X[1] = 0.0;
+
+  const vec2& first_pos = pts[first].pos;
+  const vec2& last_pos  = pts[last].pos;
+  for (p = first; p <= last; p++) {
+    const vec2& a1 = A1[p - offset];
+    const vec2& a2 = A2[p - offset];
+    C[0][0] += dot(a1, a1);
+    C[0][1] += dot(a1, a2);
+    C[1][0] = C[0][1];
+    C[1][1] += dot(a2, a2);
+
+    real t = u[p - offset];
+    vec2 tmp = pts[p].pos
+               - (first_pos*bezier::B30(t) + first_pos*bezier::B31(t) +
+		  last_pos*bezier::B32(t) + last_pos*bezier::B33(t));
+
+    X[0] += dot(a1, tmp);
+    X[1] += dot(a2, tmp);
+  }
+
+  /* Compute the determinants of C and X */
+  real det_C0_C1, det_C0_X, det_X_C1; /* Determinants of matrices */
+
+  det_C0_C1 = C[0][0] * C[1][1] - C[1][0] * C[0][1];
+  det_C0_X  = C[0][0] * X[1]    - C[0][1] * X[0];
+  det_X_C1  = X[0]    * C[1][1] - X[1]    * C[0][1];
+
+  /* Finally, derive alpha values */
+
+  /* Handle near zero determinants. */
+  if (det_C0_C1 < 1.0e-3) {
+#if DEBUG
+    cerr << "Warning: Near zero determinant! Det = " << det_C0_C1 << endl;
+#endif
+    real d = dist(last_pos, first_pos)/3.0;
+    W[0] = first_pos;
+    W[3] = last_pos;
+    W[1] = W[0] + tanv1*d;
+    W[2] = W[3] + tanv2*d;
+    return;
+  }
+  real alpha_l, alpha_r; /* Alpha values, left and right */
+  alpha_l = det_X_C1 / det_C0_C1;
+  alpha_r = det_C0_X / det_C0_C1;
+
+  /* If alpha negative, use the Schmitt et al. heuristic (see text) */
+  /* (if alpha is 0, you get coincident control points that lead to */
+  /* divide by zero in any subsequent findNewtonRaphsonRoot() call. */
+  if (alpha_l < 1.0e-6 || alpha_r < 1.0e-6) {
+    real d = dist(last_pos, first_pos)/3.0;
+    W[0] = first_pos;
+    W[3] = last_pos;
+    W[1] = W[0] + tanv1*d;
+    W[2] = W[3] + tanv2*d;
+    return;
+  }
+
+  /* First and last control points of the Bezier curve are */
+  /* positioned exactly at the first and last data points. */
+  /* Control points 1 and 2 are positioned an alpha distance out */
+  /* on the tangent vectors, left and right, respectively. */
+  W[0] = first_pos;
+  W[3] = last_pos;
+  W[1] = W[0] + tanv1*alpha_l;
+  W[2] = W[3] + tanv2*alpha_r;
+}
+
+/*
+ *  computeMaxError :
+ *  Find the maximum distance of digitized points to fitted curve.
+ */
+void Curve_Fitter::computeMaxError(const int first, const int last,
+				   int& split, real& maxError) {
+  split = first + static_cast<int>(0.5*(last - first + 1));
+
+  /* Distances of the inner points, in one batch */
+  const int i_first = first + 1 - offset;
+  setKernel();
+  kernel.evaluateDistances(last - first - 1, &u[i_first],
+			   &px[i_first], &py[i_first], &errors[i_first]);
+
+  real maxDistance = 0.0; /* Maximum distance */
+  for (int p = first+1; p != last; p++) {
+    real distance = errors[p - offset]; /* Current error */
+    if (distance > maxDistance) {
+      maxDistance = distance;
+      split = p;
+    }
+  }
+  maxError = maxDistance;
+}
+
+/*
+ *  leftTangent, rightTangent, centerTangent :
+ *  Approximate unit tangents at endpoints and "center" of digitized curve
+ *  by fitting a least-square line to the points in the neighborhood of the end
+ *  points or by averaging vectors from the endpoints to the next n points.
+ */
+Curve_Fitter::vec2 Curve_Fitter::leftTangent(const points& pts,
+					     const int first,
+					     const int npoints) {
+  if (npoints < 10) { // 5 is the minimum!
+    return (pts[first+1].pos - pts[first].pos).normalize();
+  }
+  else {
+    return (0.5*(pts[first+2].pos + pts[first+1].pos - 2.0*pts[first].pos))
+      .normalize();
+  }
+}
+Curve_Fitter::vec2 Curve_Fitter::rightTangent(const points& pts,
+					      const int last,
+					      const int npoints) {
+  if (npoints < 10) { // 5 is the minimum!
+    return (pts[last-1].pos - pts[last].pos).normalize();
+  }
+  else {
+    return (0.5*(pts[last-2].pos + pts[last-1].pos - 2.0*pts[last].pos))
+      .normalize();
+  }
+}
+Curve_Fitter::vec2 Curve_Fitter::centerTangent(const points& pts,
+					       const int split) {
+  return (pts[split-1].pos - pts[split+1].pos).normalize();
+}
+
+/*
+ *  chordLengthParameterize :
+ *  Assign parameter values to digitized points
+ *  using relative distances between points.
+ */
+void Curve_Fitter::chordLengthParameterize(const points& pts,
+					   const int first, const int last) {
+  real* t = &u[0] - offset;
+  t[first] = 0.0;
+  int p;
+  for (p = first+1; p <= last; p++) {
+    t[p] = t[p-1] + dist(pts[p].pos, pts[p-1].pos);
+  }
+  real u_last = t[last];
+  for (p = first+1; p != last; p++) {
+    t[p] /= u_last;
+  }
+  t[last] = 1.0;
+}
+
+/*
+ *  reparameterize :
+ *  Given set of points and their parameterization, try to find
+ *  a better parameterization (one Newton-Raphson step per point).
+ */
+void Curve_Fitter::reparameterize(const int first, const int last) {
+  const int i_first = first - offset;
+  setKernel();
+  kernel.newtonStep(last - first + 1, &u[i_first], &px[i_first], &py[i_first]);
+}
+
+/*
+ *  setKernel :
+ *  Load the current cubic into the batch evaluation kernel.
+ */
+void Curve_Fitter::setKernel() {
+  real x[4], y[4];
+  for (int i = 0; i < 4; i++) {
+    x[i] = W[i].x();
+    y[i] = W[i].y();
+  }
+  kernel.setControlPoints(x, y);
+}
+
+/*
+ *  emit :
+ *  Append the current cubic, fitted to region s, to the fitted curves.
+ */
+void Curve_Fitter::emit(const Span& s, beziers& bs) {
+  emitted_first = s.first;
+  bs.push_back(bezier(3));
+  bezier& b = bs.back();
+  b.V[0] = W[0]; b.V[1] = W[1]; b.V[2] = W[2]; b.V[3] = W[3];
+}
+
+Curve_Fitter::Curve_Fitter()
+  : offset(0), emitted_first(0), nallocs(0) {}
+
+void Curve_Fitter::reserve(const int npoints) {
+  grow(u, npoints);
+  grow(A1, npoints);
+  grow(A2, npoints);
+  grow(errors, npoints);
+  grow(px, npoints);
+  grow(py, npoints);
+}
+
+/*
+ *  fitCurve :
+ *  Fit a Bezier curve to a set of digitized points
+ */
+void Curve_Fitter::fitCurve(const points& pts, const int first,
+			    const int last, const real error, beziers& bs) {
+  fitCurve(pts, first, last, leftTangent(pts, first, last - first + 1),
+	   error, bs);
+}
+
+/*
+ *  fitCurve :
+ *  Same as above, with a given unit tangent vector at the first point
+ *  (for a G1 continuation of a previously fitted curve).
+ */
+void Curve_Fitter::fitCurve(const points& pts, const int first,
+			    const int last, const vec2& tanv1,
+			    const real error, beziers& bs) {
+  /* Number of points in subset */
+  const int npoints = last - first + 1;
+  reserve(npoints);
+  offset = first;
+
+  /* Coordinates of the points, as expected by the kernel */
+  for (int p = first; p <= last; p++) {
+    px[p - offset] = pts[p].pos.x();
+    py[p - offset] = pts[p].pos.y();
+  }
+
+  /* Unit tangent vectors at endpoints */
+  stack.clear();
+  fitCubic(pts, Span(first, last, tanv1, rightTangent(pts, last, npoints)),
+	   error, bs);
+  while (!stack.empty()) {
+    const Span s = stack.back();
+    stack.pop_back();
+    fitCubic(pts, s, error, bs);
+  }
+}
@@ -0,0 +1,151 @@
+#include <cmath>
+#include "decimator.h"
+
+using namespace std;
+
+Decimator::Decimator(const int m, const real tol)
+  : mode(m), tolerance(tol), nin(0), nout(0) {}
+
+void Decimator::setMode(const int m, const real tol) {
+  mode = m;
+  tolerance = tol;
+}
+
+void Decimator::reset() {
+  nin = 0;
+  nout = 0;
+}
+
+/*
+ *  decimate :
+ *  Append to out what is kept of points first+1 to last of in, point first
+ *  being the last point of out already.
+ */
+void Decimator::decimate(const points& in, const int first, const int last,
+			 points& out) {
+  if (last <= first) {
+    return;
+  }
+  const int nout_prev = out.size();
+  switch (mode) {
+  case RDP:
+    rdp(in, first, last, out);
+    break;
+  case ARC_LENGTH:
+    resample(in, first, last, out);
+    break;
+  case CURVATURE:
+    curvature(in, first, last, out);
+    break;
+  default:
+    out.insert(out.end(), in.begin() + first + 1, in.begin() + last + 1);
+    break;
+  }
+  nin += last - first;
+  nout += out.size() - nout_prev;
+}
+
+/*
+ *  rdp :
+ *  Ramer-Douglas-Peucker, with an explicit stack of regions.
+ */
+void Decimator::rdp(const points& in, const int first, const int last,
+		    points& out) {
+  const real tol2 = tolerance*tolerance;
+  keep.assign(last - first + 1, 0);
+  keep[0] = 1;
+  keep[last - first] = 1;
+  stack.clear();
+  stack.push_back(first);
+  stack.push_back(last);
+  while (!stack.empty()) {
+    const int j = stack.back(); stack.pop_back();
+    const int i = stack.back(); stack.pop_back();
+    const vec2& a = in[i].pos;
+    const vec2 ab = in[j].pos - a;
+    const real ab2 = ab.sqnorm();
+    real d2_max = 0.0;
+    int k_max = -1;
+    for (int k = i+1; k < j; k++) {
+      const vec2 ak = in[k].pos - a;
+      real d2;
+      if (ab2 > 0.0) {
+	const real c = ab.x()*ak.y() - ab.y()*ak.x();
+	d2 = c*c/ab2;
+      }
+      else {
+	d2 = ak.sqnorm();
+      }
+      if (d2 > d2_max) {
+	d2_max = d2;
+	k_max = k;
+      }
+    }
+    if (d2_max > tol2) {
+      keep[k_max - first] = 1;
+      stack.push_back(i);
+      stack.push_back(k_max);
+      stack.push_back(k_max);
+      stack.push_back(j);
+    }
+  }
+  for (int p = first+1; p <= last; p++) {
+    if (keep[p - first]) {
+      out.push_back(in[p]);
+    }
+  }
+}
+
+/*
+ *  resample :
+ *  Points every tolerance pixels along the input polyline, plus its last
+ *  point.
+ */
+void Decimator::resample(const points& in, const int first, const int last,
+			 points& out) {
+  real s = tolerance; // Arc length left before the next sample
+  for (int p = first; p < last; p++) {
+    const vec2& a = in[p].pos;
+    const vec2 ab = in[p+1].pos - a;
+    const real l = ab.norm();
+    real s_seg = 0.0;   // Arc length used on this segment
+    while (l - s_seg >= s) {
+      s_seg += s;
+      out.push_back(point(a + ab*(s_seg/l)));
+      s = tolerance;
+    }
+    s -= l - s_seg;
+  }
+  /* Do not leave a sample too close to the last point */
+  if (out.size() > 1 && s > 0.5*tolerance &&
+      dist(out.back().pos, in[last].pos) < 0.5*tolerance) {
+    out.pop_back();
+  }
+  out.push_back(in[last]);
+}
+
+/*
+ *  curvature :
+ *  Keep a point when the arc from the last kept point to the next one
+ *  would deviate by more than tolerance from its chord (sagitta of an arc
+ *  of length l turning by an angle a: about l*a/8).
+ */
+void Decimator::curvature(const points& in, const int first, const int last,
+			  points& out) {
+  real l = 0.0; // Arc length since the last kept point
+  real a = 0.0; // Turning angle since the last kept point
+  for (int p = first+1; p < last; p++) {
+    const vec2 u = in[p].pos - in[p-1].pos;
+    const vec2 v = in[p+1].pos - in[p].pos;
+    const real cos_a = cosAng(u, v);
+    const real turn = acos(cos_a > 1.0 ? 1.0 : (cos_a < -1.0 ? -1.0 : cos_a));
+    l += u.norm();
+    a += turn;
+    if ((l + v.norm())*a > 8.0*tolerance) {
+      out.push_back(in[p]);
+      l = 0.0;
+      a = 0.0;
+    }
+  }
+  out.push_back(in[last]);
+}
@@ -5,7 +5,7 @@
 TEMPLATE	= app.t
 CONFIG		= opengl debug
 DEFINES		= TEST_STROKE2D
-LIBS		+= -lglut
+LIBS		+= -lglut -lpthread
 #
-SOURCES     = input.cc stroke2D.cc drawing.C draw.C opengl_utils.cc
+SOURCES     = input.cc stroke2D.cc curve_fitter.cc stream_fitter.cc decimator.cc parallel_fitter.cc thread_pool.cc drawing.C draw.C opengl_utils.cc unprojector.cc
 TARGET      = draw
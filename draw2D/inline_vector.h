@@ -0,0 +1,190 @@
+#ifndef INLINE_VECTOR_H
+#define INLINE_VECTOR_H
+
+#include <cassert>
+#include <cstddef>
+
+/*
+ *  Subset of std::vector holding at most N elements, stored inline rather
+ *  than on the heap. Used for the data of fixed-degree Bezier curves.
+ */
+template < class T, int N >
+class Inline_Vector {
+public:
+  typedef T           value_type;
+  typedef T*          iterator;
+  typedef const T*    const_iterator;
+  typedef T&          reference;
+  typedef const T&    const_reference;
+  typedef std::size_t size_type;
+
+  Inline_Vector();
+  explicit Inline_Vector(const size_type n);
+
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+  size_type size() const;
+  size_type capacity() const;
+  bool empty() const;
+  reference operator[](const size_type i);
+  const_reference operator[](const size_type i) const;
+  reference front();
+  reference back();
+  const_reference front() const;
+  const_reference back() const;
+  void push_back(const T& x);
+  void pop_back();
+  void resize(const size_type n);
+  void clear();
+  template <class InputIterator>
+  void assign(InputIterator first, InputIterator last);
+
+private:
+  T a[N];
+  size_type n;
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+template <class T, int N>
+inline Inline_Vector<T, N>::
+Inline_Vector()
+  : n(0) {}
+
+template <class T, int N>
+inline Inline_Vector<T, N>::
+Inline_Vector(const size_type m)
+  : n(m) {
+  assert(m <= N);
+  for (size_type i = 0; i < m; i++) {
+    a[i] = T();
+  }
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::iterator Inline_Vector<T, N>::
+begin() {
+  return a;
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::iterator Inline_Vector<T, N>::
+end() {
+  return a + n;
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::const_iterator Inline_Vector<T, N>::
+begin() const {
+  return a;
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::const_iterator Inline_Vector<T, N>::
+end() const {
+  return a + n;
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::size_type Inline_Vector<T, N>::
+size() const {
+  return n;
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::size_type Inline_Vector<T, N>::
+capacity() const {
+  return N;
+}
+
+template <class T, int N>
+inline bool Inline_Vector<T, N>::
+empty() const {
+  return n == 0;
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::reference Inline_Vector<T, N>::
+operator[](const size_type i) {
+  return a[i];
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::const_reference Inline_Vector<T, N>::
+operator[](const size_type i) const {
+  return a[i];
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::reference Inline_Vector<T, N>::
+front() {
+  return a[0];
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::reference Inline_Vector<T, N>::
+back() {
+  return a[n-1];
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::const_reference Inline_Vector<T, N>::
+front() const {
+  return a[0];
+}
+
+template <class T, int N>
+inline typename Inline_Vector<T, N>::const_reference Inline_Vector<T, N>::
+back() const {
+  return a[n-1];
+}
+
+template <class T, int N>
+inline void Inline_Vector<T, N>::
+push_back(const T& x) {
+  assert(n < N);
+  a[n++] = x;
+}
+
+template <class T, int N>
+inline void Inline_Vector<T, N>::
+pop_back() {
+  assert(n > 0);
+  n--;
+}
+
+template <class T, int N>
+inline void Inline_Vector<T, N>::
+resize(const size_type m) {
+  assert(m <= N);
+  for (size_type i = n; i < m; i++) {
+    a[i] = T();
+  }
+  n = m;
+}
+
+template <class T, int N>
+inline void Inline_Vector<T, N>::
+clear() {
+  n = 0;
+}
+
+/*
+ *  assign :
+ *  Copy of [first; last), converting elements of another type if need be.
+ */
+template <class T, int N>
+template <class InputIterator>
+inline void Inline_Vector<T, N>::
+assign(InputIterator first, InputIterator last) {
+  for (n = 0; first != last; ++first) {
+    assert(n < N);
+    a[n++] = T(*first);
+  }
+}
+
+#endif // INLINE_VECTOR_H
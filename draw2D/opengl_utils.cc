@@ -156,6 +156,13 @@ writeViewVector(const GLdouble mv_matrix[16], Vec3<GLdouble>& view) {
   view.setz(O_transf[2] - z_transf[2]);
 }
 
+void
+writeViewVector(const GLdouble mv_matrix[16], Vec3<GLfloat>& view) {
+  Vec3<GLdouble> view_d;
+  writeViewVector(mv_matrix, view_d);
+  view = Vec3<GLfloat>(view_d.x(), view_d.y(), view_d.z());
+}
+
 void
 writeCenterOfProjection(const GLdouble mv_matrix[16], Vec3<GLdouble>& center) {
   GLdouble mv_matrix_inv[16];
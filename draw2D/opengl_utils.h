@@ -16,6 +16,8 @@ void printM(const GLdouble m[16]);
 void printV(const GLdouble v[4]);
 void writeViewVector(const GLdouble mv_matrix[16],
 		     Vec3<GLdouble>& view);
+void writeViewVector(const GLdouble mv_matrix[16],
+		     Vec3<GLfloat>& view);
 void writeCenterOfProjection(const GLdouble mv_matrix[16],
 			     Vec3<GLdouble>& center);
 
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include "parallel_fitter.h"
+
+using namespace std;
+
+/* Sort span indices by decreasing number of points */
+class Longer_Span {
+public:
+  Longer_Span(const std::vector<int>& e) : ends(e) {}
+  bool operator()(const int i, const int j) const {
+    return ends[i+1] - ends[i] > ends[j+1] - ends[j];
+  }
+
+  const std::vector<int>& ends;
+};
+
+Parallel_Fitter::Parallel_Fitter()
+  : fitters(1), pts(0), ends(0), error(0.0) {}
+
+/*
+ *  setThreads :
+ *  Use n workers (including the calling thread), or as many as there are
+ *  processors if n is 0.
+ */
+void Parallel_Fitter::setThreads(const int n) {
+  const int nworkers = n > 0 ? n : Thread_Pool::processors();
+  pool.start(nworkers);
+  fitters.resize(pool.size());
+}
+
+/*
+ *  fitSpans :
+ *  Fit spans [e[i]; e[i+1]] of the points p, and append the cubics to bs.
+ */
+void Parallel_Fitter::fitSpans(const points& p, const std::vector<int>& e,
+			       const real err, beziers& bs) {
+  const int nspans = e.size() - 1;
+  if (nspans < 2 || pool.size() < 2) {
+    for (int i = 0; i < nspans; i++) {
+      fitters[0].fitCurve(p, e[i], e[i+1], err, bs);
+    }
+    return;
+  }
+
+  pts = &p;
+  ends = &e;
+  error = err;
+  if (static_cast<int>(outs.size()) < nspans) {
+    outs.resize(nspans);
+  }
+  order.resize(nspans);
+  int i;
+  for (i = 0; i < nspans; i++) {
+    outs[i].clear();
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), Longer_Span(e));
+
+  pool.run(*this, nspans);
+
+  /* Splice, in span order */
+  for (i = 0; i < nspans; i++) {
+    bs.insert(bs.end(), outs[i].begin(), outs[i].end());
+  }
+}
+
+void Parallel_Fitter::run(const int index, const int worker) {
+  const int i = order[index];
+  fitters[worker].fitCurve(*pts, (*ends)[i], (*ends)[i+1], error, outs[i]);
+}
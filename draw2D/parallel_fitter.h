@@ -0,0 +1,59 @@
+#ifndef PARALLEL_FITTER_H
+#define PARALLEL_FITTER_H
+
+#include "curve_fitter.h"
+#include "thread_pool.h"
+
+/*
+ *  Fits the corner-delimited spans of a stroke concurrently, one
+ *  Curve_Fitter workspace per worker, each span into its own buffer.
+ *  The buffers are then spliced in span order, so the result is the
+ *  same as fitting the spans one after the other.
+ */
+class Parallel_Fitter : private Thread_Pool::Task {
+public:
+  typedef Curve_Fitter::real    real;
+  typedef Curve_Fitter::points  points;
+  typedef Curve_Fitter::beziers beziers;
+
+private:
+  void run(const int index, const int worker);
+
+  Thread_Pool pool;
+  std::vector<Curve_Fitter> fitters; // One per worker
+  std::vector<beziers> outs;         // One per span
+  std::vector<int> order;            // Spans, longest first
+
+  /* Current job */
+  const points* pts;
+  const std::vector<int>* ends;
+  real error;
+
+public:
+  Parallel_Fitter();
+  void setThreads(const int n);
+  int threads() const;
+  long allocations() const;
+  void fitSpans(const points& p, const std::vector<int>& e, const real err,
+		beziers& bs);
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+inline int Parallel_Fitter::
+threads() const {
+  return pool.size();
+}
+
+inline long Parallel_Fitter::
+allocations() const {
+  long n = 0;
+  for (unsigned int i = 0; i < fitters.size(); i++) {
+    n += fitters[i].allocations();
+  }
+  return n;
+}
+
+#endif // PARALLEL_FITTER_H
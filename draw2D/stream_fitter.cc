@@ -0,0 +1,150 @@
+#include "stream_fitter.h"
+
+using namespace std;
+
+const int Stream_Fitter::chunk = 32; // Magic number!
+
+Stream_Fitter::Stream_Fitter(const real err, const int win)
+  : error(err), window(win), first(0), next(1), continued(false),
+    decimator(0), decimated(0) {
+  const int n = 10; // Magic number!
+  committed.reserve(n);
+  tail.reserve(n);
+  fitter.reserve(2*window);
+  kept.reserve(2*window);
+}
+
+void Stream_Fitter::clear() {
+  committed.clear();
+  kept.clear();
+  first = 0;
+  next = 1;
+  continued = false;
+  decimated = 0;
+}
+
+/*
+ *  fitTail :
+ *  Fit the points of the open tail up to last, starting with the tangent
+ *  of the previous cubic when the tail does not begin at a corner.
+ */
+void Stream_Fitter::fitTail(const points& pts, const int last, beziers& bs) {
+  if (continued) {
+    fitter.fitCurve(pts, first, last, tanv1, error, bs);
+  }
+  else {
+    fitter.fitCurve(pts, first, last, error, bs);
+  }
+}
+
+/*
+ *  commitTail :
+ *  Commit all the cubics of the open tail but the last one, which may still
+ *  change with the next points. If the whole tail is a single cubic, commit
+ *  a fit of its first half instead, so that it cannot grow forever.
+ */
+void Stream_Fitter::commitTail(const points& pts) {
+  tail.clear();
+  fitTail(pts, static_cast<int>(pts.size()) - 1, tail);
+  int last_first = fitter.lastCubicFirst();
+  const int ncommitted = committed.size();
+  if (tail.size() > 1) {
+    committed.insert(committed.end(), tail.begin(), tail.end() - 1);
+  }
+  else {
+    last_first = first + window/2;
+    fitTail(pts, last_first, committed);
+  }
+  measure(ncommitted);
+  const bezier& b = committed.back();
+  tanv1 = b.V[3] - b.V[2];
+  tanv1.normalize();
+  continued = true;
+  first = last_first;
+}
+
+/*
+ *  measure :
+ *  Arc lengths of the cubics committed from index n, computed now rather
+ *  than at pen up (Stroke2D::evalLength keeps them).
+ */
+void Stream_Fitter::measure(const int n) {
+  for (beziers::iterator b = committed.begin() + n; b != committed.end();
+       b++) {
+    (*b).evalArcLength();
+  }
+}
+
+/*
+ *  decimate :
+ *  Pass the input points to the decimator, by whole chunks unless all is
+ *  set, and return the points to be fitted.
+ */
+const Stream_Fitter::points&
+Stream_Fitter::decimate(const points& pts, const bool all) {
+  if (decimator == 0 || pts.empty()) {
+    return pts;
+  }
+  if (kept.empty()) {
+    kept.push_back(pts.front());
+    decimated = 0;
+  }
+  const int last = static_cast<int>(pts.size()) - 1;
+  while (last - decimated >= chunk) {
+    decimator->decimate(pts, decimated, decimated + chunk, kept);
+    decimated += chunk;
+  }
+  if (all && last > decimated) {
+    decimator->decimate(pts, decimated, last, kept);
+    decimated = last;
+  }
+  return kept;
+}
+
+/*
+ *  update :
+ *  Process the points added since the last call.
+ */
+void Stream_Fitter::update(const points& pts) {
+  process(decimate(pts, false));
+}
+
+/*
+ *  process :
+ *  Fit the points to be fitted, as far as they are known for sure.
+ */
+void Stream_Fitter::process(const points& pts) {
+  const int last = static_cast<int>(pts.size()) - 1;
+
+  /* Locate corners, as Stroke2D::fit does */
+  for (; next < last; next++) {
+    const int p = next;
+    real cos_a = cosAng(pts[p+1].pos - pts[p].pos, pts[p-1].pos - pts[p].pos);
+    if (cos_a > 0.0) {
+      const int ncommitted = committed.size();
+      fitTail(pts, p, committed);
+      measure(ncommitted);
+      first = p;
+      continued = false;
+    }
+  }
+
+  /* Bound the open tail */
+  while (last - first + 1 > window) {
+    commitTail(pts);
+  }
+}
+
+/*
+ *  finish :
+ *  Fit what remains at pen up, and append the whole curve to bs.
+ */
+void Stream_Fitter::finish(const points& pts, beziers& bs) {
+  const points& fpts = decimate(pts, true);
+  process(fpts);
+  bs.insert(bs.end(), committed.begin(), committed.end());
+  if (static_cast<int>(fpts.size()) - first > 1) {
+    fitTail(fpts, static_cast<int>(fpts.size()) - 1, bs);
+  }
+  clear();
+}
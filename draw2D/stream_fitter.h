@@ -0,0 +1,74 @@
+#ifndef STREAM_FITTER_H
+#define STREAM_FITTER_H
+
+#include "curve_fitter.h"
+#include "decimator.h"
+
+/*
+ *  Progressive version of Stroke2D::fit, fed while the pen is down.
+ *  Cubics ending at a corner, or lying well before the last input point,
+ *  are committed as soon as they are known, so that only the open tail of
+ *  the stroke (at most window samples) remains to be fitted at pen up.
+ *  A tail cut away from a corner is continued with the same unit tangent,
+ *  so the curve stays G1 there, as it does at the splits of fitCurve.
+ *  With a decimator, the input points are decimated by chunks of about
+ *  chunk samples, and the fit follows the points kept.
+ */
+class Stream_Fitter {
+public:
+  typedef Curve_Fitter::real    real;
+  typedef Curve_Fitter::vec2    vec2;
+  typedef Curve_Fitter::points  points;
+  typedef Curve_Fitter::bezier  bezier;
+  typedef Curve_Fitter::beziers beziers;
+
+private:
+  void fitTail(const points& pts, const int last, beziers& bs);
+  void commitTail(const points& pts);
+  void measure(const int n);
+  const points& decimate(const points& pts, const bool all);
+  void process(const points& pts);
+
+  Curve_Fitter fitter;
+  beziers committed; // Cubics already fitted
+  beziers tail;      // Scratch fit of the open tail
+  real error;
+  int window;        // Maximum number of samples left open
+  int first;         // Index of the first point of the open tail
+  int next;          // Next point to be tested for a corner
+  bool continued;    // Tail starts with a given tangent (not a corner)
+  vec2 tanv1;        // Unit tangent vector at its first point
+  Decimator* decimator;
+  points kept;       // Points kept by the decimator
+  int decimated;     // Index of the last input point decimated
+  
+  static const int chunk;
+
+public:
+  Stream_Fitter(const real err = 4.0, const int win = 64);
+  void clear();
+  void setDecimator(Decimator* dec);
+  void update(const points& pts);
+  void finish(const points& pts, beziers& bs);
+  int pending(const points& pts) const;
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+inline int Stream_Fitter::
+pending(const points& pts) const {
+  if (decimator != 0 && !kept.empty()) {
+    return static_cast<int>(kept.size()) - first +
+      static_cast<int>(pts.size()) - 1 - decimated;
+  }
+  return static_cast<int>(pts.size()) - first;
+}
+
+inline void Stream_Fitter::
+setDecimator(Decimator* dec) {
+  decimator = dec;
+}
+
+#endif // STREAM_FITTER_H
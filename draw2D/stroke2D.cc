@@ -2,378 +2,54 @@
 
 using namespace std;
 
-/*
- *  IMPORTANT WARNING! IMPORTANT WARNING! IMPORTANT WARNING!
- *  All these functions use iterators on points... It works because points
- *  array is never modified... Beware! Better use array indices rather than
- *  iterators!
- */
-
-/*
- *  fitCurve :
- *  Fit a Bezier curve to a set of digitized points 
- */
-void Stroke2D::fitCurve(const points::iterator first,
-			const points::iterator last, real error) {
-  /* Number of points in subset */
-  points::difference_type npoints = std::distance(first, last) + 1;
-  
-  /* Unit tangent vectors at endpoints */
-  vec2 tanv1(leftTangent(first, npoints));
-  vec2 tanv2(rightTangent(last, npoints));
-  fitCubic(first, last, tanv1, tanv2, error);
-}
-
-/*
- *  fitCubic :
- *  Fit a Bezier curve to a (sub)set of digitized points
- */
-void Stroke2D::fitCubic(const points::iterator first,
-			const points::iterator last,
-			const vec2& tanv1, const vec2& tanv2, real error) {
-  bezier b(3); /* Fitted cubic Bezier curve */
-  
-  /* Number of points in subset */
-  points::difference_type npoints = std::distance(first, last) + 1;
-  
-  /*  Use heuristic if region only has two points in it */
-  if (npoints == 2) {
-    real d = dist((*last).pos, (*first).pos)/3.0;
-    b.V[0] = (*(first)).pos;
-    b.V[3] = (*(last)).pos;
-    b.V[1] = b.V[0] + tanv1*d;
-    b.V[2] = b.V[3] + tanv2*d;
-    bs.push_back(b);
-    return;
-  }
-  
-  /* Parameterize points, and attempt to fit curve */
-  chordLengthParameterize(first, last);
-  generateBezier(first, last, tanv1, tanv2, b);
+void Stroke2D::fit(Input& in, const real error, Decimator* dec) {
+  /* Filter */
+  /*if (in.positions.size() > 2)
+    in.fair(); // Useful?*/
   
-  /*  Find max deviation of points to fitted curve */
-  real maxError;          /* Maximum fitting error */
-  points::iterator split; /* Point to split point set at */
-  computeMaxError(first, last, b, split, &maxError);
-  if (maxError < error) {
-    bs.push_back(b);
-    return;
+  /* Decimate */
+  if (dec != 0) {
+    kept.clear();
+    kept.push_back(in.positions.front());
+    dec->decimate(in.positions, 0, in.positions.size() - 1, kept);
   }
   
-  /* If error not too large, try some reparameterization */
-  /* and iteration */
-  real iterationError = error*error; /* Error below which you try iterating */
-  int maxIterations = 4;             /* Max times to try iterating */
-  if (maxError < iterationError) {
-    for (int i = 0; i < maxIterations; i++) {
-      reparameterize(first, last, b);
-      generateBezier(first, last, tanv1, tanv2, b);
-      computeMaxError(first, last, b, split, &maxError);
-      if (maxError < error) {
-	bs.push_back(b);
-	return;
-      }
+  /* Locate corners */
+  const points& pts = (dec != 0 ? kept : in.positions);
+  const int last = pts.size() - 1;
+  corners.clear();
+  corners.push_back(0);
+  for (int p = 1; p != last; p++) {
+    real cos_a = cosAng(pts[p+1].pos - pts[p].pos, pts[p-1].pos - pts[p].pos);
+    if (cos_a > 0.0) {
+      corners.push_back(p);
     }
   }
+  corners.push_back(last);
   
-  /* Fitting failed -- split at max error point and fit recursively */
-  vec2 tanv_center(centerTangent(split)); /* Unit tangent vector */
-                                          /* at split point */
-  fitCubic(first, split, tanv1, tanv_center, error);
-  fitCubic(split, last, -tanv_center, tanv2, error);
+  /* Fit the spans between them */
+  fitter.fitSpans(pts, corners, error, bs);
 }
 
-class A {
-  typedef GLdouble   real;
-  typedef Vec2<real> vec2;
-  
-public:
-  A() {}
-  A(const vec2& v1, const vec2& v2)
-    : A1(v1), A2(v2) {}
-  
-  vec2 A1, A2;
-};
-
-/*
- *  generateBezier :
- *  Use least-squares method to find Bezier control points for region.
- */
-void Stroke2D::generateBezier(const points::const_iterator first,
-			      const points::const_iterator last,
-			      const vec2& tanv1, const vec2& tanv2,
-			      bezier& b) {
-  std::vector<A> As; /* Precomputed rhs for eqn */
-  
-  /* Compute the A's */
-  points::const_iterator p;
-  for (p = first; p <= last; p++) {
-    real u = (*p).u;
-    As.push_back(A(tanv1*bezier::B31(u),tanv2*bezier::B32(u)));
-  }
-  
-  /* Create the C and X matrices */
-  real C[2][2];
-  real X[2];
-  
-  C[0][0] = 0.0; C[0][1] = 0.0;
-  C[1][0] = 0.0; C[1][1] = 0.0;
-  
-  X[0] = 0.0;
-  X[1] = 0.0;
-  
-  std::vector<A>::iterator a = As.begin();
-  for (p = first; p <= last; p++, a++) {
-    C[0][0] += dot((*a).A1,(*a).A1);
-    C[0][1] += dot((*a).A1,(*a).A2);
-    C[1][0] = C[0][1];
-    C[1][1] += dot((*a).A2, (*a).A2);
-    
-    real u = (*p).u;
-    vec2 tmp = (*p).pos
-               - ((*first).pos*bezier::B30(u) + (*first).pos*bezier::B31(u) +
-		   (*last).pos*bezier::B32(u) + (*last).pos*bezier::B33(u));
-    
-    X[0] += dot((*a).A1,tmp);
-    X[1] += dot((*a).A2,tmp);
-  }
-  
-  /* Compute the determinants of C and X */
-  real det_C0_C1, det_C0_X, det_X_C1; /* Determinants of matrices */
-  
-  det_C0_C1 = C[0][0] * C[1][1] - C[1][0] * C[0][1];
-  det_C0_X  = C[0][0] * X[1]    - C[0][1] * X[0];
-  det_X_C1  = X[0]    * C[1][1] - X[1]    * C[0][1];
-  
-  /* Finally, derive alpha values */
-  
-  /* Old solution: doesn't work because problems appear way before */
-  /* determinant equals zero. */
-  /*if (det_C0_C1 == 0.0) {
-    det_C0_C1 = (C[0][0] * C[1][1]) * 1.0e-12;
-  }*/
-  
-  /* New solution to handle near zero determinants. */
-  if (det_C0_C1 < 1.0e-3) {
-#if DEBUG
-    cerr << "Warning: Near zero determinant! Det = " << det_C0_C1 << endl;
+void Stroke2D::evalProperties() {
+  evalLength();
+#ifndef TEST_STROKE2D
+  evalCurvatureCenters();
 #endif
-    real d = dist((*last).pos, (*first).pos)/3.0;
-    b.V[0] = (*(first)).pos;
-    b.V[3] = (*(last)).pos;
-    b.V[1] = b.V[0] + tanv1*d;
-    b.V[2] = b.V[3] + tanv2*d;
-    return;
-  }
-  real alpha_l, alpha_r; /* Alpha values, left and right */
-  alpha_l = det_X_C1 / det_C0_C1;
-  alpha_r = det_C0_X / det_C0_C1;
-  
-  /* If alpha negative, use the Schmitt et al. heuristic (see text) */
-  /* (if alpha is 0, you get coincident control points that lead to */
-  /* divide by zero in any subsequent findNewtonRaphsonRoot() call. */
-  if (alpha_l < 1.0e-6 || alpha_r < 1.0e-6) {
-    real d = dist((*last).pos, (*first).pos)/3.0;
-    b.V[0] = (*(first)).pos;
-    b.V[3] = (*(last)).pos;
-    b.V[1] = b.V[0] + tanv1*d;
-    b.V[2] = b.V[3] + tanv2*d;
-    return;
-  }
-  
-  /* First and last control points of the Bezier curve are */
-  /* positioned exactly at the first and last data points. */
-  /* Control points 1 and 2 are positioned an alpha distance out */
-  /* on the tangent vectors, left and right, respectively. */
-  b.V[0] = (*(first)).pos;
-  b.V[3] = (*(last)).pos;
-  b.V[1] = b.V[0] + tanv1*alpha_l;
-  b.V[2] = b.V[3] + tanv2*alpha_r;
-}
-
-/*
- *  findNewtonRaphsonRoot :
- *  Use Newton-Raphson iteration to find better root.
- */
-void Stroke2D::findNewtonRaphsonRoot(bezier& Q, point& P) {
-  vec2 Q_u, Q1_u, Q2_u; /* Q, Q' and Q'' evaluated at u */
-  
-  /* Compute Q(u) */
-  Q.evaluate(P.u, Q_u);
-  
-  /* Generate control vertices for Q' */
-  bezier Q1(2);
-  bezier::ctrl_points::iterator p1 = Q1.V.begin();
-  bezier::ctrl_points::iterator p  = Q.V.begin();
-  for (; p1 != Q1.V.end(); p1++, p++) {
-    (*p1) = ((*(p+1)) - (*p)) * 3.0;
-  }
-  
-  /* Generate control vertices for Q'' */
-  bezier Q2(1);
-  bezier::ctrl_points::iterator p2 = Q2.V.begin();
-  p1 = Q1.V.begin();
-  for (; p2 != Q2.V.end(); p2++, p1++) {
-    (*p2) = ((*(p1+1)) - (*p1)) * 2.0;
-  }
-  
-  /* Compute Q'(u) and Q''(u) */
-  Q1.evaluate(P.u, Q1_u);
-  Q2.evaluate(P.u, Q2_u);
-  
-  /* Compute f(u)/f'(u) */
-  real numerator = (Q_u.x() - P.pos.x()) * (Q1_u.x()) +
-                   (Q_u.y() - P.pos.y()) * (Q1_u.y());
-  real denominator = (Q1_u.x()) * (Q1_u.x()) +
-                     (Q1_u.y()) * (Q1_u.y()) +
-		     (Q_u.x() - P.pos.x()) * (Q2_u.x()) +
-                     (Q_u.y() - P.pos.y()) * (Q2_u.y());
-  
-  /* u = u - f(u)/f'(u) */
-  P.u -= numerator/denominator;
-}
-
-/*
- *  computeMaxError :
- *  Find the maximum squared distance of digitized points
- *  to fitted curve.
- */
-void Stroke2D::computeMaxError(const points::iterator first,
-			       const points::iterator last, bezier& b,
-			       points::iterator& split, real* maxError) {
-  points::difference_type splitPoint
-    = static_cast<points::difference_type>(0.5*(std::distance(first, last)+1));
-  split = first + splitPoint; // Added!
-  real maxDistance = 0.0; /* Maximum distance */
-  for (points::iterator p = first+1; p != last; p++) {
-    vec2 P; /* Point on curve */
-    b.evaluate((*p).u, P);
-    real distance = dist(P, (*p).pos); /* Current error */
-    if (distance > maxDistance) {
-      maxDistance = distance;
-      split = p;
-    }
-  }
-  *maxError = maxDistance;
-}
-
-/*
- *  leftTangent, rightTangent, centerTangent :
- *  Approximate unit tangents at endpoints and "center" of digitized curve
- *  by fitting a least-square line to the points in the neighborhood of the end
- *  points or by averaging vectors from the endpoints to the next n points.
- */
-Stroke2D::vec2 Stroke2D::leftTangent(const points::const_iterator p,
-				     const points::difference_type npoints) {
-  if (npoints < 10) { // 5 is the minimum!
-    return ((*(p+1)).pos - (*p).pos).normalize();
-  }
-  else {
-    return (0.5*((*(p+2)).pos + (*(p+1)).pos - 2.0*(*p).pos)).normalize();
-  }
-}
-Stroke2D::vec2 Stroke2D::rightTangent(const points::const_iterator p,
-				      const points::difference_type npoints) {
-  if (npoints < 10) { // 5 is the minimum!
-    return ((*(p-1)).pos - (*p).pos).normalize();
-  }
-  else {
-    return (0.5*((*(p-2)).pos + (*(p-1)).pos - 2.0*(*p).pos)).normalize();
-  }
-}
-Stroke2D::vec2 Stroke2D::centerTangent(const points::const_iterator p) {
-  return ((*(p-1)).pos - (*(p+1)).pos).normalize();
-}
-
-/*
- *  chordLengthParameterize :
- *  Assign parameter values to digitized points 
- *  using relative distances between points.
- */
-void Stroke2D::chordLengthParameterize(const points::iterator first,
-				       const points::iterator last) {
-  (*first).u = 0.0;
-  points::iterator p;
-  for (p = first+1; p <= last; p++) {
-    (*p).u = (*(p-1)).u + dist((*p).pos, (*(p-1)).pos);
-  }
-  real u_last = (*last).u;
-  for (p = first+1; p != last; p++) {
-    (*p).u /= u_last;
-  }
-  (*last).u = 1.0;
-}
-
-/*
- *  reparameterize :
- *  Given set of points and their parameterization, try to find
- *  a better parameterization.
- */
-void Stroke2D::reparameterize(const points::iterator first,
-			      const points::iterator last, bezier& b) {
-  for (points::iterator p = first; p <= last; p++) {
-    findNewtonRaphsonRoot(b, (*p));
-  }
-}
-
-void Stroke2D::fit(Input& in, const real error) {
-  /* Filter */
-  /*if (in.positions.size() > 2)
-    in.fair(); // Useful?*/
-  
-  /* Locate corners */
-  points::iterator first = in.positions.begin();
-  points::iterator last  = in.positions.end()-1;
-  points::iterator p;
-  points::iterator split = in.positions.begin()+1;
-  bool have_corner = false;
-  for (p = first+1; p != last; p++) {
-    real cos_a = cosAng((*(p+1)).pos - (*p).pos, (*(p-1)).pos - (*p).pos);
-    if (cos_a > 0.0) {
-      have_corner = true;
-      split = p;
-      fitCurve(first, split, error);
-      first = split;
-    }
-  }
-  if (have_corner) {
-    fitCurve(split, last, error);
-  }
-  else {
-    fitCurve(in.positions.begin(), in.positions.end()-1, error);
-  }
 }
 
 void Stroke2D::evalLength() {
   beziers::iterator b;
   
-  /* First pass */
-  const int nstep_rough = 3; // Magic number!
+  /* Arc lengths, unless already known (see Stream_Fitter) */
   for (b = bs.begin(); b != bs.end(); b++) {
-    (*b).evalLength(nstep_rough);
-    length += (*b).length;
-  }
-  // I'm not sure this first pass is really useful but...
-  
-  /* Second pass */
-  const real length_rough = length;
-  const real length_rough_inv = 1.0/length_rough;
-  length = 0.0;
-  int nstep_tot = static_cast<int>(steps_per_unit_length*length_rough);
-  if (nstep_tot < 3) {
-    nstep_tot = 3;
-  }
-  for (b = bs.begin(); b != bs.end(); b++) {
-    int nstep = static_cast<int>(((*b).length*length_rough_inv)*nstep_tot);
-    if (nstep == 0) {
-      nstep = 1;
+    if ((*b).length == 0.0) {
+      (*b).evalArcLength();
     }
-    (*b).length = 0.0;
-    (*b).evalLength(nstep);
     length += (*b).length;
   }
   
-  /* Third pass */
+  /* Relative lengths */
   const real length_inv = 1.0/length;
   for (b = bs.begin(); b != bs.end(); b++) {
     relative_lengths.push_back((*b).length*length_inv);
@@ -746,6 +422,10 @@ void Stroke2D::evalCurvatureCenters() {
 
 const Stroke2D::real Stroke2D::steps_per_unit_length = 0.1; // Magic number!
 
+Parallel_Fitter Stroke2D::fitter;
+std::vector<int> Stroke2D::corners;
+Stroke2D::points Stroke2D::kept;
+
 Stroke2D::Stroke2D()
   : length(0.0) {
   const int n = 10; // Magic number!
@@ -753,17 +433,27 @@ Stroke2D::Stroke2D()
   relative_lengths.reserve(n);
 }
 
-Stroke2D::Stroke2D(Input& in, real error)
+Stroke2D::Stroke2D(Input& in, real error, Decimator* dec)
   : length(0.0) {
   if (in.positions.size() > 1) {
     const int n = 10; // Magic number!
     bs.reserve(n);
     relative_lengths.reserve(n);
-    fit(in, error);
-    evalLength();
-#ifndef TEST_STROKE2D
-    evalCurvatureCenters();
-#endif
+    fit(in, error, dec);
+    evalProperties();
+  }
+}
+Stroke2D::Stroke2D(Input& in, Stream_Fitter& sf)
+  : length(0.0) {
+  if (in.positions.size() > 1) {
+    const int n = 10; // Magic number!
+    bs.reserve(n);
+    relative_lengths.reserve(n);
+    sf.finish(in.positions, bs);
+    evalProperties();
+  }
+  else {
+    sf.clear();
   }
 }
 
@@ -885,9 +575,7 @@ void Stroke2D::drawDerivatives() const {
       t_stop = nstep_b;
     }
     for (int t = 0; t < t_stop; t++) {
-      (*p).evaluate(t*step_size, Q);
-      (*p).evalDerivative(1, t*step_size, Q_prime);
-      (*p).evalDerivative(2, t*step_size, Q_second);
+      (*p).evalDerivatives(t*step_size, Q, Q_prime, Q_second);
       glColor3f(1.0, 0.0, 0.0); // Be careful!
       glVertex2d(Q.x(), Q.y());
       glVertex2d(Q.x()+Q_prime.x(), Q.y()+Q_prime.y());
@@ -1,7 +1,16 @@
+#include <algorithm>
 #include "drawing.h"
 
 using namespace std;
 
+/* Sort strokes by the order they were added to the drawing */
+class Earlier_Stroke {
+public:
+  bool operator()(const Stroke3D* s, const Stroke3D* t) const {
+    return s->sequence < t->sequence;
+  }
+};
+
 void Drawing::setStrokesColor(const GLfloat color[4]) {
   strokes::iterator p_end = strks.end();
   for (strokes::iterator p = strks.begin(); p != p_end; p++) {
@@ -9,27 +18,101 @@ void Drawing::setStrokesColor(const GLfloat color[4]) {
   }
 }
 
-void Drawing::addReadStroke(const stroke& s) {
+/*
+ *  addReadStroke, addStroke :
+ *  The stroke is taken over by the drawing, without copy, and s is left
+ *  empty.
+ */
+void Drawing::addReadStroke(stroke& s) {
   if (!s.empty()) {
-    strks.push_back(s);
-    strokes::iterator p_last = --strks.end();
-    (*p_last).occluder_tex_name      = occluder_tex_name;
-    (*p_last).proba_surface_tex_name = proba_surface_tex_name;
-    (*p_last).stroke_tex_name        = stroke_tex_name;
+    const strokes::handle h = strks.insert(s);
+    stroke& last = strks[h];
+    last.occluder_tex_name      = occluder_tex_name;
+    last.proba_surface_tex_name = proba_surface_tex_name;
+    last.stroke_tex_name        = stroke_tex_name;
     // No texture init... In the future!
     // No color init!
-    for (strokes::iterator p = strks.begin(); p != p_last; p++) {
-      if ((*p_last).box.isIntersectedBy((*p).box)) {
-	(*p_last).addIntersectedStroke(*p);
-      }
-    }
+    addIntersections(h);
   }
 }
 
+/*
+ *  addIntersections :
+ *  Node of a new stroke in the graph of intersections, holding its handle,
+ *  and its edges to the strokes it intersects, found in the tree of boxes
+ *  before the stroke is inserted in it. Edges are added by node, roughly
+ *  the order of the strokes. The stroke is the last one to undo, and the
+ *  last one to draw.
+ */
+void Drawing::addIntersections(const strokes::handle h) {
+  stroke& s_new = strks[h];
+  s_new.sequence = next_sequence++;
+  const stroke::graph::node n = intersections.addNode(h);
+  s_new.node = n;
+  setClippingPlanes(s_new);
+  hits.clear();
+  boxes.query(s_new.box, hits);
+  std::sort(hits.begin(), hits.end());
+  for (int i = 0; i < hits.size(); i++) {
+    intersections.addEdge(n, hits[i]);
+  }
+  boxes.insert(n, s_new.box);
+  history.push_back(h);
+}
+
+/*
+ *  eraseStroke :
+ *  Removal of a stroke, of its GL data, of its node and of its handle in
+ *  the history, searched from the end (the last one, for an undo).
+ */
+void Drawing::eraseStroke(const strokes::handle h, const int window) {
+  stroke& s = strks[h];
+  s.clean(window);
+  boxes.remove(s.node);
+  intersections.removeNode(s.node);
+  strks.remove(h);
+  std::vector<strokes::handle>::iterator p = history.end();
+  while (p != history.begin() && *(p - 1) != h) {
+    p--;
+  }
+  assert(p != history.begin());
+  history.erase(p - 1);
+}
+
+/*
+ *  lastStroke :
+ *  Handle of the last stroke added and not removed yet, NO_HANDLE if none.
+ */
+Drawing::strokes::handle Drawing::lastStroke() {
+  return history.empty() ? strokes::NO_HANDLE : history.back();
+}
+
+/*
+ *  setClippingPlanes :
+ *  Barycenter and mean radius of a stroke, new or changed, for the next
+ *  update of the clipping planes.
+ */
+void Drawing::setClippingPlanes(const stroke& s) {
+  const GLdouble barycenter[3] = {s.barycenter_global[0],
+				  s.barycenter_global[1],
+				  s.barycenter_global[2]};
+  planes.set(s.node, barycenter, s.mean_radius);
+}
+
+/*
+ *  refitStroke :
+ *  Clipping planes and box in the tree of a stroke that moved. Its edges
+ *  are left as they were when it was added.
+ */
+void Drawing::refitStroke(const stroke& s) {
+  setClippingPlanes(s);
+  boxes.refit(s.node, s.box);
+}
+
 Drawing::Drawing()
   : background_tex_name(0),
     occluder_tex_name(0), proba_surface_tex_name(0), stroke_tex_name(0),
-    accumulation(false) {
+    accumulation(false), next_sequence(0) {
   texs.reserve(5);   // Magic number!
   const int n = 20;
   const GLfloat background_array[n] = { 0.0,  0.0, 0.0, 0.0, 0.0,
@@ -38,7 +121,7 @@ Drawing::Drawing()
                                         0.0, 10.0, 0.0, 1.0, 0.0};
   background = std::vector<GLfloat>(background_array, background_array + n);
   transparent_plane = std::vector<GLfloat>(12, 0.0);
-  p_selected_stroke_prev = strks.end();
+  selected = strokes::NO_HANDLE;
 }
 
 void Drawing::setColor(const GLfloat color[4], const colortype type) {
@@ -79,86 +162,149 @@ void Drawing::addTexture(const Texture& tex, const textype type) {
   }
 }
 
-void Drawing::addStroke(const stroke& s) {
+void Drawing::addStroke(stroke& s) {
   if (!s.empty()) {
-    strks.push_back(s);
-    strokes::iterator p_last = --strks.end();
-    (*p_last).occluder_tex_name      = occluder_tex_name;
-    (*p_last).proba_surface_tex_name = proba_surface_tex_name;
-    (*p_last).stroke_tex_name        = stroke_tex_name;
-    (*p_last).setInitColor(stroke_color);
-    for (strokes::iterator p = strks.begin(); p != p_last; p++) {
-      if ((*p_last).box.isIntersectedBy((*p).box)) {
-	(*p_last).addIntersectedStroke(*p);
-      }
+    const strokes::handle h = strks.insert(s);
+    stroke& last = strks[h];
+    last.occluder_tex_name      = occluder_tex_name;
+    last.proba_surface_tex_name = proba_surface_tex_name;
+    last.stroke_tex_name        = stroke_tex_name;
+    last.setInitColor(stroke_color);
+    addIntersections(h);
+  }
+}
+
+/*
+ *  intersect :
+ *  Handle of the stroke whose probability surface the segment from origin
+ *  to origin + direction crosses first, if before t (Input::DEFAULT_NAME,
+ *  an invalid handle, if none), and the parameter t of the point. The
+ *  segment is cast against the tree of boxes, then against the surfaces of
+ *  the strokes whose boxes it crosses, nearest box first, as they are
+ *  tessellated now, until a box starts past the nearest point found.
+ */
+GLuint Drawing::intersect(const GLdouble origin[3],
+			  const GLdouble direction[3], GLdouble& t) {
+  hits.clear();
+  hit_params.clear();
+  boxes.query(stroke::tree::vec(origin[0], origin[1], origin[2]),
+	      stroke::tree::vec(direction[0], direction[1], direction[2]),
+	      hits, &hit_params);
+  strokes::handle h_hit = strokes::NO_HANDLE;
+  for (int i = 0; i < hits.size() && hit_params[i] <= t; i++) {
+    const strokes::handle h = intersections.value(hits[i]);
+    if (strks[h].intersect(origin, direction, t, grid)) {
+      h_hit = h;
     }
   }
+  return h_hit;
+}
+
+/*
+ *  pickStroke :
+ *  Stroke under the cursor, selected in in by its handle, if it is before
+ *  t along the segment through the pixel (behind the scene model
+ *  otherwise).
+ */
+bool Drawing::pickStroke(const int x, const int y, Input& in, GLdouble t) {
+  GLdouble origin[3], direction[3];
+  in.segment(x, y, origin, direction);
+  const strokes::handle h = intersect(origin, direction, t);
+  if (!strks.contains(h)) {
+    const GLdouble far_point[3] = {origin[0] + direction[0],
+				   origin[1] + direction[1],
+				   origin[2] + direction[2]};
+    return in.selectStroke(Input::DEFAULT_NAME, far_point, 1.0);
+  }
+  const GLdouble point[3] = {origin[0] + t*direction[0],
+			     origin[1] + t*direction[1],
+			     origin[2] + t*direction[2]};
+  return in.selectStroke(h, point, in.depth(point));
 }
-/* TODO:
-   Naive implementation: should use clustering and test intersection with
-   an AABB_Tree instead.
-*/
 
+/*
+ *  markStroke :
+ *  Stroke selected in in marked, or unmarked if it was already. Nothing
+ *  happens if it was removed since.
+ */
 void Drawing::markStroke(const Input& in) {
-  strokes::iterator p_selected_stroke_curr = strks.begin();
-  std::advance(p_selected_stroke_curr, in.selectedStrokeID());
-  if (p_selected_stroke_curr == p_selected_stroke_prev) {
-    (*p_selected_stroke_curr).reinitColor();
-    p_selected_stroke_prev = strks.end();
+  const strokes::handle h = in.selectedStrokeID();
+  if (!strks.contains(h)) {
+    return;
+  }
+  if (h == selected) {
+    strks[h].reinitColor();
+    selected = strokes::NO_HANDLE;
   }
   else {
-    (*p_selected_stroke_curr).setColor(selected_stroke_color);
-    if (p_selected_stroke_prev != strks.end()) {
-      (*p_selected_stroke_prev).reinitColor();
+    strks[h].setColor(selected_stroke_color);
+    if (strks.contains(selected)) {
+      strks[selected].reinitColor();
     }
-    p_selected_stroke_prev = p_selected_stroke_curr;
+    selected = h;
   }
 }
 
 void Drawing::unmarkStroke() {
-  if (p_selected_stroke_prev != strks.end()) {
-    (*p_selected_stroke_prev).reinitColor();
-    p_selected_stroke_prev = strks.end();
+  if (strks.contains(selected)) {
+    strks[selected].reinitColor();
   }
+  selected = strokes::NO_HANDLE;
 }
 
 void Drawing::startMovingStroke(int x, int y) {
-  if (p_selected_stroke_prev != strks.end()) {
+  if (strks.contains(selected)) {
     first_x = x;
     first_y = y;
   }
 }
 
-void Drawing::stopMovingStroke(int x, int y, const Input& in) {
-  if (p_selected_stroke_prev != strks.end()) {
+/*
+ *  moveStroke :
+ *  Selected stroke moved by the last step of the mouse, through its model
+ *  transform only.
+ */
+void Drawing::moveStroke(int x, int y, const Input& in) {
+  if (strks.contains(selected)) {
     last_x = x;
     last_y = y;
-    (*p_selected_stroke_prev).translate(first_x, first_y, last_x, last_y, in);
+    if (last_x != first_x || last_y != first_y) {
+      strks[selected].translate(first_x, first_y, last_x, last_y, in);
+      refitStroke(strks[selected]);
+    }
+    first_x = last_x;
+    first_y = last_y;
   }
 }
 
-void Drawing::reverseStroke(const Input& in) {
-  if (p_selected_stroke_prev == strks.end()) {
-    strks.back().reverse(in.window);
+void Drawing::stopMovingStroke(int x, int y, const Input& in) {
+  moveStroke(x, y, in);
+}
+
+void Drawing::applyStrokeTransforms(const Input& in) {
+  for (strokes::iterator p = strks.begin(); p != strks.end(); p++) {
+    (*p).applyTransform(in.window);
+    refitStroke(*p);
   }
-  else {
-    (*p_selected_stroke_prev).reverse(in.window);
+}
+
+/*
+ *  reverseStroke, removeStroke :
+ *  Selected stroke reversed or removed, the last one added if none.
+ */
+void Drawing::reverseStroke(const Input& in) {
+  const strokes::handle h = strks.contains(selected) ? selected : lastStroke();
+  if (h != strokes::NO_HANDLE) {
+    strks[h].reverse(in.window);
+    refitStroke(strks[h]);
   }
 }
 
 void Drawing::removeStroke(const Input& in) {
-  if (!strks.empty()) {
-    if (p_selected_stroke_prev == strks.end()) {
-      strks.back().clean(in.window);
-      strks.back().cleanIntersectedStrokes();
-      strks.pop_back();
-    }
-    else {
-      (*p_selected_stroke_prev).clean(in.window);
-      (*p_selected_stroke_prev).cleanIntersectedStrokes();
-      strks.erase(p_selected_stroke_prev);
-      p_selected_stroke_prev = strks.end();
-    }
+  const strokes::handle h = strks.contains(selected) ? selected : lastStroke();
+  if (h != strokes::NO_HANDLE) {
+    eraseStroke(h, in.window);
+    selected = strokes::NO_HANDLE;
   }
 }
 
@@ -168,23 +314,77 @@ void Drawing::clearStrokes(const Input& in) {
     (*p).clean(window);
   }
   strks.clear();
+  history.clear();
+  selected = strokes::NO_HANDLE;
+  intersections.clear();
+  boxes.clear();
+  planes.clear();
+}
+
+/*
+ *  cullStrokes :
+ *  Strokes whose boxes are in the view frustum of in, found in the tree of
+ *  boxes, and sorted in the order they were added (the drawing order, which
+ *  removals change in the array) for the passes of the frame.
+ */
+void Drawing::cullStrokes(const Input& in) {
+  GLdouble frustum[6][4];
+  in.frustum(frustum);
+  stroke::tree::real frustum_planes[6*4];
+  for (int i = 0; i < 6*4; i++) {
+    frustum_planes[i] = frustum[i/4][i%4];
+  }
+  hits.clear();
+  boxes.query(6, frustum_planes, hits);
+  visible.clear();
+  for (int i = 0; i < hits.size(); i++) {
+    visible.push_back(&strks[intersections.value(hits[i])]);
+  }
+  std::sort(visible.begin(), visible.end(), Earlier_Stroke());
+}
+
+/*
+ *  visibleStrokes, totalStrokes :
+ *  Strokes drawn by the last frame, out of all of them.
+ */
+int Drawing::visibleStrokes() const {
+  return visible.size();
+}
+
+int Drawing::totalStrokes() const {
+  return strks.size();
+}
+
+/*
+ *  inDrawingOrder :
+ *  True if the strokes of the last frame were drawn in the order of the
+ *  history, the order they were added and are written (for tests).
+ */
+bool Drawing::inDrawingOrder() const {
+  int j = 0;
+  for (int i = 0; i < history.size() && j < visible.size(); i++) {
+    if (&strks[history[i]] == visible[j]) {
+      j++;
+    }
+  }
+  return j == visible.size();
 }
 
 void Drawing::setBackgroundVertices(const Input& in) {
   static const GLint win[4][2] = {{0, 1}, {2, 1}, {2, 3}, {0, 3}};
+  GLdouble wins[12], objs[12];
   for (int i = 0; i < 4; i++) {
-    GLdouble objx, objy, objz;
-    if (gluUnProject(in.viewport[win[i][0]], in.viewport[win[i][1]],
-		     0.2, /* Magic number! */
-		     in.mv_matrix, in.proj_matrix, in.viewport,
-		     &objx, &objy, &objz)) {
-      background[2 + 5*i    ] = static_cast<GLfloat>(objx);
-      background[2 + 5*i + 1] = static_cast<GLfloat>(objy);
-      background[2 + 5*i + 2] = static_cast<GLfloat>(objz);
-    }
-    else {
-      assert(false);
-    }
+    wins[3*i    ] = in.viewport[win[i][0]];
+    wins[3*i + 1] = in.viewport[win[i][1]];
+    wins[3*i + 2] = 0.2; /* Magic number! */
+  }
+  if (!in.unprojector.unproject(4, wins, objs)) {
+    assert(false);
+  }
+  for (int i = 0; i < 4; i++) {
+    background[2 + 5*i    ] = static_cast<GLfloat>(objs[3*i    ]);
+    background[2 + 5*i + 1] = static_cast<GLfloat>(objs[3*i + 1]);
+    background[2 + 5*i + 2] = static_cast<GLfloat>(objs[3*i + 2]);
   }
 }
 
@@ -197,25 +397,23 @@ void Drawing::setTransparentPlaneVertices(const Input& in) {
   const GLdouble viewport_mod[4]
     = {in.viewport[0] + x_ratio, in.viewport[1] + y_ratio,
        in.viewport[2] - x_ratio, in.viewport[3] - y_ratio};
+  GLdouble wins[12], objs[12];
   for (int i = 0; i < 4; i++) {
-    GLdouble objx, objy, objz;
-    if (gluUnProject(viewport_mod[win[i][0]], viewport_mod[win[i][1]],
-		     winz,
-		     in.mv_matrix, in.proj_matrix, in.viewport,
-		     &objx, &objy, &objz)) {
-      transparent_plane[3*i    ] = static_cast<GLfloat>(objx);
-      transparent_plane[3*i + 1] = static_cast<GLfloat>(objy);
-      transparent_plane[3*i + 2] = static_cast<GLfloat>(objz);
-    }
-    else {
-      assert(false);
-    }
+    wins[3*i    ] = viewport_mod[win[i][0]];
+    wins[3*i + 1] = viewport_mod[win[i][1]];
+    wins[3*i + 2] = winz;
+  }
+  if (!in.unprojector.unproject(4, wins, objs)) {
+    assert(false);
+  }
+  for (int i = 0; i < 4; i++) {
+    transparent_plane[3*i    ] = static_cast<GLfloat>(objs[3*i    ]);
+    transparent_plane[3*i + 1] = static_cast<GLfloat>(objs[3*i + 1]);
+    transparent_plane[3*i + 2] = static_cast<GLfloat>(objs[3*i + 2]);
   }
 }
 
 /* TODO:
-   . ecrire une fonction gluUnProject qui ne reinverse pas systematiquement la
-   matrice -> gain de temps!
    . incorporer a une class OpenGLWindow ?
 */
 
@@ -264,13 +462,18 @@ bool Drawing::read(const char* name, const int window) {
   file_in.getline(line, 256, '\n');
   int n;
   sscanf(line, "%d", &n);
+  bool ok = true;
   for (int i = 0; i < n; i++) {
     stroke s;
-    s.read(file_in, window);
+    if (!s.read(file_in, window)) {
+      ok = false; // The strokes read before are kept
+      break;
+    }
     addReadStroke(s);
   }
   file_in.close();
-  return true;
+  boxes.rebuild(); // Surface area heuristic over all the strokes
+  return ok;
 }
 
 bool Drawing::readOneByOne(const char* name, const int window) {
@@ -290,79 +493,36 @@ bool Drawing::readOneByOne(const char* name, const int window) {
   }
   if (i < n) {
     stroke s;
-    s.read(file_in, window);
-    addReadStroke(s);
-    i++;
-    return true;
-  }
-  else {
-    file_in.close();
-    i = 0;
-    first_time = true;
-    return false;
+    if (s.read(file_in, window)) {
+      addReadStroke(s);
+      i++;
+      return true;
+    }
   }
+  file_in.close(); // Last stroke read, or corrupt file
+  i = 0;
+  first_time = true;
+  return false;
 }
 
+/*
+ *  write :
+ *  Strokes in the order they were added (the order of the history, not of
+ *  the array, which changes when a stroke is removed).
+ */
 bool Drawing::write(const char* name) const {
   ofstream file_out(name, ios::out);
   if (!file_out) {
     return false;
   }
   file_out << strks.size() << endl;
-  strokes::const_iterator p;
-  for (p = strks.begin(); p != strks.end(); p++) {
-    (*p).write(file_out);
+  for (int i = 0; i < history.size(); i++) {
+    strks[history[i]].write(file_out);
   }
   file_out.close();
   return true;
 }
 
-void Drawing::drawSelection() const {
-  glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_HINT_BIT |
-	       GL_LINE_BIT | GL_POLYGON_BIT);
-  
-  glEnable(GL_MAP1_VERTEX_3);
-  glEnable(GL_MAP2_VERTEX_3);
-  glLineWidth(line_width);
-  
-  GLuint name = 0;
-  for (strokes::const_iterator s = strks.begin(); s != strks.end(); s++) {
-    glLoadName(name);
-    name++;
-    (*s).drawProbaSurfacePicking();
-  }
-  
-  glPopAttrib();
-}
-
-void Drawing::drawFeedback(const Input& in) const {
-  glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_HINT_BIT |
-	       GL_LINE_BIT | GL_POLYGON_BIT);
-  
-  glEnable(GL_MAP1_VERTEX_3);
-  glEnable(GL_MAP2_VERTEX_3);
-  glLineWidth(line_width);
-  
-#if 0
-  GLfloat stroke_number_token = 0.0;
-  const GLfloat proba_surface_token
-    = in.object_tokens[Input::PROBA_SURFACE_INDEX];
-  for (strokes::iterator s = strks.begin(); s != strks.end(); s++) {
-    glPassThrough(stroke_number_token);
-    stroke_number_token += 1.0;
-    glPassThrough(proba_surface_token);
-    (*s).drawProbaSurfacePicking();
-  }
-#else
-  glPassThrough(in.object_tokens[Input::PROBA_SURFACE_INDEX]);
-  for (strokes::const_iterator s = strks.begin(); s != strks.end(); s++) {
-    (*s).drawProbaSurfacePicking();
-  }
-#endif
-  
-  glPopAttrib();
-}
-
 void Drawing::drawInformations(const Input& in) {
   glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_HINT_BIT |
 	       GL_COLOR_BUFFER_BIT | GL_TRANSFORM_BIT | GL_TEXTURE_BIT |
@@ -381,32 +541,37 @@ void Drawing::drawInformations(const Input& in) {
 #endif
   glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
   
-  for (strokes::iterator s = strks.begin(); s != strks.end(); s++) {
+  cullStrokes(in); // Strokes in the view frustum
+  planes.update(&in.view_vector[0]); // Of all the strokes at once
+  int lod_budget = Stroke3D::lod_budget;
+  for (int i = 0; i < visible.size(); i++) {
+    stroke& s = *visible[i];
+    s.setLevelOfDetail(in, lod_budget);
     //glColor3f(0.0, 1.0, 1.0);
-    //(*s).drawCurvatureVectors();
+    //s.drawCurvatureVectors();
     //glColor3f(0.0, 0.0, 1.0);
-    //(*s).drawCircles();
+    //s.drawCircles();
     //glColor3f(1.0, 0.0, 0.0);
-    //(*s).drawControlPoints();
+    //s.drawControlPoints();
     //glColor3f(0.0, 1.0, 0.0);
-    //(*s).drawTangents();
+    //s.drawTangents();
     //glColor3f(0.0, 1.0, 1.0);
-    //(*s).drawNormals();
+    //s.drawNormals();
     
     glLineWidth(1.0);
-    glColor4fv((*s).color);
-    (*s).drawProbaSurface();
+    glColor4fv(s.color);
+    s.drawProbaSurface();
     
-    if ((*s).drawing_mode == Stroke3D::TEXTURED_POLYGON) {
-      (*s).move(in);
-      //(*s).drawBoundingBox();
+    if (s.drawing_mode == Stroke3D::TEXTURED_POLYGON) {
+      //s.drawBoundingBox();
       //glPointSize(5.0);
       //glColor3f(1.0, 0.0, 0.0);
-      //(*s).drawBarycenter();
+      //s.drawBarycenter();
       glLineWidth(line_width);
-      (*s).drawClippedStroke();
+      s.drawClippedStroke(planes.equations(s.node));
       if (accumulation) {
-	(*s).drawIntersectedStrokes();
+	s.drawIntersectedStrokes(intersections, strks,
+				 planes.equations(s.node));
       }
     }
   }
@@ -442,18 +607,22 @@ void Drawing::draw(const Input& in) {
   glLineWidth(line_width);
   
   /* Draw strokes */
-  for (strokes::iterator s = strks.begin(); s != strks.end(); s++) {
-    if ((*s).drawing_mode == Stroke3D::LINE) {
+  cullStrokes(in); // Once for all the passes
+  planes.update(&in.view_vector[0]); // Of all the strokes at once
+  int lod_budget = Stroke3D::lod_budget;
+  for (int i = 0; i < visible.size(); i++) {
+    stroke& s = *visible[i];
+    s.setLevelOfDetail(in, lod_budget);
+    if (s.drawing_mode == Stroke3D::LINE) {
       glPushAttrib(GL_DEPTH_BUFFER_BIT);
       glDepthMask(GL_TRUE);
-      glColor4fv((*s).color);
-      (*s).drawSpline();
+      glColor4fv(s.color);
+      s.drawSpline();
       glPopAttrib();
     }
-    else if ((*s).drawing_mode == Stroke3D::TEXTURED_POLYGON) {
-      (*s).move(in);
-      glColor4fv((*s).color);
-      (*s).drawStrokeFirstPass();
+    else if (s.drawing_mode == Stroke3D::TEXTURED_POLYGON) {
+      glColor4fv(s.color);
+      s.drawStrokeFirstPass(planes.equations(s.node));
     }
   }
   
@@ -465,10 +634,11 @@ void Drawing::draw(const Input& in) {
   glPolygonOffset(1.0, 1.0);
   
   /* Draw occluders in depth buffer */
-  for (strokes::const_iterator s = strks.begin(); s != strks.end(); s++) {
-    if ((*s).drawing_mode == Stroke3D::TEXTURED_POLYGON ||
-	(*s).drawing_mode == Stroke3D::OCCLUSION) {
-      (*s).drawOccluder();
+  for (int i = 0; i < visible.size(); i++) {
+    const stroke& s = *visible[i];
+    if (s.drawing_mode == Stroke3D::TEXTURED_POLYGON ||
+	s.drawing_mode == Stroke3D::OCCLUSION) {
+      s.drawOccluder();
     }
   }
   
@@ -481,8 +651,9 @@ void Drawing::draw(const Input& in) {
   glColor4fv(background_color);
   
   /* Draw occluders in color buffer */
-  for (strokes::const_iterator s = strks.begin(); s != strks.end(); s++) {
-    if ((*s).drawing_mode == Stroke3D::TEXTURED_POLYGON) {
+  for (int i = 0; i < visible.size(); i++) {
+    const stroke& s = *visible[i];
+    if (s.drawing_mode == Stroke3D::TEXTURED_POLYGON) {
       
       /* Avoid drawing over its own stroke */
       glPushAttrib(GL_STENCIL_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
@@ -490,21 +661,21 @@ void Drawing::draw(const Input& in) {
       
       glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
       glStencilFunc(GL_EQUAL, 0x00000000, 0x00000001);
-      (*s).drawStrokeSecondPass();
+      s.drawStrokeSecondPass(planes.equations(s.node));
       
       glStencilMask(0x00000000);
       glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
-      (*s).drawOccluder();
+      s.drawOccluder();
       
       glStencilMask(0x00000001);
       glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
       glStencilFunc(GL_EQUAL, 0x00000001, 0x00000001);
-      (*s).drawStrokeSecondPass();
+      s.drawStrokeSecondPass(planes.equations(s.node));
       
       glPopAttrib();
     }
-    else if ((*s).drawing_mode == Stroke3D::OCCLUSION) {
-      (*s).drawOccluder();
+    else if (s.drawing_mode == Stroke3D::OCCLUSION) {
+      s.drawOccluder();
     }
   }
   
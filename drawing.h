@@ -3,6 +3,7 @@
 
 #include "trackball.h"
 #include "stroke3D.h"
+#include "clipping_planes.h"
 #include "texture.h"
 
 class Drawing {
@@ -12,14 +13,28 @@ private:
   typedef Quat<real>           quat;
   typedef Trackball<real>      trackball;
   typedef Stroke3D             stroke;
-  typedef std::list<stroke>    strokes;
+  typedef stroke::map          strokes;
   typedef std::vector<Texture> textures;
   
   void setStrokesColor(const GLfloat color[4]);
-  void addReadStroke(const stroke& s);
+  void addReadStroke(stroke& s);
+  void addIntersections(const strokes::handle h);
+  void eraseStroke(const strokes::handle h, const int window);
+  strokes::handle lastStroke();
+  void setClippingPlanes(const stroke& s);
+  void refitStroke(const stroke& s);
+  void cullStrokes(const Input& in);
   
   textures texs;
   strokes strks;
+  std::vector<strokes::handle> history; // Of the strokes, as added (undo)
+  stroke::graph intersections; // Of the strokes, by their boxes
+  stroke::tree boxes;          // Of the strokes, by their nodes
+  std::vector<int> hits;       // Scratch array of the tree queries
+  std::vector<stroke::tree::real> hit_params; // Entries of a segment in them
+  std::vector<stroke::tree::vec> grid; // Scratch vertices of a patch picked
+  Clipping_Planes planes;       // Of the strokes, by their nodes
+  std::vector<stroke*> visible; // Strokes of the frame, in drawing order
   
   GLuint background_tex_name;
   GLuint occluder_tex_name;
@@ -33,7 +48,8 @@ private:
   GLfloat background_color[4];
   
   bool accumulation;
-  strokes::iterator p_selected_stroke_prev;
+  strokes::handle selected;
+  unsigned int next_sequence; // Of the next stroke added
   int first_x, first_y, last_x, last_y;
   
 public:
@@ -43,11 +59,16 @@ public:
   Drawing();
   void setColor(const GLfloat color[4], const colortype type);
   void addTexture(const Texture& tex, const textype type);
-  void addStroke(const stroke& s);
+  void addStroke(stroke& s);
+  GLuint intersect(const GLdouble origin[3], const GLdouble direction[3],
+		   GLdouble& t);
+  bool pickStroke(const int x, const int y, Input& in, GLdouble t = 1.0);
   void markStroke(const Input& in);
   void unmarkStroke();
   void startMovingStroke(int x, int y);
+  void moveStroke(int x, int y, const Input& in);
   void stopMovingStroke(int x, int y, const Input& in);
+  void applyStrokeTransforms(const Input& in);
   void reverseStroke(const Input& in);
   void removeStroke(const Input& in);
   void clearStrokes(const Input& in);
@@ -59,10 +80,11 @@ public:
   bool write(const char* name) const;
   void paintBackground() const;
   void paintTransparentPlane() const;
-  void drawSelection() const;
-  void drawFeedback(const Input& in) const;
   void drawInformations(const Input& in);
   void draw(const Input& in);
+  int visibleStrokes() const;
+  int totalStrokes() const;
+  bool inDrawingOrder() const;
   
   GLfloat point_size;
   GLfloat line_width;
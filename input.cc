@@ -11,19 +11,23 @@ Input::Input()
     window_z_global(0.0), window_z_offset_global(0.0),//useful?
     window(0),
     window_z_first(0.0), window_z_offset_first(0.0),
-    window_z_last(0.0), window_z_offset_last(0.0) {
+    window_z_last(0.0), window_z_offset_last(0.0),
+    selected_name(DEFAULT_NAME), selected_winz(MAX_WINZ) {
   const int n = 100; // Magic number!
   vertices.reserve(n);
   positions.reserve(n);
-  object_tokens = std::vector<GLfloat>(2);
-  object_tokens[SCENE_INDEX]         = SCENE_TOKEN;
-  object_tokens[PROBA_SURFACE_INDEX] = PROBA_SURFACE_TOKEN;
 }
 
 void Input::setViewVector() {
   writeViewVector(mv_matrix, view_vector);
 }
 
+void Input::setUnprojector() {
+  if (!unprojector.setMatrices(mv_matrix, proj_matrix, viewport)) {
+    assert(false);
+  }
+}
+
 void Input::setPointColor(const GLfloat color[4]) {
   point_color[0] = color[0]; point_color[1] = color[1];
   point_color[2] = color[2]; point_color[3] = color[3];
@@ -82,241 +86,48 @@ void Input::setGlobalPlaneOffset(GLdouble offset) {
   window_z_offset_last  = window_z_offset_global;
 }
 
-/* Prints out the contents of the selection array */
-void printSelectionBuffer(const GLint size, const GLuint* buffer) {
-  GLuint names;
-  GLuint* ptr = const_cast<GLuint*>(buffer);
-  printf("\nNumber of hits: %d\n", size);
-  for (GLint i = 0; i < size; i++) { /* For each hit */
-    names = *ptr;
-    printf("Number of names for hit %d: %d\n", i, names); ptr++;
-    printf("z min is %u; ", *ptr); ptr++;
-    printf("z max is %u\n", *ptr); ptr++;
-    (names > 1) ? printf("The names are ") : printf("The name is ");
-    for (int j = 0; j < names; j++) { /* For each name */
-      printf("%d ", *ptr); ptr++;
-    }
-    printf("\n");
-  }
-}
-/* TODO:
-   . Convert z values to floating point number.
-*/
-
-/* Write contents of one vertex to stdout. */
-void print3DVertex(const GLint size, GLint* count, const GLfloat* buffer) {
-  printf("  ");
-  for (GLint i = 0; i < 3; i++) {
-    printf("%4.6f ", buffer[size-(*count)]);
-    *count = *count - 1;
-  }
-  printf ("\n");
-}
-
-/* Write contents of entire buffer. (Parse tokens!) */
-void printFeedbackBuffer(const GLint size, const GLfloat* buffer) {
-  GLint count;
-  GLfloat token;
-  count = size;
-  while (count) {
-    token = buffer[size-count];
-    count--;
-    if (token == GL_PASS_THROUGH_TOKEN) {
-      printf("GL_PASS_THROUGH_TOKEN\n");
-      printf("  %4.6f\n", buffer[size-count]);
-      count--;
-    }
-    else if (token == GL_LINE_TOKEN) {
-      printf("GL_LINE_TOKEN\n");
-      print3DVertex(size, &count, buffer);
-      print3DVertex(size, &count, buffer);
-    }
-    else if (token == GL_POLYGON_TOKEN) {
-      printf("GL_POLYGON_TOKEN\n");
-      GLfloat n = buffer[size-count];
-      count--;
-      printf("  %4.6f\n", n);
-      for (GLint i = 0; i < static_cast<GLint>(n); i++) {
-	print3DVertex(size, &count, buffer);
-      }
-    }
-  }
-}
-
-GLuint Input::parseSelectionBuffer(const GLint size, const GLuint* buffer) {
-  GLuint winz_min = DEFAULT_NAME; // Maximum unsigned int value
-  GLuint name = DEFAULT_NAME;
-  GLuint* ptr = const_cast<GLuint*>(buffer);
-  for (GLuint i = 0; i < size; i++) { // For each hit
-    GLuint names = *ptr;
-    ptr++;
-    GLuint winz_min_curr = *ptr;
-    ptr++; ptr++;
-    GLuint name_curr = DEFAULT_NAME;
-    for (GLuint j = 0; j < names; j++) { // For each name
-      name_curr = *ptr;
-      ptr++;
-    }
-    if (winz_min_curr < winz_min) {
-      winz_min = winz_min_curr;
-      name = name_curr;
-    }
-  }
-  return name;
-}
-
-void Input::parseFeedbackBuffer(const GLint size, const GLfloat* buffer) {
-  GLint count;
-  GLfloat token, object_token, object_number_token;
-  count = size;
-  while (count) {
-    token = buffer[size-count];
-    count--;
-    if (token == GL_PASS_THROUGH_TOKEN) {
-      GLfloat pass_through_token = buffer[size-count];
-      if (pass_through_token < 0.0) {
-	object_token = pass_through_token;
-      }
-      else {
-	object_number_token = pass_through_token;
-      }
-      count--;
-    }
-    else if (token == GL_LINE_TOKEN) {
-      GLfloat mean_winz = 0.0;
-      for (GLint i = 0; i < 2; i++) {
-	count -= 2;
-	mean_winz += buffer[size-count];
-	count--;
-      }
-      mean_winz *= 0.5;
-      if (mean_winz < results[object_token][OBJECT_WINZ]) {
-	results[object_token][OBJECT_NUMBER] = object_number_token;
-	results[object_token][OBJECT_WINZ]   = mean_winz;
-      }
-    }
-    else if (token == GL_POLYGON_TOKEN) {
-      GLint n = static_cast<GLint>(buffer[size-count]);
-      count--;
-      GLfloat mean_winz = 0.0;
-      for (GLint i = 0; i < n; i++) {
-	count -= 2;
-	mean_winz += buffer[size-count];
-	count--;
-      }
-      mean_winz /= n;
-      if (mean_winz < results[object_token][OBJECT_WINZ]) {
-	results[object_token][OBJECT_NUMBER] = object_number_token;
-	results[object_token][OBJECT_WINZ]   = mean_winz;
-      }
-    }
-  }
-}
-
-void Input::processFeedbackResults(const GLint size, const GLfloat* buffer) {
-  /* Init results map */
-  const GLfloat default_number = 0.0; // Default object number
-  for (int i = SCENE_INDEX; i < PROBA_SURFACE_INDEX + 1; i++) {
-    results[object_tokens[i]] = Vec2<GLfloat>(default_number, MAX_WINZ);
-  }
-  
-  /* Parse */
-  parseFeedbackBuffer(size, buffer);
+/*
+ *  selectStroke :
+ *  Stroke picked under the cursor, with the point hit (in global
+ *  coordinates) and its window depth, DEFAULT_NAME if none.
+ */
+bool Input::selectStroke(const GLuint name, const GLdouble point[3],
+			 const GLdouble winz) {
+  selected_name = name;
+  selected_point = vec3(point[0], point[1], point[2]);
+  selected_winz = winz;
 #if DEBUG
-  printFeedbackBuffer(size, buffer);
-  cerr << "Results:" << endl;
-  std::map< GLfloat, Vec2<GLfloat> >::const_iterator pm;
-  for (pm = results.begin(); pm != results.end(); pm++) {
-    cerr << (*pm).first << " " << (*pm).second << endl;
-  }
-#endif
-  
-  /* Analyze */
-  nearer_token = SCENE_TOKEN;
-  nearer_winz  = MAX_WINZ;
-  std::map< GLfloat, Vec2<GLfloat> >::const_iterator p;
-  for (p = results.begin(); p != results.end(); p++) {
-    const GLfloat winz = (*p).second[OBJECT_WINZ];
-    if (winz < MAX_WINZ) {
-      nearer_token = (*p).first;
-      nearer_winz = winz;
-    }
-  }
-}
-
-bool Input::selectStroke(const GLint size, const GLuint* buffer) {
-  bool is_selected;
-  if (size == 0) {
-    is_selected = false;
-  }
-  else {
-    selected_name = parseSelectionBuffer(size, buffer);
-#if DEBUG
-    printSelectionBuffer(size, buffer);
-    cerr << "Selected name: " << selected_name << endl << endl;
+  cerr << "Selected name: " << selected_name << endl << endl;
 #endif
-    if (selected_name == DEFAULT_NAME) {
-      is_selected = false;
-    }
-    else {
-      is_selected = true;
-    }
-  }
-  return is_selected;
+  return selected_name != DEFAULT_NAME;
 }
 
-void Input::setPlanes(const GLint size_first, const GLfloat* buffer_first,
-		      const GLint size_last, const GLfloat* buffer_last) {
+/*
+ *  setPlanes :
+ *  Depths of the first and last points of the input in local plane mode,
+ *  from the nearest objects under them (NO_INDEX if none, SCENE_INDEX or
+ *  PROBA_SURFACE_INDEX) and their window depths.
+ */
+void Input::setPlanes(const int object_first, const GLdouble winz_first,
+		      const int object_last, const GLdouble winz_last) {
   if (local_plane) {
-    if (size_first == 0) {
+    if (object_first == NO_INDEX) {
       // Stay at the same depth as previous stroke (if trackball doesn't move!)
       projection_mode = FOLLOW;
     }
     else {
-      processFeedbackResults(size_first, buffer_first);
-      
-      /* Determine projection plane */
-      if (nearer_winz == MAX_WINZ) {
-	// Idem
-	projection_mode = FOLLOW;
-      }
-      else {
-	if (nearer_token == SCENE_TOKEN) {
-	  window_z_first        = nearer_winz;
-	  window_z_offset_first = 0.0;
-	  projection_mode = SPLAT;
-	}
-        else if (nearer_token == PROBA_SURFACE_TOKEN) {
-	  window_z_first        = nearer_winz;
-	  window_z_offset_first = 0.0;
-	  projection_mode = SPLAT;
-	}
-      }
+      window_z_first        = winz_first;
+      window_z_offset_first = 0.0;
+      projection_mode = SPLAT;
     }
-    if (size_last == 0) {
+    if (object_last == NO_INDEX) {
       window_z_last        = window_z_first;
       window_z_offset_last = window_z_offset_first;
     }
     else {
-      processFeedbackResults(size_last, buffer_last);
-      
-      /* Determine projection plane */
-      if (nearer_winz == MAX_WINZ) {
-	window_z_last        = window_z_first;
-        window_z_offset_last = window_z_offset_first;
-      }
-      else {
-	if (nearer_token == SCENE_TOKEN) {
-	  window_z_last        = nearer_winz;
-	  window_z_offset_last = 0.0;
-	  projection_mode = BRIDGE;
-	}
-        else if (nearer_token == PROBA_SURFACE_TOKEN) {
-	  window_z_last        = nearer_winz;
-	  window_z_offset_last = 0.0;
-	  projection_mode = BRIDGE;
-	}
-      }
+      window_z_last        = winz_last;
+      window_z_offset_last = 0.0;
+      projection_mode = BRIDGE;
     }
   }
   else {
@@ -366,11 +177,10 @@ bool Input::addPoint2D(const GLint x, const GLint y) {
 void Input::addPoint(const GLint x, const GLint y) {
   if (addPoint2D(x, y)) {
     GLdouble objx, objy, objz;
-    if (gluUnProject(static_cast<GLdouble>(x),
-		     static_cast<GLdouble>(viewport[3] - 1 - y),
-		     0.05, /* Magic number! */
-		     mv_matrix, proj_matrix, viewport,
-		     &objx, &objy, &objz)) {
+    if (unprojector.unproject(static_cast<GLdouble>(x),
+			      static_cast<GLdouble>(viewport[3] - 1 - y),
+			      0.05, /* Magic number! */
+			      &objx, &objy, &objz)) {
       vertices.push_back(vec3(objx, objy, objz));
     }
     else {
@@ -379,6 +189,56 @@ void Input::addPoint(const GLint x, const GLint y) {
   }
 }
 
+/*
+ *  segment :
+ *  Segment through pixel (x, y) of the window (from the top), from the near
+ *  plane to the far plane, in global coordinates: the segment goes from
+ *  origin to origin + direction.
+ */
+void Input::segment(const GLint x, const GLint y, GLdouble origin[3],
+		    GLdouble direction[3]) const {
+  const GLdouble winx = static_cast<GLdouble>(x);
+  const GLdouble winy = static_cast<GLdouble>(viewport[3] - 1 - y);
+  const GLdouble wins[6] = {winx, winy, 0.0, winx, winy, 1.0};
+  GLdouble objs[6];
+  if (!unprojector.unproject(2, wins, objs)) {
+    assert(false);
+  }
+  for (int i = 0; i < 3; i++) {
+    origin[i] = objs[i];
+    direction[i] = objs[3 + i] - objs[i];
+  }
+}
+
+/*
+ *  depth :
+ *  Window depth of a point in global coordinates.
+ */
+GLdouble Input::depth(const GLdouble point[3]) const {
+  GLdouble m[16];
+  multMM(proj_matrix, mv_matrix, m);
+  const GLdouble z = m[2]*point[0] + m[6]*point[1] + m[10]*point[2] + m[14];
+  const GLdouble w = m[3]*point[0] + m[7]*point[1] + m[11]*point[2] + m[15];
+  return 0.5*(z/w + 1.0);
+}
+
+/*
+ *  frustum :
+ *  Planes of the view frustum in global coordinates, left, right, bottom,
+ *  top, near and far, facing inside: a point p is inside if
+ *  a*p[0] + b*p[1] + c*p[2] + d >= 0 for all of them.
+ */
+void Input::frustum(GLdouble planes[6][4]) const {
+  GLdouble m[16];
+  multMM(proj_matrix, mv_matrix, m);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 4; j++) {
+      planes[2*i    ][j] = m[4*j + 3] + m[4*j + i];
+      planes[2*i + 1][j] = m[4*j + 3] - m[4*j + i];
+    }
+  }
+}
+
 GLdouble Input::getFirstPlane() const {
   return window_z_first + window_z_offset_first;
 }
@@ -391,6 +251,14 @@ GLuint Input::selectedStrokeID() const {
   return selected_name;
 }
 
+const Input::vec3& Input::selectedPoint() const {
+  return selected_point;
+}
+
+GLdouble Input::selectedDepth() const {
+  return selected_winz;
+}
+
 int Input::projectionMode() const {
   return projection_mode;
 }
@@ -3,10 +3,10 @@
 
 #include <fstream>
 #include <vector>
-#include <map>
 #include <GL/glut.h>
 #include "vec3.h"
 #include "opengl_utils.h"
+#include "unprojector.h"
 #include "point.h"
 
 class Input {
@@ -15,12 +15,6 @@ private:
   typedef Vec2<real>        vec2;
   typedef Point<real, vec2> point;
   typedef Vec3<real>        vec3;
-  enum objecttokens {SCENE_TOKEN = -2, PROBA_SURFACE_TOKEN = -1};
-  enum objectdata   {OBJECT_NUMBER, OBJECT_WINZ};
-  
-  void parseFeedbackBuffer(const GLint size, const GLfloat* buffer);
-  void processFeedbackResults(const GLint size, const GLfloat* buffer);
-  GLuint parseSelectionBuffer(const GLint size, const GLuint* buffer);
   
   std::vector<vec3> vertices;
   bool local_plane;
@@ -31,32 +25,40 @@ private:
   int projection_mode;
   GLfloat point_color[4];
   
-  std::map< GLfloat, Vec2<GLfloat> > results; // Feedback results
-  GLfloat nearer_token, nearer_winz;
   GLuint selected_name;                       // Selection results
+  vec3 selected_point;
+  GLdouble selected_winz;
   
   // Minimum distance between positions (in pixels)
   static const real npixels_min;
   static const GLfloat MAX_WINZ; // Default depth
   
 public:
-  enum objectindices {SCENE_INDEX, PROBA_SURFACE_INDEX};
+  enum objectindices {NO_INDEX = -1, SCENE_INDEX, PROBA_SURFACE_INDEX};
   enum projectionmode {FOLLOW, SPLAT, BRIDGE};
   
   Input();
   void setViewVector();
+  void setUnprojector();
   void setPointColor(const GLfloat color[4]);
   void setLocalPlaneMode(bool choice = true);
   void setGlobalPlane();
   void setGlobalPlaneOffset(GLdouble offset);
-  bool selectStroke(const GLint size, const GLuint* buffer);
-  void setPlanes(const GLint size_first, const GLfloat* buffer_first,
-		 const GLint size_last, const GLfloat* buffer_last);
+  bool selectStroke(const GLuint name, const GLdouble point[3],
+		    const GLdouble winz);
+  void setPlanes(const int object_first, const GLdouble winz_first,
+		 const int object_last, const GLdouble winz_last);
+  void segment(const GLint x, const GLint y, GLdouble origin[3],
+	       GLdouble direction[3]) const;
+  GLdouble depth(const GLdouble point[3]) const;
+  void frustum(GLdouble planes[6][4]) const;
   bool addPoint2D(const GLint x, const GLint y);
   void addPoint(const GLint x, const GLint y);
   GLdouble getFirstPlane() const;
   GLdouble getLastPlane() const;
   GLuint selectedStrokeID() const;
+  const vec3& selectedPoint() const;
+  GLdouble selectedDepth() const;
   int projectionMode() const;
   bool read(const char* name);
   bool write(const char* name) const;
@@ -70,8 +72,7 @@ public:
   GLdouble fovy, aspect, near, far;
   GLdouble mv_matrix[16], proj_matrix[16];
   vec3 view_vector;
-  
-  std::vector<GLfloat> object_tokens;
+  Unprojector unprojector; // Follows the matrices and viewport above
   
   GLfloat point_size;
   
@@ -0,0 +1,234 @@
+#ifndef INTERSECTION_GRAPH_H
+#define INTERSECTION_GRAPH_H
+
+#include <cassert>
+#include <vector>
+
+/*
+ *  Undirected graph of objects intersecting each other, as the strokes of
+ *  a drawing. Nodes are small integers, valid until removed (they are
+ *  reused after that), each holding a value of type T. Each node has an
+ *  array of its edges, and each edge knows the position of its twin in the
+ *  array of the other node: an edge is removed in constant time by moving
+ *  the last edge of both arrays in its place, and a node in time linear in
+ *  its degree.
+ */
+template <class T>
+class Intersection_Graph {
+public:
+  typedef int node;
+  enum {NO_NODE = -1};
+
+  Intersection_Graph();
+  node addNode(const T& value);
+  void removeNode(const node n);
+  void addEdge(const node a, const node b);
+  void removeEdge(const node a, const int i);
+  void clear();
+  bool contains(const node n) const;
+  int degree(const node n) const;
+  node neighbour(const node n, const int i) const;
+  const T& value(const node n) const;
+  int nodes() const;
+  int edges() const;
+  bool valid() const;
+
+private:
+  struct Edge {
+    node n;   // Other end
+    int twin; // Position of the same edge in the array of n
+  };
+  typedef std::vector<Edge> edges_array;
+
+  void removeHalfEdge(const node n, const int i);
+
+  std::vector<edges_array> adjacency;
+  std::vector<T> values;
+  std::vector<bool> used;
+  std::vector<node> free_nodes;
+  int nnodes;
+  int nedges;
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+template <class T>
+inline Intersection_Graph<T>::
+Intersection_Graph()
+  : nnodes(0), nedges(0) {}
+
+/*
+ *  addNode :
+ *  New node, without edges, storing value.
+ */
+template <class T>
+inline typename Intersection_Graph<T>::node Intersection_Graph<T>::
+addNode(const T& value) {
+  node n;
+  if (free_nodes.empty()) {
+    n = adjacency.size();
+    adjacency.push_back(edges_array());
+    values.push_back(value);
+    used.push_back(true);
+  }
+  else {
+    n = free_nodes.back();
+    free_nodes.pop_back();
+    values[n] = value;
+    used[n] = true;
+  }
+  nnodes++;
+  return n;
+}
+
+/*
+ *  removeNode :
+ *  Removal of a node and of its edges, the last first so that nothing
+ *  moves in its array.
+ */
+template <class T>
+inline void Intersection_Graph<T>::
+removeNode(const node n) {
+  assert(contains(n));
+  while (!adjacency[n].empty()) {
+    removeEdge(n, adjacency[n].size() - 1);
+  }
+  used[n] = false;
+  free_nodes.push_back(n);
+  nnodes--;
+}
+
+/*
+ *  addEdge :
+ *  Edge between two different nodes, not already linked.
+ */
+template <class T>
+inline void Intersection_Graph<T>::
+addEdge(const node a, const node b) {
+  assert(contains(a) && contains(b) && a != b);
+  Edge e_a, e_b;
+  e_a.n = b;
+  e_a.twin = adjacency[b].size();
+  e_b.n = a;
+  e_b.twin = adjacency[a].size();
+  adjacency[a].push_back(e_a);
+  adjacency[b].push_back(e_b);
+  nedges++;
+}
+
+/*
+ *  removeEdge :
+ *  Removal of the i-th edge of node a. The last edges of both ends take
+ *  the places of the removed ones.
+ */
+template <class T>
+inline void Intersection_Graph<T>::
+removeEdge(const node a, const int i) {
+  assert(contains(a) && i >= 0 && i < adjacency[a].size());
+  const Edge e = adjacency[a][i];
+  removeHalfEdge(e.n, e.twin);
+  removeHalfEdge(a, i);
+  nedges--;
+}
+
+template <class T>
+inline void Intersection_Graph<T>::
+removeHalfEdge(const node n, const int i) {
+  edges_array& es = adjacency[n];
+  const int last = es.size() - 1;
+  if (i != last) {
+    es[i] = es[last];
+    adjacency[es[i].n][es[i].twin].twin = i;
+  }
+  es.pop_back();
+}
+
+/*
+ *  clear :
+ *  Removal of all the nodes. Arrays keep their memory for the next nodes.
+ */
+template <class T>
+inline void Intersection_Graph<T>::
+clear() {
+  free_nodes.clear();
+  for (node n = adjacency.size() - 1; n >= 0; n--) {
+    adjacency[n].clear();
+    used[n] = false;
+    free_nodes.push_back(n);
+  }
+  nnodes = 0;
+  nedges = 0;
+}
+
+template <class T>
+inline bool Intersection_Graph<T>::
+contains(const node n) const {
+  return n >= 0 && n < used.size() && used[n];
+}
+
+template <class T>
+inline int Intersection_Graph<T>::
+degree(const node n) const {
+  assert(contains(n));
+  return adjacency[n].size();
+}
+
+template <class T>
+inline typename Intersection_Graph<T>::node Intersection_Graph<T>::
+neighbour(const node n, const int i) const {
+  return adjacency[n][i].n;
+}
+
+template <class T>
+inline const T& Intersection_Graph<T>::
+value(const node n) const {
+  assert(contains(n));
+  return values[n];
+}
+
+template <class T>
+inline int Intersection_Graph<T>::
+nodes() const {
+  return nnodes;
+}
+
+template <class T>
+inline int Intersection_Graph<T>::
+edges() const {
+  return nedges;
+}
+
+/*
+ *  valid :
+ *  True if every edge links two nodes in use and is the twin of its twin,
+ *  and if the counts agree (for tests).
+ */
+template <class T>
+inline bool Intersection_Graph<T>::
+valid() const {
+  int n_used = 0, n_half_edges = 0;
+  for (node n = 0; n < adjacency.size(); n++) {
+    if (!used[n]) {
+      if (!adjacency[n].empty()) {
+	return false;
+      }
+      continue;
+    }
+    n_used++;
+    n_half_edges += adjacency[n].size();
+    for (int i = 0; i < adjacency[n].size(); i++) {
+      const Edge& e = adjacency[n][i];
+      if (!contains(e.n) || e.n == n ||
+	  e.twin < 0 || e.twin >= adjacency[e.n].size() ||
+	  adjacency[e.n][e.twin].n != n || adjacency[e.n][e.twin].twin != i) {
+	return false;
+      }
+    }
+  }
+  return n_used == nnodes && n_half_edges == 2*nedges &&
+    n_used + free_nodes.size() == adjacency.size();
+}
+
+#endif // INTERSECTION_GRAPH_H
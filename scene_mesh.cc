@@ -0,0 +1,127 @@
+#include "scene_mesh.h"
+
+Scene_Mesh::Scene_Mesh() {}
+
+/*
+ *  capture :
+ *  Triangles of a display list, all of those within radius of the origin
+ *  (the others are clipped), read back from a feedback buffer that grows
+ *  until they fit.
+ */
+void Scene_Mesh::capture(const GLuint list, const real radius) {
+  clear();
+  glPushAttrib(GL_ENABLE_BIT | GL_VIEWPORT_BIT | GL_TRANSFORM_BIT |
+	       GL_POLYGON_BIT);
+  glDisable(GL_CULL_FACE);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glViewport(0, 0, 2, 2); // Window coordinates from 0 to 2
+  glDepthRange(0.0, 1.0);
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  glOrtho(-radius, radius, -radius, radius, -radius, radius);
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  
+  std::vector<GLfloat> buffer(1 << 16); // Magic number!
+  GLint size;
+  for (;;) {
+    glFeedbackBuffer(buffer.size(), GL_3D, &buffer[0]);
+    static_cast<GLvoid>(glRenderMode(GL_FEEDBACK));
+    glCallList(list);
+    size = glRenderMode(GL_RENDER);
+    if (size >= 0) {
+      break;
+    }
+    buffer.resize(2*buffer.size()); // Overflow
+  }
+  
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glPopMatrix();
+  glPopAttrib();
+  
+  /* Parse */
+  GLint i = 0;
+  while (i < size) {
+    const GLfloat token = buffer[i++];
+    if (token == GL_POLYGON_TOKEN) {
+      const int n = static_cast<int>(buffer[i++]);
+      addPolygon(n, &buffer[i], radius);
+      i += 3*n;
+    }
+    else if (token == GL_LINE_TOKEN || token == GL_LINE_RESET_TOKEN) {
+      i += 6;
+    }
+    else if (token == GL_POINT_TOKEN || token == GL_BITMAP_TOKEN ||
+	     token == GL_DRAW_PIXEL_TOKEN || token == GL_COPY_PIXEL_TOKEN) {
+      i += 3;
+    }
+    else if (token == GL_PASS_THROUGH_TOKEN) {
+      i += 1;
+    }
+    else {
+      assert(false);
+    }
+  }
+  
+  /* Tree */
+  const int n = triangles();
+  std::vector<int> items(n);
+  std::vector<box> triangle_boxes(n);
+  for (int k = 0; k < n; k++) {
+    items[k] = k;
+    triangle_boxes[k] = box(vertices[3*k], vertices[3*k]);
+    triangle_boxes[k].insert(vertices[3*k + 1]);
+    triangle_boxes[k].insert(vertices[3*k + 2]);
+  }
+  boxes.build(n, n > 0 ? &items[0] : 0, n > 0 ? &triangle_boxes[0] : 0);
+}
+
+/*
+ *  addPolygon :
+ *  Fan of triangles of a polygon of n vertices given in window coordinates
+ *  (three per vertex), back in object coordinates.
+ */
+void Scene_Mesh::addPolygon(const int n, const GLfloat* v,
+			    const real radius) {
+  std::vector<vec3> polygon(n);
+  for (int k = 0; k < n; k++, v += 3) {
+    polygon[k] = vec3((v[0] - 1.0)*radius, (v[1] - 1.0)*radius,
+		      (1.0 - 2.0*v[2])*radius);
+  }
+  for (int k = 1; k + 1 < n; k++) {
+    vertices.push_back(polygon[0]);
+    vertices.push_back(polygon[k]);
+    vertices.push_back(polygon[k + 1]);
+  }
+}
+
+void Scene_Mesh::clear() {
+  vertices.clear();
+  boxes.clear();
+}
+
+/*
+ *  intersect :
+ *  Parameter t of the first point where the segment from origin to
+ *  origin + direction crosses a triangle, if it is before t. Only the
+ *  triangles whose boxes the segment crosses are tested.
+ */
+bool Scene_Mesh::intersect(const real origin[3], const real direction[3],
+			   real& t) const {
+  const vec3 o(origin[0], origin[1], origin[2]);
+  const vec3 d(direction[0], direction[1], direction[2]);
+  hits.clear();
+  boxes.query(o, d, hits);
+  bool hit = false;
+  for (int i = 0; i < hits.size(); i++) {
+    const vec3* v = &vertices[3*hits[i]];
+    if (intersectTriangle(o, d, v[0], v[1], v[2], t)) {
+      hit = true;
+    }
+  }
+  return hit;
+}
@@ -0,0 +1,48 @@
+#ifndef SCENE_MESH_H
+#define SCENE_MESH_H
+
+#include <vector>
+#include <GL/gl.h>
+#include <aabb.h>
+#include "triangle.h"
+
+/*
+ *  Triangles of a scene model, read back once from its display list in
+ *  GL_FEEDBACK mode (object coordinates, through an orthographic camera
+ *  around the origin), and kept in an AABB tree, so that the model is
+ *  probed by segments on the CPU instead of being rendered again for each
+ *  pick. Polygons are split into fans of triangles, points, lines and
+ *  bitmaps are ignored.
+ */
+class Scene_Mesh {
+public:
+  typedef GLdouble          real;
+  typedef Vec3<real>        vec3;
+  typedef AABB<real, vec3>  box;
+  typedef AABB_Tree<real, vec3> tree;
+  
+  Scene_Mesh();
+  void capture(const GLuint list, const real radius);
+  void clear();
+  bool intersect(const real origin[3], const real direction[3],
+		 real& t) const;
+  int triangles() const;
+  
+private:
+  void addPolygon(const int n, const GLfloat* v, const real radius);
+  
+  std::vector<vec3> vertices; // Three per triangle
+  tree boxes;                 // Of the triangles
+  mutable std::vector<int> hits; // Scratch array of the tree queries
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+inline int Scene_Mesh::
+triangles() const {
+  return vertices.size()/3;
+}
+
+#endif // SCENE_MESH_H
@@ -0,0 +1,259 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cassert>
+#include <vector>
+
+/*
+ *  Objects of type T, as the strokes of a drawing, stored contiguously and
+ *  named by handles. A handle packs the index of a slot and the generation
+ *  of that slot, which changes each time its object is removed: a handle
+ *  of a removed object is never valid again, even if its slot is reused (a
+ *  slot whose generation would wrap around is retired instead). Each slot
+ *  gives the position of its object in the dense array, and each position
+ *  its slot, so that lookup is constant time, as is removal, which moves
+ *  the last object in the place of the removed one. Iteration goes over
+ *  the dense array, in insertion order until an object is removed.
+ *  Objects are handed over by swap (T has a default constructor and a swap
+ *  method), including when the array grows, and are never copied.
+ */
+template <class T>
+class Slot_Map {
+public:
+  typedef unsigned int handle;
+  typedef typename std::vector<T>::iterator iterator;
+  typedef typename std::vector<T>::const_iterator const_iterator;
+  enum {SLOT_BITS = 20}; // Of a handle, the others for the generation
+  static const handle NO_HANDLE = ~0u;
+
+  Slot_Map();
+  handle insert(T& value);
+  void remove(const handle h);
+  void clear();
+  bool contains(const handle h) const;
+  T& operator[](const handle h);
+  const T& operator[](const handle h) const;
+  handle handleAt(const int i) const;
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+  int size() const;
+  bool empty() const;
+  bool valid() const;
+
+private:
+  struct Slot {
+    int index;         // In the dense array, if in use
+    handle generation; // Shifted, as in the handles of the slot
+  };
+  enum {GENERATION_STEP = 1 << SLOT_BITS,
+	SLOT_MASK = GENERATION_STEP - 1,
+	MAX_SLOTS = SLOT_MASK}; // Slot SLOT_MASK would give NO_HANDLE
+  static const handle LAST_GENERATION = ~handle(SLOT_MASK);
+
+  void grow();
+
+  std::vector<T> values;
+  std::vector<int> slots_of; // Slots of the values
+  std::vector<Slot> slots;
+  std::vector<bool> used;
+  std::vector<int> free_slots;
+  int retired; // Slots of the last generation, never used again
+};
+
+template <class T>
+const typename Slot_Map<T>::handle Slot_Map<T>::NO_HANDLE;
+
+template <class T>
+const typename Slot_Map<T>::handle Slot_Map<T>::LAST_GENERATION;
+
+/*
+ *  Definition of inlined methods
+ */
+
+template <class T>
+inline Slot_Map<T>::
+Slot_Map()
+  : retired(0) {}
+
+/*
+ *  insert :
+ *  New object, taken over from value (left as the default object), and its
+ *  handle.
+ */
+template <class T>
+inline typename Slot_Map<T>::handle Slot_Map<T>::
+insert(T& value) {
+  int s;
+  if (free_slots.empty()) {
+    assert(slots.size() < MAX_SLOTS);
+    s = slots.size();
+    Slot slot;
+    slot.generation = 0;
+    slots.push_back(slot);
+    used.push_back(true);
+  }
+  else {
+    s = free_slots.back();
+    free_slots.pop_back();
+    used[s] = true;
+  }
+  if (values.size() == values.capacity()) {
+    grow();
+  }
+  slots[s].index = values.size();
+  values.push_back(T());
+  values.back().swap(value);
+  slots_of.push_back(s);
+  return slots[s].generation | s;
+}
+
+/*
+ *  remove :
+ *  Removal of an object, the last one of the array taking its place. Its
+ *  slot gets the next generation, or is retired after the last one.
+ */
+template <class T>
+inline void Slot_Map<T>::
+remove(const handle h) {
+  assert(contains(h));
+  const int s = h & SLOT_MASK;
+  const int i = slots[s].index;
+  const int last = values.size() - 1;
+  if (i != last) {
+    values[i].swap(values[last]);
+    slots_of[i] = slots_of[last];
+    slots[slots_of[i]].index = i;
+  }
+  values.pop_back();
+  slots_of.pop_back();
+  used[s] = false;
+  if (slots[s].generation == LAST_GENERATION) {
+    retired++;
+    return;
+  }
+  slots[s].generation += GENERATION_STEP;
+  free_slots.push_back(s);
+}
+
+/*
+ *  clear :
+ *  Removal of all the objects. Handles given before stay invalid.
+ */
+template <class T>
+inline void Slot_Map<T>::
+clear() {
+  while (!values.empty()) {
+    remove(handleAt(values.size() - 1));
+  }
+}
+
+template <class T>
+inline bool Slot_Map<T>::
+contains(const handle h) const {
+  const int s = h & SLOT_MASK;
+  return h != NO_HANDLE && s < slots.size() && used[s] &&
+    slots[s].generation == (h & ~handle(SLOT_MASK));
+}
+
+template <class T>
+inline T& Slot_Map<T>::
+operator[](const handle h) {
+  assert(contains(h));
+  return values[slots[h & SLOT_MASK].index];
+}
+
+template <class T>
+inline const T& Slot_Map<T>::
+operator[](const handle h) const {
+  assert(contains(h));
+  return values[slots[h & SLOT_MASK].index];
+}
+
+/*
+ *  handleAt :
+ *  Handle of the object at position i of the dense array.
+ */
+template <class T>
+inline typename Slot_Map<T>::handle Slot_Map<T>::
+handleAt(const int i) const {
+  const int s = slots_of[i];
+  return slots[s].generation | s;
+}
+
+template <class T>
+inline typename Slot_Map<T>::iterator Slot_Map<T>::
+begin() {
+  return values.begin();
+}
+
+template <class T>
+inline typename Slot_Map<T>::iterator Slot_Map<T>::
+end() {
+  return values.end();
+}
+
+template <class T>
+inline typename Slot_Map<T>::const_iterator Slot_Map<T>::
+begin() const {
+  return values.begin();
+}
+
+template <class T>
+inline typename Slot_Map<T>::const_iterator Slot_Map<T>::
+end() const {
+  return values.end();
+}
+
+template <class T>
+inline int Slot_Map<T>::
+size() const {
+  return values.size();
+}
+
+template <class T>
+inline bool Slot_Map<T>::
+empty() const {
+  return values.empty();
+}
+
+/*
+ *  valid :
+ *  True if slots and positions agree both ways, and if the counts agree
+ *  (for tests).
+ */
+template <class T>
+inline bool Slot_Map<T>::
+valid() const {
+  if (slots_of.size() != values.size() ||
+      values.size() + free_slots.size() + retired != slots.size()) {
+    return false;
+  }
+  for (int i = 0; i < values.size(); i++) {
+    const int s = slots_of[i];
+    if (s < 0 || s >= slots.size() || !used[s] || slots[s].index != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ *  grow :
+ *  Twice the capacity, the objects being swapped to the new array instead
+ *  of copied.
+ */
+template <class T>
+inline void Slot_Map<T>::
+grow() {
+  std::vector<T> grown;
+  grown.reserve(values.empty() ? 16 : 2*values.size()); // Magic number!
+  grown.resize(values.size());
+  for (int i = 0; i < values.size(); i++) {
+    grown[i].swap(values[i]);
+  }
+  values.swap(grown);
+}
+
+#endif // SLOT_MAP_H
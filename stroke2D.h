@@ -3,46 +3,22 @@
 
 #include "input.h"
 #include "bezier.h"
+#include "stream_fitter.h"
+#include "parallel_fitter.h"
 
 class Stroke2D {
 public:
   typedef GLdouble                      real;
   typedef Vec2<real>                    vec2;
-  typedef Bezier_Augmented<real, vec2>  bezier;
+  typedef Bezier_Augmented<real, vec2, 3> bezier;
   typedef std::vector<bezier>           beziers;
 private:
   typedef Point<real, vec2>             point;
   typedef std::vector<point>            points;
   
-  /*
-   *  Main source of inspiration for Bezier fitting:
-   *  An Algorithm for Automatically Fitting Digitized Curves
-   *  by Philip J. Schneider
-   *  from Graphics Gems, Academic Press, 1990.
-   */
-  void fitCurve(const points::iterator first, const points::iterator last,
-		real error);
-  void fitCubic(const points::iterator first, const points::iterator last,
-		const vec2& tanv1, const vec2& tanv2, real error);
-  void generateBezier(const points::const_iterator first,
-		      const points::const_iterator last,
-	              const vec2& tanv1, const vec2& tanv2, bezier& b);
-  void findNewtonRaphsonRoot(bezier& Q, point& P);
-  void computeMaxError(const points::iterator first,
-		       const points::iterator last, bezier& b,
-		       points::iterator& split, real* maxError);
-  vec2 leftTangent(const points::const_iterator p,
-		   const points::difference_type npoints);
-  vec2 rightTangent(const points::const_iterator p,
-		    const points::difference_type npoints);
-  vec2 centerTangent(const points::const_iterator p);
-  void chordLengthParameterize(const points::iterator first,
-			       const points::iterator last);
-  void reparameterize(const points::iterator first,
-		      const points::iterator last, bezier& b);
-  
   /* Misc */
-  void fit(Input& in, const real error);
+  void fit(Input& in, const real error, Decimator* dec);
+  void evalProperties();
   void evalLength();
   bool testLength(const beziers::difference_type nb_first, const real t_first,
 		  const beziers::difference_type nb_last, const real t_last);
@@ -53,6 +29,8 @@ private:
 		      const real t_last, vec2& min, vec2& max);
   
   static const real steps_per_unit_length;
+  static std::vector<int> corners; // First and last points of the spans
+  static points kept;              // Points kept by the decimator
   
 #if TEST_STROKE2D
 public:
@@ -61,7 +39,8 @@ public:
   
 public:
   Stroke2D();
-  Stroke2D(Input& in, const real error = 4.0);
+  Stroke2D(Input& in, const real error = 4.0, Decimator* dec = 0);
+  Stroke2D(Input& in, Stream_Fitter& sf);
   void read(std::ifstream& file_in);
   void write(std::ofstream& file_out) const;
   bool empty() const;
@@ -74,6 +53,9 @@ public:
   beziers bs;
   real length;
   std::vector<real> relative_lengths;
+  
+  // Fitting engine, whose workspace is shared by all strokes
+  static Parallel_Fitter fitter;
 };
 
 #endif // STROKE2D_H
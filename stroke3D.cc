@@ -1,94 +1,160 @@
+#include <algorithm>
 #include "stroke3D.h"
 
 using namespace std;
 
+/*
+ *  computeBezierSurface :
+ *  Patches computed in place, so that the surface of a stroke whose curves
+ *  changed but kept their degrees is not allocated again, and the boxes of
+ *  their control points.
+ */
 void Stroke3D::computeBezierSurface() {
-  /* Compute two cubic beziers */
-  beziers_simples b_plus_psang;
-  beziers_simples b_minus_psang;
-  b_plus_psang.reserve(bs.size());
-  b_minus_psang.reserve(bs.size());
-  for (beziers::const_iterator p = bs.begin(); p != bs.end(); p++) {
-    const int degree = (*p).C.size() - 1; // Optimization needed?
-    bezier_simple bez_plus_psang(degree);
-    bezier_simple bez_minus_psang(degree);
-    for (int i = 0; i < degree + 1; i++) {
-      bezier::vec  C = (*p).C[i];
-      bezier::real R = (*p).R[i];
-      bezier::vec  N = (*p).N[i];
-      bez_plus_psang.V[i]  = C + R*(cos_psang*N + sin_psang*plane_normal);
-      bez_minus_psang.V[i] = C + R*(cos_psang*N - sin_psang*plane_normal);
-    }
-    b_plus_psang.push_back(bez_plus_psang);
-    b_minus_psang.push_back(bez_minus_psang);
-  }
-  
-  /* Compute bezier surface */
+  proba_surface.resize(bs.size());
   beziers::const_iterator p = bs.begin();
-  beziers_simples::const_iterator p_plus  = b_plus_psang.begin();
-  beziers_simples::const_iterator p_minus = b_minus_psang.begin();
-  for (; p != bs.end(); p++, p_plus++, p_minus++) {
-    bezier_surface bez_surf;
-    bez_surf.V = (*p_plus).V;
-    
-    // Compute circle arcs as quadratic bezier curves
-    beziers_simples circles;
-    circles.reserve((*p).V.size());
-    for (int i = 0; i < (*p).C.size(); i++) {
-      bezier_simple circle(2);
+  beziers_surfaces::iterator ps = proba_surface.begin();
+  for (; p != bs.end(); p++, ps++) {
+    /* Two cubic beziers (first and last rows), joined by circle arcs
+       computed as quadratic bezier curves (middle row) */
+    const int order = (*p).C.size();
+    (*ps).V.resize(3*order);
+    for (int i = 0; i < order; i++) {
       bezier::vec  C = (*p).C[i];
       bezier::real R = (*p).R[i];
       bezier::vec  N = (*p).N[i];
-      circle.V[0] = C + R*(cos_psang*N + sin_psang*plane_normal);
-      circle.V[2] = C + R*(cos_psang*N - sin_psang*plane_normal);
+      vec3 plus_psang  = C + R*(cos_psang*N + sin_psang*plane_normal);
+      vec3 minus_psang = C + R*(cos_psang*N - sin_psang*plane_normal);
       /*
 	 The isosceles triangle property is only valid for rational Beziers,
          so we only get an approximation here
       */
-      vec3 top = circle.V[0] + ((circle.V[2] - circle.V[0]).norm())*
-                                (sin_psang*(*p).N[i] - cos_psang*plane_normal);
-      vec3 half_base = 0.5*(circle.V[2] + circle.V[0]);
+      vec3 top = plus_psang + ((minus_psang - plus_psang).norm())*
+                              (sin_psang*N - cos_psang*plane_normal);
+      vec3 half_base = (minus_psang + plus_psang)*0.5;
       vec3 height = top - half_base;
       /*
          Best approximation! But depend of psang! Here we take psang = PI/3.
       */
       const real best_approx = 0.698393;
-      circle.V[1] = half_base + best_approx*height;
-      circles.push_back(circle);
+      (*ps).V[i]           = plus_psang;
+      (*ps).V[order + i]   = half_base + best_approx*height;
+      (*ps).V[2*order + i] = minus_psang;
     }
-    beziers_simples::const_iterator pc = circles.begin();
-    for (; pc != circles.end(); pc++) {
-      bez_surf.V.push_back((*pc).V[1]);
+    (*ps).order_u = 4;
+    (*ps).order_v = 3;
+  }
+  
+  patch_boxes.resize(proba_surface.size());
+  for (int index = 0; index < proba_surface.size(); index++) {
+    const bezier_surface& s = proba_surface[index];
+    patch_boxes[index] = bounding_box(s.V[0], s.V[0]);
+    for (int k = 1; k < s.V.size(); k++) {
+      patch_boxes[index].insert(s.V[k]);
     }
-    bez_surf.V.insert(bez_surf.V.end(), (*p_minus).V.begin(),
-		                        (*p_minus).V.end());
-    bez_surf.order_u = 4;
-    bez_surf.order_v = 3;
-    proba_surface.push_back(bez_surf);
   }
 }
 
+/*
+ *  computeBoundingBox :
+ *  Union of the boxes of the control points of the patches, which contain
+ *  the patches (convex hull property), so that the box is conservative and
+ *  needs no evaluation.
+ */
 void Stroke3D::computeBoundingBox() {
-  const int nstep_v = 3;
-  const real stepsize_v = 1.0/nstep_v;
-  vec3 Q;
-  std::vector<vec3> points;
+  box = bounding_box(proba_surface.front().V[0], proba_surface.front().V[0]);
+  for (beziers_surfaces::const_iterator ps = proba_surface.begin();
+       ps != proba_surface.end(); ps++) {
+    insertPatchBox(*ps, box_subdivisions);
+  }
+  box.min += transform;
+  box.max += transform;
+}
+
+/*
+ *  insertPatchBox :
+ *  Box of the control points of a patch inserted in the stroke box. If it
+ *  sticks out of the stroke box and is looser than the box of the corners
+ *  of the patch (which are on the patch), the patch is split into four
+ *  halves in u and v, and so on, depth times at most.
+ */
+void Stroke3D::insertPatchBox(const bezier_surface& s, const int depth) {
+  bounding_box hull(s.V[0], s.V[0]);
+  for (int k = 1; k < s.V.size(); k++) {
+    hull.insert(s.V[k]);
+  }
+  if (box.contains(hull)) {
+    return;
+  }
+  if (depth > 0) {
+    const int last_u = s.order_u - 1;
+    const int last_v = (s.order_v - 1)*s.order_u;
+    bounding_box corners(s.V[0], s.V[0]);
+    corners.insert(s.V[last_u]);
+    corners.insert(s.V[last_v]);
+    corners.insert(s.V[last_v + last_u]);
+    if (!corners.contains(hull)) {
+      bezier_surface s0, s1, s00, s01, s10, s11;
+      s.splitU(0.5, s0, s1);
+      s0.splitV(0.5, s00, s01);
+      s1.splitV(0.5, s10, s11);
+      insertPatchBox(s00, depth - 1);
+      insertPatchBox(s01, depth - 1);
+      insertPatchBox(s10, depth - 1);
+      insertPatchBox(s11, depth - 1);
+      return;
+    }
+  }
+  box.insert(hull);
+}
+
+/*
+ *  intersect :
+ *  Parameter t of the first point where the segment from origin to
+ *  origin + direction (in global coordinates) crosses the probability
+ *  surface, tessellated with the steps of the current level of detail and
+ *  split into triangles as in Surface_Mesh, if it is before t. Nothing is
+ *  evaluated if the stroke box is not crossed before t, nor for patches
+ *  whose control points box is not. The vertices of a patch are evaluated
+ *  in grid, a scratch array of the caller.
+ */
+bool Stroke3D::intersect(const GLdouble origin[3], const GLdouble direction[3],
+			 GLdouble& t, std::vector<tree::vec>& grid) const {
+  const vec3 d(direction[0], direction[1], direction[2]);
+  real t_box;
+  if (!box.isIntersectedBy(vec3(origin[0], origin[1], origin[2]), d, t_box) ||
+      t_box > t) {
+    return false;
+  }
+  const vec3 o(origin[0] - transform[0], origin[1] - transform[1],
+	       origin[2] - transform[2]);
+  bool hit = false;
   int index = 0;
   for (beziers_surfaces::const_iterator ps = proba_surface.begin();
        ps != proba_surface.end(); ps++, index++) {
-    int nstep_u = static_cast<int>(0.5*nsteps[index]); // Magic number!
-    if (nstep_u == 0) {
-      nstep_u = 1;
-    }
-    const real stepsize_u = 1.0/nstep_u;
-    for (int i = 0; i < nstep_u + 1; i++) {
-      for (int j = 0; j < nstep_v + 1; j++) {
-	(*ps).evaluate(i*stepsize_u, j*stepsize_v, Q);
-	points.push_back(Q);
+    real t_hull;
+    if (!patch_boxes[index].isIntersectedBy(o, d, t_hull) || t_hull > t) {
+      continue;
+    }
+    const GLint nu = steps(index);
+    if (grid.size() < (nu + 1)*(steps_v + 1)) {
+      grid.resize((nu + 1)*(steps_v + 1));
+    }
+    vec3* Q = &grid[0];
+    (*ps).evaluateGrid(nu, steps_v, Q);
+    for (int j = 0; j < steps_v; j++) {
+      for (int i = 0; i < nu; i++) {
+	const int a0 = j*(nu + 1) + i, a1 = a0 + 1;
+	const int b0 = a0 + nu + 1, b1 = b0 + 1;
+	if (intersectTriangle(o, d, Q[a0], Q[b0], Q[b1], t)) {
+	  hit = true;
+	}
+	if (intersectTriangle(o, d, Q[a0], Q[b1], Q[a1], t)) {
+	  hit = true;
+	}
       }
     }
   }
-  box = bounding_box(points);
+  return hit;
 }
 
 void Stroke3D::computeBarycenter() {
@@ -109,6 +175,7 @@ void Stroke3D::computeBarycenter() {
     }
   }
   barycenter_global /= count;
+  barycenter_global += transform;
 }
 
 void Stroke3D::probaSurface(/*const GLint nstep_u, */const GLint nstep_v,
@@ -146,15 +213,66 @@ void Stroke3D::probaSurface(/*const GLint nstep_u, */const GLint nstep_v,
   
   glPopAttrib();
 }
-/* TODO:
-   Use float instead of double to minimize memory cost.
-*/
+
+#ifndef EVALUATORS
+/*
+ *  tessellateProbaSurface :
+ *  Same patches, steps and texture coordinates as probaSurface(nstep_v,
+ *  TEXTURE_2D) with evaluators, at the current level of detail.
+ */
+void Stroke3D::tessellateProbaSurface(const GLint nstep_v) {
+  proba_surface_mesh.clear();
+  int nvertices = 0, ntriangles = 0, nvertices_max = 0;
+  int index;
+  for (index = 0; index < proba_surface.size(); index++) {
+    const int nv = (steps(index) + 1)*(nstep_v + 1);
+    nvertices += nv;
+    ntriangles += 2*steps(index)*nstep_v;
+    nvertices_max = std::max(nvertices_max, nv);
+  }
+  proba_surface_mesh.reserve(nvertices, ntriangles, nvertices_max);
+  GLfloat param_prev = 0.0;
+  index = 0;
+  for (beziers_surfaces::const_iterator ps = proba_surface.begin();
+       ps != proba_surface.end(); ps++, index++) {
+    const GLfloat param = param_prev + relative_lengths[index];
+    proba_surface_mesh.addPatch(*ps, steps(index), nstep_v,
+				param_prev, param);
+    param_prev = param;
+  }
+}
+#endif
+
+void Stroke3D::callProbaSurface(const int texture_mode) const {
+  pushTransform();
+#ifdef EVALUATORS
+  if (texture_mode == NO_TEXTURE) {
+    glCallList(proba_surface_picking_list);
+  }
+  else {
+    glCallList(proba_surface_list);
+  }
+#else
+  proba_surface_mesh.draw(texture_mode != NO_TEXTURE);
+#endif
+  popTransform();
+}
+
+void Stroke3D::pushTransform() const {
+  glPushMatrix();
+  glTranslated(transform[0], transform[1], transform[2]);
+}
+
+void Stroke3D::popTransform() const {
+  glPopMatrix();
+}
 
 void Stroke3D::initSteps() {
   const GLint nstep_tot = static_cast<GLint>(steps_per_unit_length*length);
   beziers::const_iterator p = bs.begin();
   beziers::const_iterator p_last = bs.end() - 1;
   int i = 0;
+  nsteps.reserve(bs.size());
   for (; p != bs.end(); p++, i++) {
     int nstep_b = static_cast<int>(relative_lengths[i]*nstep_tot);
     if (nstep_b < 1) {
@@ -162,6 +280,48 @@ void Stroke3D::initSteps() {
     }
     nsteps.push_back(nstep_b);
   }
+  
+  /* Length in model units, mean of the chord and control polygon lengths
+     of each curve (a good estimate for cubics) */
+  model_length = 0.0;
+  for (p = bs.begin(); p != bs.end(); p++) {
+    real polygon = 0.0;
+    for (int k = 1; k < (*p).V.size(); k++) {
+      polygon += ((*p).V[k] - (*p).V[k-1]).norm();
+    }
+    model_length += 0.5*(((*p).V.back() - (*p).V.front()).norm() + polygon);
+  }
+}
+
+/*
+ *  steps :
+ *  Steps of a curve at the current level of detail.
+ */
+GLint Stroke3D::steps(const int index) const {
+  const GLint nstep = (lod < 0) ? nsteps[index] >> -lod : nsteps[index] << lod;
+  return (nstep < 1) ? 1 : nstep;
+}
+
+void Stroke3D::initLevelsOfDetail() {
+#ifndef EVALUATORS
+  for (int k = 0; k < LOD_CACHE_SIZE; k++) {
+    lod_levels[k] = NO_LOD;
+  }
+#endif
+}
+
+/*
+ *  releaseLevelsOfDetail :
+ *  Tessellations at other levels than the current one released.
+ */
+void Stroke3D::releaseLevelsOfDetail() {
+#ifndef EVALUATORS
+  for (int k = 0; k < LOD_CACHE_SIZE; k++) {
+    proba_surface_lods[k].release();
+    proba_surface_lods[k].clear();
+    lod_levels[k] = NO_LOD;
+  }
+#endif
 }
 
 void Stroke3D::computeMeanRadius() {
@@ -212,11 +372,11 @@ void Stroke3D::computeNormals() {
 void Stroke3D::buildDisplayLists(const int window) {
   glutSetWindow(window);
   //const GLint nu = 4; // Magic number!
-  const GLint nv = 4; // Magic number!
+#ifdef EVALUATORS
   proba_surface_list = glGenLists(1);
   if (proba_surface_list) {
     glNewList(proba_surface_list, GL_COMPILE);
-    probaSurface(/*nu, */nv, TEXTURE_2D);
+    probaSurface(/*nu, */steps_v, TEXTURE_2D);
     glEndList();
   }
   else {
@@ -227,13 +387,17 @@ void Stroke3D::buildDisplayLists(const int window) {
     glNewList(proba_surface_picking_list, GL_COMPILE);
     //glPushAttrib(GL_ENABLE_BIT);
     //glEnable(GL_CULL_FACE);
-    probaSurface(/*nu, */nv, NO_TEXTURE);
+    probaSurface(/*nu, */steps_v, NO_TEXTURE);
     //glPopAttrib();
     glEndList();
   }
   else {
     assert(false);
   }
+#else
+  tessellateProbaSurface(steps_v);
+  proba_surface_mesh.upload();
+#endif
 }
 /* TODO:
    I don't see an obvious solution for determining if front face must be
@@ -241,32 +405,35 @@ void Stroke3D::buildDisplayLists(const int window) {
    properly.
 */
 
-void Stroke3D::initDisplayData() {
-  /* Clipping planes equations */
-  std::vector<GLdouble> eqn(4, 0.0);
-  equations.push_back(eqn);
-  equations.push_back(eqn);
-  setClippingPlanesEqns();
-}
-
-void Stroke3D::setClippingPlanesEqns() {
-  Vec3<GLdouble> normal_curr = - view_vector_prev; // current in fact!
-  // Orthographic camera hypothesis!
-  std::vector< Vec3<GLdouble> > points;
-  std::vector< Vec3<GLdouble> > normals;
-  const GLdouble ratio = /*0.25*/0.2; // Magic number!
-  Vec3<GLdouble> point_offset = ratio*mean_radius*normal_curr;
-  points.push_back(barycenter_global + point_offset);
-  points.push_back(barycenter_global - point_offset);
-  normals.push_back(-normal_curr);
-  normals.push_back( normal_curr);
-  for (int i = 0; i < equations.size(); i++) {
-    equations[i][3] = 0.0;
-    for (int j = 0; j < 3; j++) {
-      equations[i][j]  = normals[i][j];
-      equations[i][3] -= normals[i][j]*points[i][j];
-    }
+/*
+ *  updateDisplayLists :
+ *  Display lists compiled again, or mesh vertices moved, in place, for a
+ *  surface whose patches moved but kept their steps.
+ */
+void Stroke3D::updateDisplayLists(const int window) {
+  glutSetWindow(window);
+#ifdef EVALUATORS
+  glNewList(proba_surface_list, GL_COMPILE);
+  probaSurface(/*nu, */steps_v, TEXTURE_2D);
+  glEndList();
+  glNewList(proba_surface_picking_list, GL_COMPILE);
+  probaSurface(/*nu, */steps_v, NO_TEXTURE);
+  glEndList();
+#else
+  int nvertices_max = 0;
+  int index;
+  for (index = 0; index < proba_surface.size(); index++) {
+    nvertices_max = std::max(nvertices_max, (steps(index) + 1)*(steps_v + 1));
   }
+  proba_surface_mesh.mapVertices(nvertices_max);
+  index = 0;
+  for (beziers_surfaces::const_iterator ps = proba_surface.begin();
+       ps != proba_surface.end(); ps++, index++) {
+    proba_surface_mesh.updatePatch(*ps, steps(index), steps_v);
+  }
+  proba_surface_mesh.unmapVertices();
+  releaseLevelsOfDetail(); // Out of date
+#endif
 }
 
 /*****************************************************************************/
@@ -275,16 +442,25 @@ const Stroke3D::real Stroke3D::psang     = M_PI/3.0;
 const Stroke3D::real Stroke3D::cos_psang = 0.5;
 const Stroke3D::real Stroke3D::sin_psang = 0.5*Numerics<real>::sqroot(3.0);
 const Stroke3D::real Stroke3D::steps_per_unit_length = 0.05; // Magic numbers!
+const GLint Stroke3D::steps_v = 4;
+
+int Stroke3D::box_subdivisions = 1; // Magic number!
+int Stroke3D::lod_budget = 20000;   // Magic number!
 
 Stroke3D::Stroke3D()
-  : view_vector_prev(vec3::null()), length(0.0),
-    plane_normal(vec3::null()), mean_radius(0.0),
+  : node(graph::NO_NODE), sequence(0), length(0.0), model_length(0.0), lod(0),
+    plane_normal(vec3::null()), mean_radius(0.0), transform(vec3::null()),
     occluder_tex_name(0), proba_surface_tex_name(0), stroke_tex_name(0),
-    drawing_mode(0) {}
+    drawing_mode(0) {
+  initLevelsOfDetail();
+}
 
 Stroke3D::Stroke3D(const Input& in, const Stroke2D& s, const int mode)
-  : occluder_tex_name(0), proba_surface_tex_name(0), stroke_tex_name(0),
+  : node(graph::NO_NODE), sequence(0), model_length(0.0), lod(0),
+    transform(vec3::null()),
+    occluder_tex_name(0), proba_surface_tex_name(0), stroke_tex_name(0),
     drawing_mode(mode) {
+  initLevelsOfDetail();
   
   if (!s.empty()) {
     const int size = s.bs.size();
@@ -295,129 +471,77 @@ Stroke3D::Stroke3D(const Input& in, const Stroke2D& s, const int mode)
     const GLdouble winz_last = in.getLastPlane();
     const int mode = in.projectionMode();
     
-    if ((mode == Input::FOLLOW) || (mode == Input::SPLAT)) {
-      GLdouble winz = winz_first;
-      Stroke2D::beziers::const_iterator b = s.bs.begin();
-      for (; b != s.bs.end(); b++) {
-        bezier bez;
-        Stroke2D::bezier::ctrl_points::const_iterator cp = (*b).V.begin();
-	for (; cp != (*b).V.end(); cp++) {
-	  GLdouble objx, objy, objz;
-          if (gluUnProject((*cp).x(),
-			   static_cast<GLdouble>(in.viewport[3]) - (*cp).y()
-			   - 1.0,
-		           winz,
-		           in.mv_matrix, in.proj_matrix, in.viewport,
-		           &objx, &objy, &objz)) {
-	    bez.V.push_back(vec3(objx, objy, objz));
-	  }
-	  else {
-	    assert(false);
-	  }
-        }
-        bez.length = (*b).length;
-        bez.T = (*b).T;
-	Stroke2D::bezier::curv_centers::const_iterator cc = (*b).C.begin();
-        for (; cc != (*b).C.end(); cc++) {
-	  GLdouble objx, objy, objz;
-          if (gluUnProject((*cc).x(),
-			   static_cast<GLdouble>(in.viewport[3]) - (*cc).y()
-			   - 1.0,
-		           winz,
-		           in.mv_matrix, in.proj_matrix, in.viewport,
-		           &objx, &objy, &objz)) {
-	    bez.C.push_back(vec3(objx, objy, objz));
-	  }
-	  else {
-	    assert(false);
-	  }
-        }
-        bez.computeRadii();
-        bs.push_back(bez);
+    /* Window coordinates of all control points and curvature centers,
+       in turn, unprojected at once */
+    std::vector<GLdouble> wins, objs;
+    wins.reserve(3*2*4*size); // Cubic Beziers
+    const GLdouble winy_max = static_cast<GLdouble>(in.viewport[3]) - 1.0;
+    Stroke2D::beziers::const_iterator b = s.bs.begin();
+    int index = 0;
+    real length_curr = 0.0;
+    for (; b != s.bs.end(); b++, index++) {
+      assert((*b).C.size() == (*b).V.size());
+      for (int i = 0; i < (*b).V.size(); i++) {
+	GLdouble winz = winz_first;
+	if (mode == Input::BRIDGE) {
+	  const GLdouble t = length_curr + (*b).T[i]*s.relative_lengths[index];
+	  winz = (1.0 - t)*winz_first + (t)*winz_last;
+	}
+	wins.push_back((*b).V[i].x());
+	wins.push_back(winy_max - (*b).V[i].y());
+	wins.push_back(winz);
+	wins.push_back((*b).C[i].x());
+	wins.push_back(winy_max - (*b).C[i].y());
+	wins.push_back(winz);
+      }
+      if (mode == Input::BRIDGE) {
+	length_curr += s.relative_lengths[index];
+      }
+    }
+    objs.resize(wins.size());
+    if (!in.unprojector.unproject(wins.size()/3, &wins[0], &objs[0])) {
+      assert(false);
+    }
+    
+    std::vector<GLdouble>::const_iterator obj = objs.begin();
+    for (b = s.bs.begin(); b != s.bs.end(); b++) {
+      bezier bez;
+      for (int i = 0; i < (*b).V.size(); i++, obj += 6) {
+	bez.V.push_back(vec3(obj[0], obj[1], obj[2]));
+	bez.C.push_back(vec3(obj[3], obj[4], obj[5]));
       }
-      
+      bez.length = (*b).length;
+      bez.T.assign((*b).T.begin(), (*b).T.end());
+      bez.computeRadii();
+      bs.push_back(bez);
+    }
+    
+    if ((mode == Input::FOLLOW) || (mode == Input::SPLAT)) {
       /* Plane normal computation */
       vec3 view_vector;
       writeViewVector(in.mv_matrix, view_vector);
-      view_vector_prev = view_vector;
       plane_normal = - view_vector;
     }
     else if (mode == Input::BRIDGE) {
-      Stroke2D::beziers::const_iterator b = s.bs.begin();
-      const Stroke2D::beziers::const_iterator b_last = s.bs.end() - 1;
-      int index = 0;
-      real length_curr = 0.0;
-      for (; b != s.bs.end(); b++, index++) {
-	bezier bez;
-        Stroke2D::bezier::ctrl_points::const_iterator cp = (*b).V.begin();
-	Stroke2D::bezier::ctrl_points::const_iterator cp_end = (*b).V.end();
-	Stroke2D::bezier::parameters::const_iterator ct = (*b).T.begin();
-	Stroke2D::bezier::curv_centers::const_iterator cc = (*b).C.begin();
-        for (; cp != cp_end; cp++, ct++, cc++) {
-	  const GLdouble t = length_curr + (*ct)*s.relative_lengths[index];
-	  GLdouble winz = (1.0 - t)*winz_first + (t)*winz_last;
-	  GLdouble objx, objy, objz;
-          if (gluUnProject((*cp).x(),
-			   static_cast<GLdouble>(in.viewport[3]) - (*cp).y()
-			   - 1.0,
-		           winz,
-		           in.mv_matrix, in.proj_matrix, in.viewport,
-		           &objx, &objy, &objz)) {
-	    bez.V.push_back(vec3(objx, objy, objz));
-	  }
-	  else {
-	    assert(false);
-	  }
-	  if (gluUnProject((*cc).x(),
-			   static_cast<GLdouble>(in.viewport[3]) - (*cc).y()
-			   - 1.0,
-		           winz,
-		           in.mv_matrix, in.proj_matrix, in.viewport,
-		           &objx, &objy, &objz)) {
-	    bez.C.push_back(vec3(objx, objy, objz));
-	  }
-	  else {
-	    assert(false);
-	  }
-        }
-	length_curr += s.relative_lengths[index];
-        bez.length = (*b).length;
-        bez.T = (*b).T;
-	bez.computeRadii();
-        bs.push_back(bez);
-      }
-      
       /* Plane normal computation */
       int winx_first = static_cast<int>(in.positions.front().pos.x());
       int winy_first = static_cast<int>(in.positions.front().pos.y());
       int winx_last  = static_cast<int>(in.positions.back().pos.x());
       int winy_last  = static_cast<int>(in.positions.back().pos.y());
-      vec3 first, last;
-      GLdouble objx, objy, objz;
-      if (gluUnProject(static_cast<GLdouble>(winx_first),
-		       static_cast<GLdouble>(in.viewport[3] - winy_first - 1),
-		       winz_first,
-		       in.mv_matrix, in.proj_matrix, in.viewport,
-		       &objx, &objy, &objz)) {
-	first = vec3(objx, objy, objz);
-      }
-      else {
-	assert(false);
-      }
-      if (gluUnProject(static_cast<GLdouble>(winx_last),
-		       static_cast<GLdouble>(in.viewport[3] - winy_last - 1),
-		       winz_last,
-		       in.mv_matrix, in.proj_matrix, in.viewport,
-		       &objx, &objy, &objz)) {
-	last = vec3(objx, objy, objz);
-      }
-      else {
+      GLdouble win[6]
+	= {static_cast<GLdouble>(winx_first),
+	   static_cast<GLdouble>(in.viewport[3] - winy_first - 1), winz_first,
+	   static_cast<GLdouble>(winx_last),
+	   static_cast<GLdouble>(in.viewport[3] - winy_last - 1), winz_last};
+      GLdouble obj[6];
+      if (!in.unprojector.unproject(2, win, obj)) {
 	assert(false);
       }
+      vec3 first(obj[0], obj[1], obj[2]);
+      vec3 last(obj[3], obj[4], obj[5]);
       vec3 bridge_vector = last - first;
       vec3 view_vector;
       writeViewVector(in.mv_matrix, view_vector);
-      view_vector_prev = view_vector;
       real d = dot(view_vector, bridge_vector);
       if (d < 0.0) {
 	bridge_vector = -bridge_vector;
@@ -428,7 +552,8 @@ Stroke3D::Stroke3D(const Input& in, const Stroke2D& s, const int mode)
     }
     
     length = s.length;
-    relative_lengths = s.relative_lengths;
+    relative_lengths.assign(s.relative_lengths.begin(),
+			    s.relative_lengths.end());
     initSteps();
     computeMeanRadius();
 #if 0
@@ -450,7 +575,49 @@ Stroke3D::Stroke3D(const Input& in, const Stroke2D& s, const int mode)
     computeBoundingBox();
     computeBarycenter();
     buildDisplayLists(in.window);
-    initDisplayData();
+  }
+}
+
+/*
+ *  swap :
+ *  Exchange of the data of two strokes, GL names included, without copy:
+ *  a stroke is handed over to a container by swapping it with an empty one.
+ *  Nodes are exchanged too, and the values of their graph are to be
+ *  updated.
+ */
+void Stroke3D::swap(Stroke3D& s) {
+  std::swap(node, s.node);
+  std::swap(sequence, s.sequence);
+  bs.swap(s.bs);
+  std::swap(length, s.length);
+  relative_lengths.swap(s.relative_lengths);
+  nsteps.swap(s.nsteps);
+  std::swap(model_length, s.model_length);
+  std::swap(lod, s.lod);
+  std::swap(plane_normal, s.plane_normal);
+  std::swap(mean_radius, s.mean_radius);
+  std::swap(transform, s.transform);
+  std::swap(box, s.box);
+  std::swap(barycenter_global, s.barycenter_global);
+  proba_surface.swap(s.proba_surface);
+  patch_boxes.swap(s.patch_boxes);
+#ifdef EVALUATORS
+  std::swap(proba_surface_list, s.proba_surface_list);
+  std::swap(proba_surface_picking_list, s.proba_surface_picking_list);
+#else
+  proba_surface_mesh.swap(s.proba_surface_mesh);
+  for (int i = 0; i < LOD_CACHE_SIZE; i++) {
+    proba_surface_lods[i].swap(s.proba_surface_lods[i]);
+    std::swap(lod_levels[i], s.lod_levels[i]);
+  }
+#endif
+  std::swap(occluder_tex_name, s.occluder_tex_name);
+  std::swap(proba_surface_tex_name, s.proba_surface_tex_name);
+  std::swap(stroke_tex_name, s.stroke_tex_name);
+  std::swap(drawing_mode, s.drawing_mode);
+  for (int i = 0; i < 4; i++) {
+    std::swap(color_init[i], s.color_init[i]);
+    std::swap(color[i], s.color[i]);
   }
 }
 
@@ -469,20 +636,30 @@ void Stroke3D::reinitColor() {
   color[2] = color_init[2]; color[3] = color_init[3];
 }
 
-void Stroke3D::read(ifstream& file_in, const int window) {
+/*
+ *  read :
+ *  Stroke of a drawing file, into an empty stroke. False if the file is
+ *  corrupt or ends before the stroke, the stroke being left empty.
+ */
+bool Stroke3D::read(ifstream& file_in, const int window) {
   char line[256];
   file_in.getline(line, 256, '\n');
   int n;
-  sscanf(line, "%d", &n);
+  if (!file_in || sscanf(line, "%d", &n) != 1 || n < 1) {
+    return false;
+  }
   bs.reserve(n);
   relative_lengths.reserve(n);
   file_in.getline(line, 256, '\n');
-  sscanf(line, "%lf", &length);
+  double x, y, z;
+  sscanf(line, "%lf", &x);
+  length = x;
   file_in.getline(line, 256, '\n');
-  sscanf(line, "%lf %lf %lf",
-	 &plane_normal[0], &plane_normal[1], &plane_normal[2]);
+  sscanf(line, "%lf %lf %lf", &x, &y, &z);
+  plane_normal = vec3(x, y, z);
   file_in.getline(line, 256, '\n');
-  sscanf(line, "%lf", &mean_radius);
+  sscanf(line, "%lf", &x);
+  mean_radius = x;
   file_in.getline(line, 256, '\n');
   sscanf(line, "%d", &drawing_mode);
   file_in.getline(line, 256, '\n');
@@ -492,11 +669,15 @@ void Stroke3D::read(ifstream& file_in, const int window) {
   
   for (int i = 0; i < n; i++) {
     file_in.getline(line, 256, '\n');
-    real rl;
+    double rl;
     sscanf(line, "%lf", &rl);
     relative_lengths.push_back(rl);
     bezier bez;
-    bez.read(file_in);
+    if (!bez.read(file_in)) {
+      bs.clear();
+      relative_lengths.clear();
+      return false;
+    }
     bs.push_back(bez);
   }
   
@@ -507,7 +688,7 @@ void Stroke3D::read(ifstream& file_in, const int window) {
   computeBoundingBox();
   computeBarycenter();
   buildDisplayLists(window);
-  initDisplayData();
+  return true;
 }
 
 void Stroke3D::write(ofstream& file_out) const {
@@ -523,7 +704,12 @@ void Stroke3D::write(ofstream& file_out) const {
   std::vector<real>::const_iterator rl_p = relative_lengths.begin();
   for (; b_p != bs.end(); b_p++, rl_p++) {
     file_out << (*rl_p) << endl;
-    (*b_p).write(file_out);
+    bezier bez(*b_p); // Transform baked into the copy
+    for (int i = 0; i < bez.V.size(); i++) {
+      bez.V[i] += transform;
+      bez.C[i] += transform;
+    }
+    bez.write(file_out);
   }
 }
 
@@ -531,39 +717,35 @@ bool Stroke3D::empty() const {
   return bs.empty();
 }
 
-void Stroke3D::move(const Input& in) {
-  const vec3 view_vector(in.view_vector);
-  if (view_vector == view_vector_prev) {
-    return;
-  }
-  else {
-    view_vector_prev = view_vector;
-    
-    /* Clipping planes */
-    setClippingPlanesEqns();
-  }
-}
-
-void Stroke3D::reverse(const int window) {
+/*
+ *  reverse :
+ *  Curvature centers moved to the other side of the curves. Patches and GL
+ *  data are updated in place (the steps do not change), or built again if
+ *  in_place is false, as the reference for the in place update.
+ */
+void Stroke3D::reverse(const int window, const bool in_place) {
   for (beziers::iterator p = bs.begin(); p != bs.end(); p++) {
     bezier::curv_centers::iterator pc = (*p).C.begin();
     bezier::curv_centers::iterator pc_end = (*p).C.end();
     bezier::radii::const_iterator pr = (*p).R.begin();
     bezier::normals::iterator pn = (*p).N.begin();
     for (; pc != pc_end; pc++, pr++, pn++) {
-      (*pc) += 2.0*(*pr)*(*pn); // Translate center of 2*radius along normal
+      (*pc) += (*pn)*(2.0*(*pr)); // Translate center of 2*radius along normal
       (*pn) = -(*pn);           // Reverse normal
     }
   }
   
   computeNormals();
-  proba_surface.clear();
   computeBezierSurface();
   computeBoundingBox();
   computeBarycenter();
-  clean(window);
-  buildDisplayLists(window);
-  initDisplayData();
+  if (in_place) {
+    updateDisplayLists(window);
+  }
+  else {
+    clean(window);
+    buildDisplayLists(window);
+  }
 }
 
 void Stroke3D::translate(int first_x, int first_y, int last_x, int last_y,
@@ -579,152 +761,236 @@ void Stroke3D::translate(int first_x, int first_y, int last_x, int last_y,
   else {
     assert(false);
   }
-  GLdouble objx, objy, objz;
-  vec3 first, last;
-  if (gluUnProject(static_cast<GLdouble>(first_x),
-		   static_cast<GLdouble>(in.viewport[3] - 1 - first_y),
-		   winz,
-		   in.mv_matrix, in.proj_matrix, in.viewport,
-		   &objx, &objy, &objz)) {
-    first = vec3(objx, objy, objz);
-  }
-  else {
-    assert(false);
-  }
-  if (gluUnProject(static_cast<GLdouble>(last_x),
-		   static_cast<GLdouble>(in.viewport[3] - 1 - last_y),
-		   winz,
-		   in.mv_matrix, in.proj_matrix, in.viewport,
-		   &objx, &objy, &objz)) {
-    last = vec3(objx, objy, objz);
-  }
-  else {
+  GLdouble win[6]
+    = {static_cast<GLdouble>(first_x),
+       static_cast<GLdouble>(in.viewport[3] - 1 - first_y), winz,
+       static_cast<GLdouble>(last_x),
+       static_cast<GLdouble>(in.viewport[3] - 1 - last_y), winz};
+  GLdouble obj[6];
+  if (!in.unprojector.unproject(2, win, obj)) {
     assert(false);
   }
+  vec3 first(obj[0], obj[1], obj[2]);
+  vec3 last(obj[3], obj[4], obj[5]);
   vec3 translation = last - first;
+  transform += translation;
+  box.min += translation;
+  box.max += translation;
+  barycenter_global += translation;
+}
+
+/*
+ *  applyTransform :
+ *  Model transform baked into the geometry, and reset.
+ */
+void Stroke3D::applyTransform(const int window) {
+  if (transform == vec3::null()) {
+    return;
+  }
   for (beziers::iterator p = bs.begin(); p != bs.end(); p++) {
     bezier::ctrl_points::iterator pp = (*p).V.begin();
     bezier::ctrl_points::iterator pp_end = (*p).V.end();
     bezier::curv_centers::iterator pc = (*p).C.begin();
     for (; pp != pp_end; pp++, pc++) {
-      (*pp) += translation; // Translate control point
-      (*pc) += translation; // Translate curvature center
+      (*pp) += transform; // Translate control point
+      (*pc) += transform; // Translate curvature center
     }
+    (*p).invalidateHodographs();
   }
+  transform = vec3::null();
   // Normal vectors unchanged by translation!
-  proba_surface.clear();
+  // Bounding box and barycenter already transformed
   computeBezierSurface();
-  computeBoundingBox();
-  computeBarycenter();
-  clean(in.window);
-  buildDisplayLists(in.window);
-  initDisplayData();
+  updateDisplayLists(window);
 }
 
-void Stroke3D::addIntersectedStroke(Stroke3D& s) {
-    addPStroke(&s);
-  s.addPStroke(this);
-}
-
-void Stroke3D::addPStroke(Stroke3D* p) {
-  pstrokes.push_back(p);
-}
-
-void Stroke3D::cleanIntersectedStrokes() {
-  for (std::list<Stroke3D*>::const_iterator iter = pstrokes.begin();
-       iter != pstrokes.end(); iter++) {
-    (*iter)->clean(this);
+/*
+ *  setLevelOfDetail :
+ *  Level of detail for the camera of in. Curves get the steps per pixel
+ *  they got when they were drawn (steps_per_unit_length), for their length
+ *  on screen now, estimated from the projection of the bounding box. The
+ *  number of steps is rounded to a power of two times the initial one,
+ *  and only changes once it is a quarter of a level past the middle of two
+ *  levels. A level which is not in the cache is only tessellated if the
+ *  budget of vertices of the frame allows it, otherwise the current level
+ *  is kept until a later frame.
+ */
+void Stroke3D::setLevelOfDetail(const Input& in, int& budget) {
+  const real box_size = (box.max - box.min).norm();
+  if (length <= 0.0 || box_size <= 0.0) {
+    return;
   }
-}
-
-void Stroke3D::clean(Stroke3D* p) {
-  for (std::list<Stroke3D*>::iterator iter = pstrokes.begin();
-       iter != pstrokes.end(); iter++) {
-    if ((*iter) == p) {
-      pstrokes.erase(iter);
+  
+  /* Size on screen of the projection of the bounding box */
+  GLdouble m[16];
+  multMM(in.proj_matrix, in.mv_matrix, m);
+  GLdouble x_min = 1.0, y_min = 1.0, x_max = -1.0, y_max = -1.0;
+  bool behind = false; // Corner behind the eye
+  for (int c = 0; c < 8; c++) {
+    const GLdouble x = (c & 1) ? box.max[0] : box.min[0];
+    const GLdouble y = (c & 2) ? box.max[1] : box.min[1];
+    const GLdouble z = (c & 4) ? box.max[2] : box.min[2];
+    const GLdouble w = m[3]*x + m[7]*y + m[11]*z + m[15];
+    if (w <= 0.0) {
+      behind = true;
+      break;
+    }
+    const GLdouble x_ndc = (m[0]*x + m[4]*y + m[8]*z + m[12])/w;
+    const GLdouble y_ndc = (m[1]*x + m[5]*y + m[9]*z + m[13])/w;
+    x_min = min(x_min, x_ndc); x_max = max(x_max, x_ndc);
+    y_min = min(y_min, y_ndc); y_max = max(y_max, y_ndc);
+  }
+  int level = MAX_LOD;
+  if (!behind) {
+    const GLdouble dx = 0.5*(x_max - x_min)*in.viewport[2];
+    const GLdouble dy = 0.5*(y_max - y_min)*in.viewport[3];
+    const GLdouble length_curr = model_length*sqrt(dx*dx + dy*dy)/box_size;
+    const GLdouble level_curr = log(length_curr/length)/M_LN2;
+    if (fabs(level_curr - lod) < 0.75) { // Magic number!
+      return;
+    }
+    level = static_cast<int>(floor(level_curr + 0.5));
+    if (level < MIN_LOD) {
+      level = MIN_LOD;
+    }
+    else if (level > MAX_LOD) {
+      level = MAX_LOD;
+    }
+  }
+  if (level == lod) {
+    return;
+  }
+  
+#ifdef EVALUATORS
+  lod = level; // Curves only, surfaces stay in their display lists
+#else
+  int k = 0;
+  while (k < LOD_CACHE_SIZE && lod_levels[k] != level) {
+    k++;
+  }
+  const bool cached = (k < LOD_CACHE_SIZE);
+  if (!cached) {
+    if (budget <= 0) {
       return;
     }
+    k = LOD_CACHE_SIZE - 1; // Least recently used, tessellated again
+  }
+  Surface_Mesh mesh;
+  mesh.swap(proba_surface_lods[k]);
+  for (int j = k; j > 0; j--) {
+    proba_surface_lods[j].swap(proba_surface_lods[j-1]);
+    lod_levels[j] = lod_levels[j-1];
+  }
+  proba_surface_lods[0].swap(proba_surface_mesh);
+  lod_levels[0] = lod;
+  proba_surface_mesh.swap(mesh);
+  lod = level;
+  if (!cached) {
+    tessellateProbaSurface(steps_v);
+    proba_surface_mesh.upload();
+    budget -= proba_surface_mesh.vertices();
   }
+#endif
 }
 
 void Stroke3D::clean(const int window) {
   glutSetWindow(window);
+#ifdef EVALUATORS
   glDeleteLists(proba_surface_list, 1);
   glDeleteLists(proba_surface_picking_list, 1);
+#else
+  proba_surface_mesh.release();
+  releaseLevelsOfDetail();
+#endif
 }
 
 void Stroke3D::drawSpline() const {
+  pushTransform();
   glPushAttrib(GL_EVAL_BIT);
   
   beziers::const_iterator p = bs.begin();
   int i = 0;
   for (; p != bs.end(); p++, i++) {
+#ifdef STROKE3D_FLOAT
+    glMap1f(GL_MAP1_VERTEX_3, 0.0, 1.0, 3, (*p).V.size(), &(*p).V[0][0]);
+#else
     glMap1d(GL_MAP1_VERTEX_3, 0.0, 1.0, 3, (*p).V.size(), &(*p).V[0][0]);
-    const GLint nstep_u = nsteps[i];
+#endif
+    const GLint nstep_u = steps(i);
     glMapGrid1d(nstep_u, 0.0, 1.0);
     glEvalMesh1(GL_LINE, 0, nstep_u);
   }
   
   glPopAttrib();
+  popTransform();
 }
 
 void Stroke3D::drawOccluder() const {
   glPushAttrib(GL_TEXTURE_BIT);
   glBindTexture(GL_TEXTURE_2D, occluder_tex_name);
-  glCallList(proba_surface_list);
+  callProbaSurface(TEXTURE_2D);
   glPopAttrib();
 }
 
-void Stroke3D::drawStrokeFirstPass() const {
+void Stroke3D::drawStrokeFirstPass(const GLdouble* planes) const {
   glPushAttrib(GL_TEXTURE_BIT);
   glBindTexture(GL_TEXTURE_2D, proba_surface_tex_name);
-  drawClippedStroke();
+  drawClippedStroke(planes);
   glPopAttrib();
 }
 
-void Stroke3D::drawStrokeSecondPass() const {
-  drawClippedStroke();
+void Stroke3D::drawStrokeSecondPass(const GLdouble* planes) const {
+  drawClippedStroke(planes);
 }
 
 void Stroke3D::drawProbaSurface() const {
   glPushAttrib(GL_TEXTURE_BIT);
   glBindTexture(GL_TEXTURE_2D, proba_surface_tex_name);
-  glCallList(proba_surface_list);
+  callProbaSurface(TEXTURE_2D);
   glPopAttrib();
 }
 
 void Stroke3D::drawProbaSurfacePicking() const {
-  glCallList(proba_surface_picking_list);
+  callProbaSurface(NO_TEXTURE);
 }
 
-void Stroke3D::drawIntersectedStrokes() const {
-  if (pstrokes.empty()) {
+/*
+ *  drawIntersectedStrokes :
+ *  Probability surfaces of the textured strokes linked to this one in g,
+ *  found in strokes by their handles, clipped by its planes (two
+ *  equations, as given by Clipping_Planes).
+ */
+void Stroke3D::drawIntersectedStrokes(const graph& g, const map& strokes,
+				      const GLdouble* planes) const {
+  if (!g.contains(node) || g.degree(node) == 0) {
     return;
   }
   glPushAttrib(GL_TRANSFORM_BIT);
   
-  glClipPlane(GL_CLIP_PLANE0, &equations[0][0]);
-  glClipPlane(GL_CLIP_PLANE1, &equations[1][0]);
+  glClipPlane(GL_CLIP_PLANE0, planes);
+  glClipPlane(GL_CLIP_PLANE1, planes + 4);
   
-  std::list<Stroke3D*>::const_iterator iter = pstrokes.begin();
-  for (; iter != pstrokes.end(); iter++) {
-    if ((*iter)->drawing_mode == TEXTURED_POLYGON) {
-	(*iter)->drawProbaSurface();
+  const int n = g.degree(node);
+  for (int i = 0; i < n; i++) {
+    const Stroke3D& s = strokes[g.value(g.neighbour(node, i))];
+    if (s.drawing_mode == TEXTURED_POLYGON) {
+      s.drawProbaSurface();
     }
   }
   
   glPopAttrib();
 }
 
-void Stroke3D::drawClippedStroke() const {
+void Stroke3D::drawClippedStroke(const GLdouble* planes) const {
   glPushAttrib(GL_TRANSFORM_BIT);
-  glClipPlane(GL_CLIP_PLANE0, &equations[0][0]);
-  glClipPlane(GL_CLIP_PLANE1, &equations[1][0]);
-  glCallList(proba_surface_list);
+  glClipPlane(GL_CLIP_PLANE0, planes);
+  glClipPlane(GL_CLIP_PLANE1, planes + 4);
+  callProbaSurface(TEXTURE_2D);
   glPopAttrib();
 }
 
 void Stroke3D::drawControlPoints() const {
+  pushTransform();
   glBegin(GL_POINTS);
   beziers::const_iterator p;
   bezier::ctrl_points::const_iterator cp;
@@ -734,9 +1000,11 @@ void Stroke3D::drawControlPoints() const {
     }
   }
   glEnd();
+  popTransform();
 }
 
 void Stroke3D::drawTangents() const {
+  pushTransform();
   glBegin(GL_LINES);
   beziers::const_iterator p;
   bezier::ctrl_points::const_iterator cp;
@@ -749,9 +1017,11 @@ void Stroke3D::drawTangents() const {
     glVertex3d((*(cp-1)).x(), (*(cp-1)).y(), (*(cp-1)).z());
   }
   glEnd();
+  popTransform();
 }
 
 void Stroke3D::drawCurvatureVectors() const {
+  pushTransform();
   glBegin(GL_LINES);
   beziers::const_iterator p;
   for (p = bs.begin(); p != bs.end(); p++) {
@@ -763,9 +1033,11 @@ void Stroke3D::drawCurvatureVectors() const {
     }
   }
   glEnd();
+  popTransform();
 }
 
 void Stroke3D::drawCircles() const {
+  pushTransform();
   const int nstp = 20; // Magic number!
   const real step_size = (2.0*M_PI)/nstp;
   beziers::const_iterator p;
@@ -781,9 +1053,11 @@ void Stroke3D::drawCircles() const {
       glEnd();
     }
   }
+  popTransform();
 }
 
 void Stroke3D::drawNormals() const {
+  pushTransform();
   glBegin(GL_LINES);
   beziers::const_iterator p;
   for (p = bs.begin(); p != bs.end(); p++) {
@@ -795,11 +1069,13 @@ void Stroke3D::drawNormals() const {
     }
   }
   glEnd();
+  popTransform();
 }
 
 void Stroke3D::drawBarycenter() const {
   glBegin(GL_POINTS);
-  glVertex3dv(&barycenter_global[0]);
+  glVertex3d(barycenter_global[0], barycenter_global[1],
+	     barycenter_global[2]);
   glEnd();
 }
 
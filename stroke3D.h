@@ -5,37 +5,62 @@
 #include <bezier_surface.h>
 #include <aabb.h>
 #include "opengl_utils.h"
+#include "surface_mesh.h"
+#include "intersection_graph.h"
+#include "slot_map.h"
+#include "triangle.h"
 #include "stroke2D.h"
 
+/*
+ *  Moving a stroke only changes its model transform, which is baked into
+ *  its geometry on demand (applyTransform) or when it is written.
+ *  Curves and surfaces are tessellated at a level of detail chosen for the
+ *  current camera (setLevelOfDetail), and the last tessellations are kept.
+ *  Geometry is stored in single precision if STROKE3D_FLOAT is defined.
+ *  Probability surfaces are tessellated on the CPU into a Surface_Mesh,
+ *  or drawn by OpenGL evaluators in display lists if EVALUATORS is defined.
+ */
 class Stroke3D {
 private:
+#ifdef STROKE3D_FLOAT
+  typedef GLfloat                       real;
+#else
   typedef GLdouble                      real;
+#endif
   typedef Vec3<real>                    vec3;
-  typedef Bezier<real, vec3>            bezier_simple;
-  typedef Bezier_Augmented<real, vec3>  bezier;
-  typedef Bezier_Surface<real, vec3>    bezier_surface;
+  typedef Bezier<real, vec3, 3>         bezier_simple;
+  typedef Bezier<real, vec3, 2>         bezier_quadratic;
+  typedef Bezier_Augmented<real, vec3, 3> bezier;
+  typedef Inline_Vector<vec3, 3*4>      patch_points; // Cubic by quadratic
+  typedef Bezier_Surface<real, vec3, patch_points> bezier_surface;
   typedef AABB<real, vec3>              bounding_box;
   typedef std::vector<bezier>           beziers;
   typedef std::vector<bezier_simple>    beziers_simples;
+  typedef std::vector<bezier_quadratic> beziers_quadratics;
   typedef std::vector<bezier_surface>   beziers_surfaces;
   enum texturemode {NO_TEXTURE, TEXTURE_1D, TEXTURE_2D};
+  enum {MIN_LOD = -3, MAX_LOD = 2, // Levels of detail
+	NO_LOD = MAX_LOD + 1,      // Empty cache entry
+	LOD_CACHE_SIZE = 2};       // Tessellations kept besides the current one
   
   void computeBezierSurface();
-  void computeBoundingBox();
+  void insertPatchBox(const bezier_surface& s, const int depth);
   void computeBarycenter();
   void probaSurface(/*const GLint nstep_u, */const GLint nstep_v,
 		    const int texture_mode) const;
+  void tessellateProbaSurface(const GLint nstep_v);
+  void callProbaSurface(const int texture_mode) const;
+  void pushTransform() const;
+  void popTransform() const;
   void initSteps();
+  GLint steps(const int index) const;
+  void initLevelsOfDetail();
+  void releaseLevelsOfDetail();
   void computeMeanRadius();
   void computeNormals();
   void buildDisplayLists(const int window);
-  void initDisplayData();
-  void setClippingPlanesEqns();
+  void updateDisplayLists(const int window);
   
-  beziers_surfaces proba_surface;
-  
-  // Move data
-  vec3 view_vector_prev;
 #if 0
   vec3 mean_normal; // Mean normal of Bezier curves
                     // (in the stroke plane)
@@ -43,50 +68,50 @@ private:
                            // to stroke plane
 #endif
   
-  // References to intersected strokes
-  std::list<Stroke3D*> pstrokes;
-  
-  // Clipping planes equations
-  std::vector< std::vector<GLdouble> > equations;
-  
   // Probability surface angle
   static const real psang;
   static const real cos_psang;
   static const real sin_psang;
   
   static const real steps_per_unit_length;
+  static const GLint steps_v; // Across the probability surface
   
 public:
+  typedef Slot_Map<Stroke3D> map;
+  typedef Intersection_Graph<GLuint> graph; // Of handles in a map
+  typedef AABB_Tree<real, vec3> tree;
   enum drawingmode {LINE, OCCLUSION, TEXTURED_POLYGON};
   
   Stroke3D();
   Stroke3D(const Input& in, const Stroke2D& s, const int mode = LINE);
+  void swap(Stroke3D& s);
   void setInitColor(const GLfloat c[4]);
   void setColor(const GLfloat c[4]);
   void reinitColor();
-  void read(std::ifstream& file_in, const int window);
+  bool read(std::ifstream& file_in, const int window);
   void write(std::ofstream& file_out) const;
   bool empty() const;
-  void move(const Input& in);
-  void reverse(const int window);
+  void reverse(const int window, const bool in_place = true);
   void translate(int first_x, int first_y, int last_x, int last_y,
 		 const Input& in);
+  void applyTransform(const int window);
+  void setLevelOfDetail(const Input& in, int& budget);
+  void computeBoundingBox();
+  bool intersect(const GLdouble origin[3], const GLdouble direction[3],
+		 GLdouble& t, std::vector<tree::vec>& grid) const;
   
-  void addIntersectedStroke(Stroke3D& p);
-  void addPStroke(Stroke3D* p);
-  void cleanIntersectedStrokes();
-  void clean(Stroke3D* p);
   void clean(const int window);
   
   void drawSpline() const;
   void drawOccluder() const;
   void drawStroke() const;
-  void drawStrokeFirstPass() const;
-  void drawStrokeSecondPass() const;
+  void drawStrokeFirstPass(const GLdouble* planes) const;
+  void drawStrokeSecondPass(const GLdouble* planes) const;
   void drawProbaSurface() const;
   void drawProbaSurfacePicking() const;
-  void drawIntersectedStrokes() const;
-  void drawClippedStroke() const;
+  void drawIntersectedStrokes(const graph& g, const map& strokes,
+			      const GLdouble* planes) const;
+  void drawClippedStroke(const GLdouble* planes) const;
   
   void drawControlPoints() const;
   void drawTangents() const;
@@ -96,20 +121,39 @@ public:
   void drawBarycenter() const;
   void drawBoundingBox() const;
   
+  static int box_subdivisions; // Of the patches, for tighter boxes
+  static int lod_budget;       // Vertices tessellated per frame at most,
+                               // for changes of level of detail
+  
+  graph::node node;  // In the graph of intersected strokes, if any
+  unsigned int sequence; // Of the stroke in its drawing, the drawing order
   beziers bs;
   real length;       // Stroke length (in screen units)
   std::vector<real> relative_lengths;
-  std::vector<GLint> nsteps;
+  std::vector<GLint> nsteps; // Steps of the curves when they were drawn
+  real model_length; // Stroke length (in model units)
+  int lod;           // Level of detail: steps of the curves times 2^lod
   vec3 plane_normal; // Normal to stroke plane
   real mean_radius;
 #if 0
   bool is_visible;
 #endif
-  bounding_box box;
-  bezier::vec barycenter_global;
+  vec3 transform;    // Model transform (a translation), applied at draw
+                     // time and not yet to the geometry
+  bounding_box box;  // Bounding box and barycenter of the transformed
+  bezier::vec barycenter_global; // geometry
+  beziers_surfaces proba_surface;
+  std::vector<bounding_box> patch_boxes; // Of the control points of the
+                                         // patches, not transformed
   
+#ifdef EVALUATORS
   GLuint proba_surface_list;
   GLuint proba_surface_picking_list;
+#else
+  Surface_Mesh proba_surface_mesh;                 // At the current level,
+  Surface_Mesh proba_surface_lods[LOD_CACHE_SIZE]; // and at other ones,
+  int lod_levels[LOD_CACHE_SIZE];                  // most recent first
+#endif
   
   GLuint occluder_tex_name;
   GLuint proba_surface_tex_name;
@@ -0,0 +1,179 @@
+#define GL_GLEXT_PROTOTYPES
+#include <cstdio>
+#include <algorithm>
+#include "surface_mesh.h"
+#include <GL/glext.h>
+
+Surface_Mesh::Surface_Mesh()
+  : mapped(0), nvertices(0), nindices(0) {
+  buffers[0] = buffers[1] = 0;
+}
+
+/*
+ *  clear :
+ *  Empty mesh, keeping its buffers (if any) for the next upload.
+ */
+void Surface_Mesh::clear() {
+  data.clear();
+  indices.clear();
+  nvertices = 0;
+  nindices = 0;
+}
+
+/*
+ *  reserve :
+ *  Room for the arrays of a mesh of nv vertices and nt triangles, and for
+ *  the grid of its largest patch (nv_patch vertices), so that the patches
+ *  are added without allocation.
+ */
+void Surface_Mesh::reserve(const int nv, const int nt, const int nv_patch) {
+  data.reserve(5*nv);
+  indices.reserve(3*nt);
+  grid.resize(3*nv_patch);
+}
+
+/*
+ *  upload :
+ *  Copy of the arrays to vertex buffer objects of the current context, if
+ *  available. The client copies are then freed, as is the scratch grid.
+ */
+void Surface_Mesh::upload() {
+  std::vector<GLdouble>().swap(grid);
+  if (nindices == 0 || !bufferObjects()) {
+    return;
+  }
+  if (buffers[0] == 0) {
+    glGenBuffers(2, buffers);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, data.size()*sizeof(GLfloat), &data[0],
+	       GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLuint),
+	       &indices[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  std::vector<GLfloat>().swap(data);
+  std::vector<GLuint>().swap(indices);
+}
+
+/*
+ *  release :
+ *  Deletion of the buffers, in the current context.
+ */
+void Surface_Mesh::release() {
+  if (buffers[0] != 0) {
+    glDeleteBuffers(2, buffers);
+    buffers[0] = buffers[1] = 0;
+  }
+}
+
+/*
+ *  mapVertices :
+ *  Start of an in place update of the positions (see updatePatch), in the
+ *  vertex buffer if any. The buffer keeps its size and the index buffer is
+ *  not touched. The scratch grid gets room for the largest patch (nv_patch
+ *  vertices) until unmapVertices.
+ */
+void Surface_Mesh::mapVertices(const int nv_patch) {
+  grid.resize(3*nv_patch);
+  if (buffers[0] != 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    mapped = static_cast<GLfloat*>(glMapBuffer(GL_ARRAY_BUFFER,
+					       GL_WRITE_ONLY));
+    assert(mapped != 0);
+  }
+  else if (nvertices != 0) {
+    mapped = &data[0];
+  }
+}
+
+void Surface_Mesh::unmapVertices() {
+  if (buffers[0] != 0) {
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  mapped = 0;
+  std::vector<GLdouble>().swap(grid);
+}
+
+/*
+ *  readData :
+ *  Copy of the interleaved array, read back from the vertex buffer if any.
+ */
+void Surface_Mesh::readData(std::vector<GLfloat>& d) const {
+  d.resize(5*nvertices);
+  if (nvertices == 0) {
+    return;
+  }
+  if (buffers[0] != 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, d.size()*sizeof(GLfloat), &d[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  else {
+    d.assign(data.begin(), data.end());
+  }
+}
+
+void Surface_Mesh::draw(const bool texture) const {
+  if (nindices == 0) {
+    return;
+  }
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+  const GLfloat* vertex_data = 0; // Offsets in the buffers
+  const GLuint* index_data = 0;
+  if (buffers[0] != 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+  }
+  else {
+    vertex_data = &data[0];
+    index_data = &indices[0];
+  }
+  if (texture) {
+    glInterleavedArrays(GL_T2F_V3F, 0, vertex_data);
+  }
+  else {
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 5*sizeof(GLfloat), vertex_data + 2);
+  }
+  glDrawElements(GL_TRIANGLES, nindices, GL_UNSIGNED_INT, index_data);
+  if (buffers[0] != 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
+  glPopClientAttrib();
+}
+
+/*
+ *  swap :
+ *  Exchange of the arrays and buffers of two meshes, without copy.
+ */
+void Surface_Mesh::swap(Surface_Mesh& mesh) {
+  data.swap(mesh.data);
+  indices.swap(mesh.indices);
+  grid.swap(mesh.grid);
+  std::swap(buffers[0], mesh.buffers[0]);
+  std::swap(buffers[1], mesh.buffers[1]);
+  std::swap(mapped, mesh.mapped);
+  std::swap(nvertices, mesh.nvertices);
+  std::swap(nindices, mesh.nindices);
+}
+
+/*
+ *  bufferObjects :
+ *  True if the current context has vertex buffer objects (OpenGL 1.5).
+ */
+bool Surface_Mesh::bufferObjects() {
+  static int support = -1; // Unknown
+  if (support == -1) {
+    const GLubyte* version = glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version != 0) {
+      sscanf(reinterpret_cast<const char*>(version), "%d.%d", &major, &minor);
+    }
+    support = (major > 1 || (major == 1 && minor >= 5)) ? 1 : 0;
+  }
+  return support == 1;
+}
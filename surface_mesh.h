@@ -0,0 +1,136 @@
+#ifndef SURFACE_MESH_H
+#define SURFACE_MESH_H
+
+#include <cassert>
+#include <vector>
+#include <GL/gl.h>
+
+/*
+ *  Triangle mesh of a sequence of Bezier surface patches, tessellated on the
+ *  CPU into one interleaved texture coordinates / position array (the
+ *  GL_T2F_V3F format) and one index array. Once uploaded, the arrays live in
+ *  vertex buffer objects if the OpenGL version is 1.5 or more (they stay in
+ *  client memory otherwise), and the whole mesh is drawn by a single call.
+ *  Texture coordinates are those glMap2d(GL_MAP2_TEXTURE_COORD_2, ...) gives
+ *  the patches in Stroke3D: s along v, t from t_first to t_last along u.
+ */
+class Surface_Mesh {
+public:
+  Surface_Mesh();
+  void clear();
+  void reserve(const int nv, const int nt, const int nv_patch);
+  template <class Surface>
+  void addPatch(const Surface& s, const int nstep_u, const int nstep_v,
+		const GLfloat t_first, const GLfloat t_last);
+  void upload();
+  void release();
+  void mapVertices(const int nv_patch);
+  template <class Surface>
+  void updatePatch(const Surface& s, const int nstep_u, const int nstep_v);
+  void unmapVertices();
+  void draw(const bool texture = true) const;
+  void swap(Surface_Mesh& mesh);
+  int vertices() const;
+  int triangles() const;
+  void readData(std::vector<GLfloat>& d) const;
+
+private:
+  static bool bufferObjects();
+  template <class Vec>
+  Vec* gridVertices(const int n);
+
+  std::vector<GLfloat> data;  // s, t, x, y, z per vertex
+  std::vector<GLuint> indices;
+  std::vector<GLdouble> grid; // Scratch vertices of a patch, as Surface::vec
+  GLuint buffers[2];          // Vertex and index buffers, 0 if none
+  GLfloat* mapped;            // Next vertex to update, if mapped
+  int nvertices;
+  int nindices;
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+inline int Surface_Mesh::
+vertices() const {
+  return nvertices;
+}
+
+inline int Surface_Mesh::
+triangles() const {
+  return nindices/3;
+}
+
+/*
+ *  gridVertices :
+ *  Room for n vertices of type Vec (three coordinates, float or double) in
+ *  the scratch grid, grown if needed, for evaluateGrid.
+ */
+template <class Vec>
+inline Vec* Surface_Mesh::
+gridVertices(const int n) {
+  assert(sizeof(Vec) <= 3*sizeof(GLdouble));
+  if (grid.size() < 3*n) {
+    grid.resize(3*n);
+  }
+  return reinterpret_cast<Vec*>(&grid[0]);
+}
+
+/*
+ *  addPatch :
+ *  Grid of (nstep_u + 1)*(nstep_v + 1) vertices, and the two triangles of
+ *  each of its cells, with the orientation of the strips of glEvalMesh2.
+ */
+template <class Surface>
+inline void Surface_Mesh::
+addPatch(const Surface& s, const int nstep_u, const int nstep_v,
+	 const GLfloat t_first, const GLfloat t_last) {
+  typename Surface::vec* Q
+    = gridVertices<typename Surface::vec>((nstep_u + 1)*(nstep_v + 1));
+  s.evaluateGrid(nstep_u, nstep_v, Q);
+
+  const GLuint first = nvertices;
+  int k = 0;
+  for (int j = 0; j <= nstep_v; j++) {
+    for (int i = 0; i <= nstep_u; i++, k++) {
+      data.push_back(static_cast<GLfloat>(j)/nstep_v);
+      data.push_back(t_first + (t_last - t_first)*i/nstep_u);
+      data.push_back(static_cast<GLfloat>(Q[k][0]));
+      data.push_back(static_cast<GLfloat>(Q[k][1]));
+      data.push_back(static_cast<GLfloat>(Q[k][2]));
+    }
+  }
+  for (int j = 0; j < nstep_v; j++) {
+    for (int i = 0; i < nstep_u; i++) {
+      const GLuint a0 = first + j*(nstep_u + 1) + i, a1 = a0 + 1;
+      const GLuint b0 = a0 + nstep_u + 1, b1 = b0 + 1;
+      indices.push_back(a0); indices.push_back(b0); indices.push_back(b1);
+      indices.push_back(a0); indices.push_back(b1); indices.push_back(a1);
+    }
+  }
+  nvertices += (nstep_u + 1)*(nstep_v + 1);
+  nindices += 6*nstep_u*nstep_v;
+}
+
+/*
+ *  updatePatch :
+ *  New positions of the vertices of the next patch, between mapVertices and
+ *  unmapVertices, for a patch moved since addPatch (same steps). Texture
+ *  coordinates and triangles are left as they are.
+ */
+template <class Surface>
+inline void Surface_Mesh::
+updatePatch(const Surface& s, const int nstep_u, const int nstep_v) {
+  assert(mapped != 0);
+  const int n = (nstep_u + 1)*(nstep_v + 1);
+  typename Surface::vec* Q = gridVertices<typename Surface::vec>(n);
+  s.evaluateGrid(nstep_u, nstep_v, Q);
+  for (int k = 0; k < n; k++, mapped += 5) {
+    mapped[2] = static_cast<GLfloat>(Q[k][0]);
+    mapped[3] = static_cast<GLfloat>(Q[k][1]);
+    mapped[4] = static_cast<GLfloat>(Q[k][2]);
+  }
+}
+
+#endif // SURFACE_MESH_H
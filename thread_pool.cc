@@ -0,0 +1,112 @@
+#include <unistd.h>
+#include "thread_pool.h"
+
+using namespace std;
+
+Thread_Pool::Thread_Pool()
+  : task(0), ntasks(0), next(0), ndone(0), batch(0), quit(false) {
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&start_cond, 0);
+  pthread_cond_init(&done_cond, 0);
+}
+
+Thread_Pool::~Thread_Pool() {
+  stop();
+  pthread_cond_destroy(&done_cond);
+  pthread_cond_destroy(&start_cond);
+  pthread_mutex_destroy(&mutex);
+}
+
+/*
+ *  start :
+ *  Spawn nworkers-1 threads (the caller of run() being the last worker).
+ */
+void Thread_Pool::start(const int nworkers) {
+  stop();
+  const int nthreads = nworkers - 1;
+  if (nthreads < 1) {
+    return;
+  }
+  threads.resize(nthreads);
+  data.resize(nthreads);
+  for (int i = 0; i < nthreads; i++) {
+    data[i] = Thread_Data(this, i+1);
+    if (pthread_create(&threads[i], 0, loop, &data[i]) != 0) {
+      threads.resize(i);
+      break;
+    }
+  }
+}
+
+void Thread_Pool::stop() {
+  pthread_mutex_lock(&mutex);
+  quit = true;
+  pthread_cond_broadcast(&start_cond);
+  pthread_mutex_unlock(&mutex);
+  for (unsigned int i = 0; i < threads.size(); i++) {
+    pthread_join(threads[i], 0);
+  }
+  threads.clear();
+  quit = false;
+}
+
+/*
+ *  run :
+ *  Run t for indices 0 to n-1, and wait for completion.
+ */
+void Thread_Pool::run(Task& t, const int n) {
+  pthread_mutex_lock(&mutex);
+  task = &t;
+  ntasks = n;
+  next = 0;
+  ndone = 0;
+  batch++;
+  pthread_cond_broadcast(&start_cond);
+  process(0);
+  while (ndone < ntasks) {
+    pthread_cond_wait(&done_cond, &mutex);
+  }
+  task = 0;
+  pthread_mutex_unlock(&mutex);
+}
+
+/*
+ *  process :
+ *  Take tasks of the current batch until none is left (mutex held).
+ */
+void Thread_Pool::process(const int worker) {
+  while (next < ntasks) {
+    const int index = next++;
+    Task* t = task;
+    pthread_mutex_unlock(&mutex);
+    t->run(index, worker);
+    pthread_mutex_lock(&mutex);
+    if (++ndone == ntasks) {
+      pthread_cond_signal(&done_cond);
+    }
+  }
+}
+
+void* Thread_Pool::loop(void* arg) {
+  Thread_Data* d = static_cast<Thread_Data*>(arg);
+  Thread_Pool* pool = d->pool;
+  unsigned long seen = 0;
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (!pool->quit && pool->batch == seen) {
+      pthread_cond_wait(&pool->start_cond, &pool->mutex);
+    }
+    if (pool->quit) {
+      break;
+    }
+    seen = pool->batch;
+    pool->process(d->worker);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return 0;
+}
+
+int Thread_Pool::processors() {
+  const long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? static_cast<int>(n) : 1;
+}
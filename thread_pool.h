@@ -0,0 +1,66 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <pthread.h>
+
+/*
+ *  Fixed set of worker threads running the tasks of one batch at a time.
+ *  The calling thread takes part in the batch as worker 0, and run()
+ *  returns once every task of the batch is done.
+ */
+class Thread_Pool {
+public:
+  class Task {
+  public:
+    virtual ~Task() {}
+    virtual void run(const int index, const int worker) = 0;
+  };
+
+private:
+  class Thread_Data {
+  public:
+    Thread_Data() {}
+    Thread_Data(Thread_Pool* p, const int w) : pool(p), worker(w) {}
+
+    Thread_Pool* pool;
+    int worker;
+  };
+
+  static void* loop(void* arg);
+  void process(const int worker);
+
+  std::vector<pthread_t> threads;
+  std::vector<Thread_Data> data;
+  pthread_mutex_t mutex;
+  pthread_cond_t start_cond, done_cond;
+  Task* task;
+  int ntasks, next, ndone; // Tasks of the batch, first not started, done
+  unsigned long batch;     // Batch counter, incremented by run()
+  bool quit;
+
+  /* Not copyable */
+  Thread_Pool(const Thread_Pool& );
+  Thread_Pool& operator=(const Thread_Pool& );
+
+public:
+  Thread_Pool();
+  ~Thread_Pool();
+  void start(const int nworkers);
+  void stop();
+  void run(Task& t, const int n);
+  int size() const;
+
+  static int processors();
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+inline int Thread_Pool::
+size() const {
+  return threads.size() + 1;
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,43 @@
+#ifndef TRIANGLE_H
+#define TRIANGLE_H
+
+#include "vec3.h"
+
+/*
+ *  intersectTriangle :
+ *  Segment and triangle intersection (Moller and Trumbore), either side of
+ *  the triangle: parameter t along the segment from origin to
+ *  origin + direction, if the point is before t.
+ */
+template <class Real, class T>
+inline bool intersectTriangle(const Vec3<Real>& origin,
+			      const Vec3<Real>& direction,
+			      const Vec3<Real>& a, const Vec3<Real>& b,
+			      const Vec3<Real>& c, T& t) {
+  const Vec3<Real> e1 = b - a;
+  const Vec3<Real> e2 = c - a;
+  const Vec3<Real> p = cross(direction, e2);
+  const Real det = dot(e1, p);
+  if (det == 0.0) {
+    return false; // Parallel, or degenerate triangle
+  }
+  const Real inv_det = 1.0/det;
+  const Vec3<Real> s = origin - a;
+  const Real u = dot(s, p)*inv_det;
+  if (u < 0.0 || u > 1.0) {
+    return false;
+  }
+  const Vec3<Real> q = cross(s, e1);
+  const Real v = dot(direction, q)*inv_det;
+  if (v < 0.0 || u + v > 1.0) {
+    return false;
+  }
+  const Real t_hit = dot(e2, q)*inv_det;
+  if (t_hit < 0.0 || t_hit >= t) {
+    return false;
+  }
+  t = t_hit;
+  return true;
+}
+
+#endif // TRIANGLE_H
@@ -0,0 +1,123 @@
+#include <cstring>
+#if __AVX__
+#include <immintrin.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+#include "opengl_utils.h"
+#include "unprojector.h"
+
+Unprojector::Unprojector()
+  : invertible(false) {}
+
+Unprojector::Unprojector(const real mv_matrix[16], const real proj_matrix[16],
+			 const GLint viewport[4])
+  : invertible(false) {
+  setMatrices(mv_matrix, proj_matrix, viewport);
+}
+
+/*
+ *  setMatrices :
+ *  Inverse of the viewport, projection and modelview transformations,
+ *  only computed again if one of them changed.
+ */
+bool Unprojector::setMatrices(const real mv_matrix[16],
+			      const real proj_matrix[16],
+			      const GLint viewport[4]) {
+  if (invertible &&
+      memcmp(mv, mv_matrix, sizeof(mv)) == 0 &&
+      memcmp(proj, proj_matrix, sizeof(proj)) == 0 &&
+      memcmp(vp, viewport, sizeof(vp)) == 0) {
+    return true;
+  }
+  memcpy(mv, mv_matrix, sizeof(mv));
+  memcpy(proj, proj_matrix, sizeof(proj));
+  memcpy(vp, viewport, sizeof(vp));
+
+  real m[16], m_inv[16];
+  multMM(proj, mv, m);
+  invertible = (invert(m, m_inv) == GL_TRUE) && vp[2] != 0 && vp[3] != 0;
+  if (!invertible) {
+    return false;
+  }
+
+  /* From window to normalized device coordinates */
+  real n[16];
+  identityM(n);
+  n[0]  = 2.0/vp[2];
+  n[5]  = 2.0/vp[3];
+  n[10] = 2.0;
+  n[12] = -2.0*vp[0]/vp[2] - 1.0;
+  n[13] = -2.0*vp[1]/vp[3] - 1.0;
+  n[14] = -1.0;
+  multMM(m_inv, n, inverse);
+  return true;
+}
+
+/*
+ *  unproject :
+ *  Object coordinates of the n points of window coordinates win, both
+ *  arrays storing x, y and z in turn. False if one of the points cannot
+ *  be unprojected (it is left as is in obj).
+ */
+bool Unprojector::unproject(const int n, const real* win, real* obj) const {
+  if (!invertible) {
+    return false;
+  }
+  bool done = true;
+  int i = 0;
+#if __AVX__
+  const __m256d c0 = _mm256_loadu_pd(inverse);
+  const __m256d c1 = _mm256_loadu_pd(inverse + 4);
+  const __m256d c2 = _mm256_loadu_pd(inverse + 8);
+  const __m256d c3 = _mm256_loadu_pd(inverse + 12);
+  for (; i < n; i++, win += 3, obj += 3) {
+    real q[4];
+    _mm256_storeu_pd(q, _mm256_add_pd(
+      _mm256_add_pd(_mm256_mul_pd(c0, _mm256_set1_pd(win[0])),
+		    _mm256_mul_pd(c1, _mm256_set1_pd(win[1]))),
+      _mm256_add_pd(_mm256_mul_pd(c2, _mm256_set1_pd(win[2])), c3)));
+    if (q[3] == 0.0) {
+      done = false;
+      continue;
+    }
+    obj[0] = q[0]/q[3];
+    obj[1] = q[1]/q[3];
+    obj[2] = q[2]/q[3];
+  }
+#elif __SSE2__
+  const __m128d c0_xy = _mm_loadu_pd(inverse);
+  const __m128d c0_zw = _mm_loadu_pd(inverse + 2);
+  const __m128d c1_xy = _mm_loadu_pd(inverse + 4);
+  const __m128d c1_zw = _mm_loadu_pd(inverse + 6);
+  const __m128d c2_xy = _mm_loadu_pd(inverse + 8);
+  const __m128d c2_zw = _mm_loadu_pd(inverse + 10);
+  const __m128d c3_xy = _mm_loadu_pd(inverse + 12);
+  const __m128d c3_zw = _mm_loadu_pd(inverse + 14);
+  for (; i < n; i++, win += 3, obj += 3) {
+    const __m128d x = _mm_set1_pd(win[0]);
+    const __m128d y = _mm_set1_pd(win[1]);
+    const __m128d z = _mm_set1_pd(win[2]);
+    real q[4];
+    _mm_storeu_pd(q, _mm_add_pd(_mm_add_pd(_mm_mul_pd(c0_xy, x),
+					   _mm_mul_pd(c1_xy, y)),
+				_mm_add_pd(_mm_mul_pd(c2_xy, z), c3_xy)));
+    _mm_storeu_pd(q + 2, _mm_add_pd(_mm_add_pd(_mm_mul_pd(c0_zw, x),
+					       _mm_mul_pd(c1_zw, y)),
+				    _mm_add_pd(_mm_mul_pd(c2_zw, z), c3_zw)));
+    if (q[3] == 0.0) {
+      done = false;
+      continue;
+    }
+    obj[0] = q[0]/q[3];
+    obj[1] = q[1]/q[3];
+    obj[2] = q[2]/q[3];
+  }
+#endif
+  for (; i < n; i++, win += 3, obj += 3) {
+    if (!unproject(win[0], win[1], win[2], &obj[0], &obj[1], &obj[2])) {
+      done = false;
+    }
+  }
+  return done;
+}
@@ -0,0 +1,65 @@
+#ifndef UNPROJECTOR_H
+#define UNPROJECTOR_H
+
+#include <GL/gl.h>
+
+/*
+ *  Same mapping from window to object coordinates as gluUnProject, but
+ *  the inverse of the projection and modelview matrices, composed with
+ *  the inverse of the viewport transformation, is computed once, when
+ *  the camera changes, and not for every point. Arrays of points are
+ *  transformed one point per (AVX) or two (SSE2) vector operations.
+ */
+class Unprojector {
+public:
+  typedef GLdouble real;
+
+  Unprojector();
+  Unprojector(const real mv_matrix[16], const real proj_matrix[16],
+	      const GLint viewport[4]);
+  bool setMatrices(const real mv_matrix[16], const real proj_matrix[16],
+		   const GLint viewport[4]);
+  bool valid() const;
+
+  bool unproject(const real winx, const real winy, const real winz,
+		 real* objx, real* objy, real* objz) const;
+  bool unproject(const int n, const real* win, real* obj) const;
+
+private:
+  real mv[16], proj[16]; // Current camera
+  GLint vp[4];
+  real inverse[16];      // From window to homogeneous object coordinates
+  bool invertible;
+};
+
+/*
+ *  Definition of inlined methods
+ */
+
+inline bool Unprojector::
+valid() const {
+  return invertible;
+}
+
+/*
+ *  unproject :
+ *  Object coordinates of a single point, as gluUnProject computes them.
+ */
+inline bool Unprojector::
+unproject(const real winx, const real winy, const real winz,
+	  real* objx, real* objy, real* objz) const {
+  if (!invertible) {
+    return false;
+  }
+  const real* m = inverse;
+  const real w = m[3]*winx + m[7]*winy + m[11]*winz + m[15];
+  if (w == 0.0) {
+    return false;
+  }
+  *objx = (m[0]*winx + m[4]*winy + m[8]*winz + m[12])/w;
+  *objy = (m[1]*winx + m[5]*winy + m[9]*winz + m[13])/w;
+  *objz = (m[2]*winx + m[6]*winy + m[10]*winz + m[14])/w;
+  return true;
+}
+
+#endif // UNPROJECTOR_H